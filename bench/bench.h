@@ -0,0 +1,200 @@
+/**
+ * bench.h - Shared helpers for the benchmark programs in bench/
+ *
+ * This header provides:
+ * 1. bench_now_ns()      - monotonic timestamps in nanoseconds
+ *    bench_cycles()      - time stamp counter reads for per-cycle rates
+ * 2. bench_work()        - calibrated busy work that simulates a critical section
+ * 3. bench_samples_t     - latency sample buffers with percentile queries
+ * 4. bench_num_cpus()    - number of online CPUs
+ * 5. bench_next_threads() - the 1, 2, 4, ..., max thread-count sweep
+ * 6. bench_memory_read() - page faults and huge-page usage of the process
+ *
+ * Hardware event counters for each case live in bench_perf.h.
+ *
+ * Benchmark programs must define _GNU_SOURCE before their first #include.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Time
+// ---------------------------------------------------------------------------
+
+// Current CLOCK_MONOTONIC time in nanoseconds
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Cycle counter: the TSC on x86, which ticks at the nominal clock rate
+// rather than the current core clock. Other CPUs fall back to nanoseconds.
+static inline uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return bench_now_ns();
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Busy work
+// ---------------------------------------------------------------------------
+
+// Spin for `loops` iterations. The empty asm keeps the compiler from
+// deleting or collapsing the loop at any optimization level.
+static inline void bench_work(uint64_t loops) {
+    for (uint64_t i = 0; i < loops; i++) {
+        __asm__ __volatile__("" ::: "memory");
+    }
+}
+
+// Measure how many bench_work() loops fit in one microsecond
+static inline double bench_work_calibrate(void) {
+    const uint64_t loops = 10000000;
+    uint64_t start = bench_now_ns();
+    bench_work(loops);
+    uint64_t elapsed = bench_now_ns() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    return (double)loops * 1000.0 / (double)elapsed;
+}
+
+// ---------------------------------------------------------------------------
+// Latency samples
+// ---------------------------------------------------------------------------
+
+// A growable-up-to-cap buffer of latencies. Each thread owns one, so
+// recording a sample never touches shared memory.
+typedef struct {
+    uint64_t *values;
+    size_t count;
+    size_t cap;
+} bench_samples_t;
+
+static inline void bench_samples_init(bench_samples_t *s, size_t cap) {
+    s->values = (uint64_t *)malloc(cap * sizeof(uint64_t));
+    if (s->values == NULL) {
+        perror("bench_samples_init");
+        exit(1);
+    }
+    s->count = 0;
+    s->cap = cap;
+}
+
+// Record one sample; silently drops samples once the buffer is full
+static inline void bench_samples_add(bench_samples_t *s, uint64_t value) {
+    if (s->count < s->cap) {
+        s->values[s->count++] = value;
+    }
+}
+
+// Append all samples of src to dst (dst grows as needed)
+static inline void bench_samples_merge(bench_samples_t *dst, const bench_samples_t *src) {
+    if (dst->count + src->count > dst->cap) {
+        size_t cap = dst->count + src->count;
+        uint64_t *values = (uint64_t *)realloc(dst->values, cap * sizeof(uint64_t));
+        if (values == NULL) {
+            perror("bench_samples_merge");
+            exit(1);
+        }
+        dst->values = values;
+        dst->cap = cap;
+    }
+    memcpy(dst->values + dst->count, src->values, src->count * sizeof(uint64_t));
+    dst->count += src->count;
+}
+
+static inline int bench_u64_compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Sort the samples so that bench_samples_percentile() can be called
+static inline void bench_samples_sort(bench_samples_t *s) {
+    qsort(s->values, s->count, sizeof(uint64_t), bench_u64_compare);
+}
+
+// Value at quantile q (0.0 - 1.0) of sorted samples, 0 when empty
+static inline uint64_t bench_samples_percentile(const bench_samples_t *s, double q) {
+    if (s->count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(q * (double)(s->count - 1));
+    return s->values[index];
+}
+
+static inline void bench_samples_free(bench_samples_t *s) {
+    free(s->values);
+    s->values = NULL;
+    s->count = 0;
+    s->cap = 0;
+}
+
+// ---------------------------------------------------------------------------
+// System
+// ---------------------------------------------------------------------------
+
+static inline int bench_num_cpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// Next thread count in the sweep 1, 2, 4, ... that always ends on `max`.
+// Returns 0 once `threads` is already max.
+static inline int bench_next_threads(int threads, int max) {
+    if (threads >= max) {
+        return 0;
+    }
+    return threads * 2 < max ? threads * 2 : max;
+}
+
+// ---------------------------------------------------------------------------
+// Memory
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    long minor_faults;    // Faults served without I/O (e.g. fresh zero pages)
+    long major_faults;    // Faults that had to read from disk
+    long huge_kb;         // Anonymous memory in transparent huge pages, -1 if unknown
+} bench_memory_t;
+
+// Snapshot for this process. Subtract two snapshots to get the cost of a
+// case: huge_kb is a current total, the fault counts are cumulative.
+static inline void bench_memory_read(bench_memory_t *m) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    m->minor_faults = ru.ru_minflt;
+    m->major_faults = ru.ru_majflt;
+    m->huge_kb = -1;
+
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (f == NULL) {
+        return;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &m->huge_kb) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+}
+
+#endif // BENCH_H
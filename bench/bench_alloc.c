@@ -0,0 +1,275 @@
+/**
+ * bench_alloc.c - malloc/free vs arena and object pool
+ *
+ * Cases:
+ * 1. small   - N allocations of 8..64 bytes, then free them all
+ * 2. matrix  - build and tear down the int** matrix from
+ *              pointer_to_pointer_examples (rows + 1 allocations)
+ * 3. churn   - allocate/free same-sized objects in a sliding window
+ *              (malloc vs object_pool_t)
+ * 4. pages   - a large int** matrix with one malloc per row, and with rows
+ *              from arenas backed by malloc, pages, transparent huge pages
+ *              and hugetlbfs pages. It prints the time to build and fill
+ *              the matrix, the page faults and huge-page memory that cost,
+ *              and ns per random element read (TLB-bound).
+ *
+ * Usage: bench_alloc [-n allocations] [-m matrix_megabytes] [-N numa_node]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "arena.h"
+
+#define CHURN_WINDOW 1024
+#define CHURN_OBJECT_SIZE 48
+
+// Rows of the pages case: 4KB each, one base page per row
+#define PAGES_COLS 1024
+#define PAGES_CHUNK_SIZE (64u << 20)
+#define PAGES_PROBES 4000000
+
+// Keep the compiler from discarding allocations we never read
+static volatile uintptr_t sink;
+
+// Counters for the case being timed; report() stops them
+static bench_perf_t perf;
+
+static void report(const char *bench_case, const char *allocator, size_t ops, uint64_t ns) {
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, (double)ops, "%s %s", bench_case, allocator);
+    printf("%-8s %-14s %12zu %10.2f %14.0f\n", bench_case, allocator, ops,
+           (double)ns / ops, (double)ops * 1e9 / (double)ns);
+    fflush(stdout);
+}
+
+static void bench_small(size_t n) {
+    void **ptrs = (void **)malloc(n * sizeof(void *));
+    if (ptrs == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i++) {
+        ptrs[i] = malloc(8 + (i & 7) * 8);
+        *(char *)ptrs[i] = (char)i;
+    }
+    for (size_t i = 0; i < n; i++) {
+        free(ptrs[i]);
+    }
+    report("small", "malloc/free", n, bench_now_ns() - t0);
+
+    arena_t a;
+    arena_init(&a, 64 * 1024);
+    bench_perf_start(&perf);
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i++) {
+        ptrs[i] = arena_alloc(&a, 8 + (i & 7) * 8);
+        *(char *)ptrs[i] = (char)i;
+    }
+    arena_release(&a);
+    report("small", "arena", n, bench_now_ns() - t0);
+
+    free(ptrs);
+}
+
+static void bench_matrix(size_t n) {
+    const size_t rows = 64, cols = 64;
+    size_t reps = n / (rows + 1);
+    if (reps == 0) {
+        reps = 1;
+    }
+
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    for (size_t r = 0; r < reps; r++) {
+        int **m = (int **)malloc(rows * sizeof(int *));
+        for (size_t i = 0; i < rows; i++) {
+            m[i] = (int *)malloc(cols * sizeof(int));
+            m[i][0] = (int)i;
+        }
+        sink += (uintptr_t)m[rows - 1];
+        for (size_t i = 0; i < rows; i++) {
+            free(m[i]);
+        }
+        free(m);
+    }
+    report("matrix", "malloc/free", reps * (rows + 1), bench_now_ns() - t0);
+
+    arena_t a;
+    arena_init(&a, 64 * 1024);
+    bench_perf_start(&perf);
+    t0 = bench_now_ns();
+    for (size_t r = 0; r < reps; r++) {
+        arena_mark_t mark = arena_mark(&a);
+        int **m = ARENA_NEW_ARRAY(&a, int *, rows);
+        for (size_t i = 0; i < rows; i++) {
+            m[i] = ARENA_NEW_ARRAY(&a, int, cols);
+            m[i][0] = (int)i;
+        }
+        sink += (uintptr_t)m[rows - 1];
+        arena_rewind(&a, mark); // Whole matrix gone in one call
+    }
+    arena_release(&a);
+    report("matrix", "arena", reps * (rows + 1), bench_now_ns() - t0);
+}
+
+static void bench_churn(size_t n) {
+    void *window[CHURN_WINDOW] = {0};
+
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i++) {
+        size_t slot = (i * 7919) % CHURN_WINDOW;
+        free(window[slot]);
+        window[slot] = malloc(CHURN_OBJECT_SIZE);
+        *(char *)window[slot] = (char)i;
+    }
+    for (size_t i = 0; i < CHURN_WINDOW; i++) {
+        free(window[i]);
+        window[i] = NULL;
+    }
+    report("churn", "malloc/free", n, bench_now_ns() - t0);
+
+    object_pool_t pool;
+    object_pool_init(&pool, CHURN_OBJECT_SIZE, 256);
+    bench_perf_start(&perf);
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i++) {
+        size_t slot = (i * 7919) % CHURN_WINDOW;
+        if (window[slot] != NULL) {
+            object_pool_free(&pool, window[slot]);
+        }
+        window[slot] = object_pool_alloc(&pool);
+        *(char *)window[slot] = (char)i;
+    }
+    object_pool_destroy(&pool);
+    report("churn", "object_pool", n, bench_now_ns() - t0);
+}
+
+// ns per read of a random element: with 4KB pages nearly every read needs
+// a page walk once the matrix is far bigger than the TLB reaches
+static double probe_matrix(int **m, size_t rows, const char *rows_from) {
+    uint64_t x = 88172645463325252ull; // xorshift64
+    long long sum = 0;
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < PAGES_PROBES; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        sum += m[x % rows][(x >> 40) % PAGES_COLS];
+    }
+    double ns = (double)(bench_now_ns() - t0) / PAGES_PROBES;
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, PAGES_PROBES, "pages %s random_reads", rows_from);
+    sink += (uintptr_t)sum;
+    return ns;
+}
+
+static void report_pages(const char *rows_from, const char *got, uint64_t build_ns,
+                         const bench_memory_t *before, const bench_memory_t *after, double probe_ns) {
+    long huge_mb = before->huge_kb >= 0 ? (after->huge_kb - before->huge_kb) >> 10 : -1;
+    printf("%-18s %-12s %10.1f %12ld %8ld %10.1f\n", rows_from, got, (double)build_ns / 1e6,
+           after->minor_faults - before->minor_faults, huge_mb, probe_ns);
+    fflush(stdout);
+}
+
+static void bench_pages(size_t megabytes, int node) {
+    size_t rows = (megabytes << 20) / (PAGES_COLS * sizeof(int));
+    if (rows == 0) {
+        rows = 1;
+    }
+    printf("\nPage backing: %zu x %d int** matrix (%zuMB), NUMA node %d\n",
+           rows, PAGES_COLS, megabytes, node);
+    printf("%-18s %-12s %10s %12s %8s %10s\n", "rows from", "got", "build ms", "minor flt", "huge MB", "ns/read");
+
+    // Baseline: one malloc per row, as in pointer_to_pointer_examples
+    bench_memory_t before, after;
+    bench_memory_read(&before);
+    uint64_t t0 = bench_now_ns();
+    int **m = (int **)malloc(rows * sizeof(int *));
+    if (m == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < rows; i++) {
+        m[i] = (int *)malloc(PAGES_COLS * sizeof(int));
+        if (m[i] == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+        memset(m[i], (int)i, PAGES_COLS * sizeof(int));
+    }
+    uint64_t build = bench_now_ns() - t0;
+    bench_memory_read(&after);
+    report_pages("malloc/row", "malloc", build, &before, &after, probe_matrix(m, rows, "malloc/row"));
+    for (size_t i = 0; i < rows; i++) {
+        free(m[i]);
+    }
+    free(m);
+
+    for (int b = ARENA_BACKING_MALLOC; b <= ARENA_BACKING_HUGETLB; b++) {
+        arena_t a;
+        arena_init_backing(&a, PAGES_CHUNK_SIZE, (arena_backing_t)b, node);
+        bench_memory_read(&before);
+        t0 = bench_now_ns();
+        m = ARENA_NEW_ARRAY(&a, int *, rows);
+        if (m == NULL) {
+            perror("arena_alloc");
+            exit(1);
+        }
+        for (size_t i = 0; i < rows; i++) {
+            m[i] = ARENA_NEW_ARRAY(&a, int, PAGES_COLS);
+            if (m[i] == NULL) {
+                perror("arena_alloc");
+                exit(1);
+            }
+            memset(m[i], (int)i, PAGES_COLS * sizeof(int));
+        }
+        build = bench_now_ns() - t0;
+        bench_memory_read(&after);
+        char rows_from[32];
+        snprintf(rows_from, sizeof(rows_from), "arena/%s", arena_backing_name((arena_backing_t)b));
+        report_pages(rows_from, arena_backing_name(a.backing), build, &before, &after,
+                     probe_matrix(m, rows, rows_from));
+        arena_release(&a);
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t n = 4000000;
+    size_t megabytes = 256;
+    int node = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:N:h")) != -1) {
+        switch (opt) {
+        case 'n': n = (size_t)atol(optarg); break;
+        case 'm': megabytes = (size_t)atol(optarg); break;
+        case 'N': node = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n allocations] [-m matrix_megabytes] [-N numa_node]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (n == 0 || megabytes == 0) {
+        fprintf(stderr, "Usage: %s [-n allocations] [-m matrix_megabytes] [-N numa_node]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Allocator benchmark\n");
+    printf("%-8s %-14s %12s %10s %14s\n", "case", "allocator", "allocs", "ns/alloc", "allocs/s");
+    bench_small(n);
+    bench_matrix(n);
+    bench_churn(n);
+    bench_pages(megabytes, node);
+    return 0;
+}
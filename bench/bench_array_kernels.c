@@ -0,0 +1,157 @@
+/**
+ * bench_array_kernels.c - Elements per cycle of the array kernels
+ *
+ * Runs every kernel in src/array_kernels.h for every instruction set this
+ * CPU supports. Array sizes are picked to sit in L1, L2, L3 and DRAM:
+ * 16KB, 256KB, 4MB and 64MB of ints. Each case repeats until it has
+ * touched about 64M elements and prints elements per TSC cycle and the
+ * speedup over the scalar version. It also checks the result against
+ * scalar.
+ *
+ * Usage: bench_array_kernels [-m max_elements]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "array_kernels.h"
+
+#define TARGET_ELEMENTS (64u << 20)
+
+// Data is in [-1000, 1000], so find() never hits this and scans everything
+#define MISSING_VALUE 5000
+
+// Start both buffers on a cache line
+#define BUFFER_ALIGNMENT 64
+
+typedef enum {
+    K_SUM, K_MINMAX, K_FILL, K_COPY, K_SCALE_ADD, K_FIND, K_ADD, K_SUB, K_MUL, K_COUNT
+} kernel_id_t;
+
+static const char *kernel_names[] = {
+    "sum", "minmax", "fill", "copy", "scale_add", "find", "add", "sub", "mul",
+};
+
+// Run one kernel once and fold its result into a number we can compare
+static long long run_kernel(const array_kernels_t *k, kernel_id_t id,
+                            int *dst, const int *src, size_t n) {
+    int lo, hi;
+    switch (id) {
+    case K_SUM: return k->sum(src, n);
+    case K_MINMAX: k->minmax(src, n, &lo, &hi); return (long long)lo * 1000003 + hi;
+    case K_FILL: k->fill(dst, 7, n); return dst[n - 1];
+    case K_COPY: k->copy(dst, src, n); return dst[n - 1];
+    case K_SCALE_ADD: k->scale_add(dst, src, 3, n); return dst[n - 1];
+    case K_FIND: return (long long)k->find(src, n, MISSING_VALUE);
+    case K_ADD: k->add(dst, dst, src, n); return dst[n - 1];
+    case K_SUB: k->sub(dst, dst, src, n); return dst[n - 1];
+    case K_MUL: k->mul(dst, src, src, n); return dst[n - 1];
+    default: return 0;
+    }
+}
+
+// Result on fresh inputs, including everything the kernel wrote to dst
+static long long verify_kernel(const array_kernels_t *k, kernel_id_t id,
+                               int *dst, const int *src, size_t n) {
+    memset(dst, 0, n * sizeof(int));
+    long long result = run_kernel(k, id, dst, src, n);
+    return result + array_sum_scalar(dst, n);
+}
+
+static void run_size(size_t n, int *dst, const int *src) {
+    size_t reps = TARGET_ELEMENTS / n;
+    if (reps < 1) {
+        reps = 1;
+    }
+
+    char size[32];
+    if (n * sizeof(int) >= (1u << 20)) {
+        snprintf(size, sizeof(size), "%zuMB", n * sizeof(int) >> 20);
+    } else {
+        snprintf(size, sizeof(size), "%zuKB", n * sizeof(int) >> 10);
+    }
+
+    const array_kernels_t *scalar = array_kernels_for(ARRAY_ISA_SCALAR);
+    for (int id = 0; id < K_COUNT; id++) {
+        double scalar_rate = 0.0;
+        long long expected = verify_kernel(scalar, (kernel_id_t)id, dst, src, n);
+
+        for (int isa = 0; isa < ARRAY_ISA_COUNT; isa++) {
+            const array_kernels_t *k = array_kernels_for((array_isa_t)isa);
+            if (k == NULL) {
+                continue;
+            }
+
+            // One untimed pass to fault in and warm the buffers
+            volatile long long sink = run_kernel(k, (kernel_id_t)id, dst, src, n);
+            bench_perf_t perf;
+            bench_perf_start(&perf);
+            uint64_t c0 = bench_cycles();
+            for (size_t r = 0; r < reps; r++) {
+                sink = run_kernel(k, (kernel_id_t)id, dst, src, n);
+            }
+            uint64_t cycles = bench_cycles() - c0;
+            bench_perf_stop(&perf);
+            (void)sink;
+
+            double rate = (double)n * (double)reps / (double)(cycles > 0 ? cycles : 1);
+            if (isa == ARRAY_ISA_SCALAR) {
+                scalar_rate = rate;
+            }
+            bool ok = verify_kernel(k, (kernel_id_t)id, dst, src, n) == expected;
+
+            printf("%-7s %-10s %-7s %12.3f %8.2fx %6s\n", size, kernel_names[id], k->name,
+                   rate, rate / scalar_rate, ok ? "ok" : "FAIL");
+            fflush(stdout);
+            bench_perf_report(&perf, (double)n * (double)reps, "%s %s %s", size, kernel_names[id], k->name);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t max_elements = 16u << 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:h")) != -1) {
+        switch (opt) {
+        case 'm': max_elements = (size_t)atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-m max_elements]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    // aligned_alloc wants a multiple of the alignment
+    size_t bytes = (max_elements * sizeof(int) + BUFFER_ALIGNMENT - 1) & ~(size_t)(BUFFER_ALIGNMENT - 1);
+    int *src = (int *)aligned_alloc(BUFFER_ALIGNMENT, bytes);
+    int *dst = (int *)aligned_alloc(BUFFER_ALIGNMENT, bytes);
+    if (max_elements == 0 || src == NULL || dst == NULL) {
+        fprintf(stderr, "Usage: %s [-m max_elements]\n", argv[0]);
+        return 1;
+    }
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < max_elements; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        src[i] = (int)(seed >> 16) % 2001 - 1000;
+    }
+
+    printf("Array kernel benchmark (elements per cycle; best ISA here: %s)\n", array_kernels()->name);
+    printf("%-7s %-10s %-7s %12s %9s %6s\n", "size", "kernel", "isa", "elem/cycle", "speedup", "check");
+
+    // L1, L2, L3 and DRAM sized arrays
+    const size_t sizes[] = {4u << 10, 64u << 10, 1u << 20, 16u << 20};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= max_elements; s++) {
+        run_size(sizes[s], dst, src);
+    }
+
+    free(src);
+    free(dst);
+    return 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * bench_barrier.c - Phase-synchronization latency of barriers and latches
+ *
+ * A group of threads runs many empty phases and synchronizes at the end of
+ * each one, so every phase costs exactly one barrier crossing. Compared:
+ * 1. pthread      - pthread_barrier_t
+ * 2. barrier      - barrier_t (centralized, sense-reversing)
+ * 3. dissemination - dissemination_barrier_t
+ * 4. latch        - a fresh latch_t per phase, latch_arrive_and_wait
+ *
+ * Each case prints the mean ns per phase and thread 0's p50/p99 phase
+ * times. Before each crossing every thread publishes its phase number,
+ * and after it checks that its neighbour has reached the same phase; any
+ * thread that got through early shows up in the "early" column.
+ *
+ * Usage: bench_barrier [-n phases] [-t max_threads]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "barrier.h"
+
+typedef enum { B_PTHREAD, B_BARRIER, B_DISSEMINATION, B_LATCH, B_COUNT } barrier_kind_t;
+
+static const char *barrier_names[] = {"pthread", "barrier", "dissemination", "latch"};
+
+typedef struct {
+    barrier_kind_t kind;
+    int threads;
+    int phases;
+    pthread_barrier_t pthread_barrier;
+    barrier_t barrier;
+    dissemination_barrier_t dissemination;
+    latch_t *latches;   // One per phase
+    atomic_bool start;
+} bench_barrier_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) bench_barrier_t *bb;
+    int id;
+    atomic_int phase;   // Last phase this thread arrived at
+    uint64_t early;
+    bench_samples_t samples;   // Phase times, thread 0 only
+} barrier_worker_t;
+
+static void cross(bench_barrier_t *bb, int id, int phase) {
+    switch (bb->kind) {
+    case B_PTHREAD:
+        pthread_barrier_wait(&bb->pthread_barrier);
+        break;
+    case B_BARRIER:
+        barrier_wait(&bb->barrier);
+        break;
+    case B_DISSEMINATION:
+        dissemination_barrier_wait(&bb->dissemination, (uint32_t)id);
+        break;
+    default:
+        latch_arrive_and_wait(&bb->latches[phase]);
+        break;
+    }
+}
+
+static void *barrier_function(void *arg) {
+    barrier_worker_t *w = (barrier_worker_t *)arg;
+    bench_barrier_t *bb = w->bb;
+    barrier_worker_t *next = w + 1 - (w->id + 1 == bb->threads ? bb->threads : 0);
+    while (!atomic_load_explicit(&bb->start, memory_order_acquire)) {
+        cpu_relax();
+    }
+
+    uint64_t last = bench_now_ns();
+    for (int p = 0; p < bb->phases; p++) {
+        atomic_store_explicit(&w->phase, p, memory_order_relaxed);
+        cross(bb, w->id, p);
+        // The barrier orders the store above before this load
+        w->early += atomic_load_explicit(&next->phase, memory_order_relaxed) < p;
+        if (w->id == 0) {
+            uint64_t now = bench_now_ns();
+            bench_samples_add(&w->samples, now - last);
+            last = now;
+        }
+    }
+    return NULL;
+}
+
+static void run_barrier_case(barrier_kind_t kind, int threads, int phases) {
+    bench_barrier_t bb;
+    memset(&bb, 0, sizeof(bb));
+    bb.kind = kind;
+    bb.threads = threads;
+    bb.phases = phases;
+    atomic_init(&bb.start, false);
+    if (pthread_barrier_init(&bb.pthread_barrier, NULL, (unsigned)threads) != 0 ||
+        barrier_init(&bb.barrier, (uint32_t)threads) != 0 ||
+        dissemination_barrier_init(&bb.dissemination, (uint32_t)threads) != 0) {
+        perror("barrier init");
+        exit(1);
+    }
+    if (kind == B_LATCH) {
+        bb.latches = (latch_t *)aligned_alloc(CACHE_LINE_SIZE, (size_t)phases * sizeof(latch_t));
+        if (bb.latches == NULL) {
+            perror("aligned_alloc");
+            exit(1);
+        }
+        for (int p = 0; p < phases; p++) {
+            latch_init(&bb.latches[p], (uint32_t)threads);
+        }
+    }
+
+    pthread_t *tids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    barrier_worker_t *workers = (barrier_worker_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                                  threads * sizeof(barrier_worker_t));
+    if (tids == NULL || workers == NULL) {
+        perror("run_barrier_case");
+        exit(1);
+    }
+    for (int i = 0; i < threads; i++) {
+        memset(&workers[i], 0, sizeof(barrier_worker_t));
+        workers[i].bb = &bb;
+        workers[i].id = i;
+        atomic_init(&workers[i].phase, -1);
+        bench_samples_init(&workers[i].samples, i == 0 ? (size_t)phases : 1);
+    }
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, barrier_function, &workers[i]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+
+    uint64_t start = bench_now_ns();
+    atomic_store_explicit(&bb.start, true, memory_order_release);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double ns = (double)(bench_now_ns() - start) / phases;
+    bench_perf_stop(&perf);
+
+    uint64_t early = 0;
+    for (int i = 0; i < threads; i++) {
+        early += workers[i].early;
+    }
+    bench_samples_sort(&workers[0].samples);
+    printf("%-14s %8d %12.0f %10llu %10llu %7llu\n", barrier_names[kind], threads, ns,
+           (unsigned long long)bench_samples_percentile(&workers[0].samples, 0.50),
+           (unsigned long long)bench_samples_percentile(&workers[0].samples, 0.99),
+           (unsigned long long)early);
+    bench_perf_report(&perf, (double)phases, "%s threads=%d", barrier_names[kind], threads);
+    fflush(stdout);
+
+    for (int i = 0; i < threads; i++) {
+        bench_samples_free(&workers[i].samples);
+    }
+    free(workers);
+    free(tids);
+    free(bb.latches);
+    dissemination_barrier_destroy(&bb.dissemination);
+    pthread_barrier_destroy(&bb.pthread_barrier);
+}
+
+int main(int argc, char **argv) {
+    int phases = 50000;
+    int max_threads = bench_num_cpus();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:h")) != -1) {
+        switch (opt) {
+        case 'n': phases = atoi(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n phases] [-t max_threads]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (phases <= 0 || max_threads <= 0) {
+        fprintf(stderr, "Usage: %s [-n phases] [-t max_threads]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Barrier benchmark: %d CPUs, %d phases per case, spin limit %d\n",
+           bench_num_cpus(), phases, BARRIER_SPIN_LIMIT);
+    printf("%-14s %8s %12s %10s %10s %7s\n", "barrier", "threads", "ns/phase", "p50 ns", "p99 ns", "early");
+
+    for (int threads = 1; threads != 0; threads = bench_next_threads(threads, max_threads)) {
+        for (int k = B_PTHREAD; k < B_COUNT; k++) {
+            run_barrier_case((barrier_kind_t)k, threads, phases);
+        }
+    }
+
+    return 0;
+}
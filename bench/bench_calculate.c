@@ -0,0 +1,110 @@
+/**
+ * bench_calculate.c - ns/op for direct, inlined and pointer-dispatched calls
+ *
+ * Every operation in calculate.h is run in a dependent chain
+ * (acc = op(acc, x)) three ways:
+ * 1. direct   - a call to an ordinary function that the compiler may not inline
+ * 2. inlined  - CALCULATE(op, acc, x), which compiles to the arithmetic itself
+ * 3. pointer  - calculate(op_ptr, acc, x) as in function_pointer_examples,
+ *               with the pointer loaded at run time
+ *
+ * Operands are kept small so no operation overflows. Build with -O2 to
+ * see the inlining; at -O0 nothing is inlined.
+ *
+ * Usage: bench_calculate [-n iterations]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "calculate.h"
+
+// calculate() from pointer_examples.c, kept out of line like there
+static __attribute__((noinline)) int calculate(int (*operation)(int, int), int a, int b) {
+    return operation(a, b);
+}
+
+// The chain body shared by all three ways: bounded operands, divisor 1..8
+#define CHAIN(n, call) \
+    int acc = 1; \
+    for (size_t i = 0; i < (n); i++) { \
+        int a = acc & 0xffff, b = (int)(i & 7) + 1; \
+        acc = (call); \
+    } \
+    return acc
+
+// For each operation: an out-of-line function plus the three chain loops
+#define DEFINE_CASES(name, expr) \
+    static __attribute__((noinline)) int name##_function(int a, int b) { \
+        return calculate_##name(a, b); \
+    } \
+    static int direct_##name(size_t n) { CHAIN(n, name##_function(a, b)); } \
+    static int inlined_##name(size_t n) { CHAIN(n, CALCULATE(name, a, b)); } \
+    static int pointer_##name(size_t n) { \
+        /* The volatile read hides which function this is from the optimizer */ \
+        int (*volatile slot)(int, int) = name##_function; \
+        int (*op)(int, int) = slot; \
+        CHAIN(n, calculate(op, a, b)); \
+    }
+
+CALCULATE_OPERATIONS(DEFINE_CASES)
+
+typedef struct {
+    const char *name;
+    int (*direct)(size_t);
+    int (*inlined)(size_t);
+    int (*pointer)(size_t);
+} calculate_case_t;
+
+#define CASE_ENTRY(name, expr) {#name, direct_##name, inlined_##name, pointer_##name},
+
+static const calculate_case_t cases[] = {CALCULATE_OPERATIONS(CASE_ENTRY)};
+
+static double time_chain(const char *name, const char *mode, int (*loop)(size_t), size_t n, int *result) {
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    *result = loop(n);
+    double ns = (double)(bench_now_ns() - t0) / (double)n;
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, (double)n, "%s %s", name, mode);
+    return ns;
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = 50000000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+        case 'n': iterations = (size_t)atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "Usage: %s [-n iterations]\n", argv[0]);
+        return 1;
+    }
+
+    printf("calculate() dispatch benchmark (ns/op, %zu dependent ops per case)\n", iterations);
+    printf("%-10s %10s %10s %10s %6s\n", "operation", "direct", "inlined", "pointer", "check");
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        int r_direct, r_inlined, r_pointer;
+        double direct = time_chain(cases[c].name, "direct", cases[c].direct, iterations, &r_direct);
+        double inlined = time_chain(cases[c].name, "inlined", cases[c].inlined, iterations, &r_inlined);
+        double pointer = time_chain(cases[c].name, "pointer", cases[c].pointer, iterations, &r_pointer);
+        printf("%-10s %10.3f %10.3f %10.3f %6s\n", cases[c].name, direct, inlined, pointer,
+               r_direct == r_inlined && r_inlined == r_pointer ? "ok" : "FAIL");
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * bench_counters.c - Shared atomic counters vs sharded_counter_t
+ *
+ * Every thread adds 1 to one counter `n` times. Compared counters:
+ * 1. seq_cst        - one int64_t, __atomic_fetch_add with __ATOMIC_SEQ_CST
+ * 2. relaxed        - the same word with __ATOMIC_RELAXED
+ * 3. sharded_thread - sharded_counter_t, SHARDED_COUNTER_PER_THREAD
+ * 4. sharded_cpu    - sharded_counter_t, SHARDED_COUNTER_PER_CPU
+ *
+ * Each case checks the final total. Afterwards the cost of the exact and
+ * approximate sharded reads is measured on one thread.
+ *
+ * Usage: bench_counters [-n increments_per_thread] [-t max_threads]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "sharded_counter.h"
+
+typedef enum { C_SEQ_CST, C_RELAXED, C_SHARDED_THREAD, C_SHARDED_CPU } counter_kind_t;
+
+static const char *counter_names[] = {"seq_cst", "relaxed", "sharded_thread", "sharded_cpu"};
+
+typedef struct {
+    counter_kind_t kind;
+    _Alignas(CACHE_LINE_SIZE) int64_t word;  // Shared counter for seq_cst/relaxed
+    sharded_counter_t sharded;
+    size_t increments;
+    atomic_bool start;
+} bench_counter_t;
+
+static void *counter_function(void *arg) {
+    bench_counter_t *bc = (bench_counter_t *)arg;
+    while (!atomic_load_explicit(&bc->start, memory_order_acquire)) {
+        cpu_relax();
+    }
+
+    size_t n = bc->increments;
+    switch (bc->kind) {
+    case C_SEQ_CST:
+        for (size_t i = 0; i < n; i++) {
+            __atomic_fetch_add(&bc->word, 1, __ATOMIC_SEQ_CST);
+        }
+        break;
+    case C_RELAXED:
+        for (size_t i = 0; i < n; i++) {
+            __atomic_fetch_add(&bc->word, 1, __ATOMIC_RELAXED);
+        }
+        break;
+    case C_SHARDED_THREAD:
+    case C_SHARDED_CPU:
+        for (size_t i = 0; i < n; i++) {
+            sharded_counter_inc(&bc->sharded);
+        }
+        break;
+    }
+    return NULL;
+}
+
+static void run_counter_case(counter_kind_t kind, int threads, size_t increments) {
+    bench_counter_t bc;
+    bc.kind = kind;
+    bc.word = 0;
+    bc.increments = increments;
+    atomic_init(&bc.start, false);
+    sharded_counter_mode_t mode = kind == C_SHARDED_CPU ? SHARDED_COUNTER_PER_CPU : SHARDED_COUNTER_PER_THREAD;
+    if (sharded_counter_init(&bc.sharded, mode, 0) != 0) {
+        perror("sharded_counter_init");
+        exit(1);
+    }
+
+    pthread_t *tids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    if (tids == NULL) {
+        perror("run_counter_case");
+        exit(1);
+    }
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, counter_function, &bc) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+
+    uint64_t start = bench_now_ns();
+    atomic_store_explicit(&bc.start, true, memory_order_release);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_perf_stop(&perf);
+
+    int64_t total = kind == C_SEQ_CST || kind == C_RELAXED ? bc.word : sharded_counter_read(&bc.sharded);
+    double total_incs = (double)increments * threads;
+    printf("%-15s %8d %10.2f %14.0f %6s\n", counter_names[kind], threads,
+           (double)elapsed / total_incs, total_incs * 1e9 / (double)elapsed,
+           total == (int64_t)(increments * threads) ? "ok" : "FAIL");
+    fflush(stdout);
+    bench_perf_report(&perf, total_incs, "%s threads=%d", counter_names[kind], threads);
+
+    free(tids);
+    sharded_counter_destroy(&bc.sharded);
+}
+
+// ns per call of both sharded reads, from the calling thread
+static void run_read_case(size_t reads) {
+    sharded_counter_t c;
+    if (sharded_counter_init(&c, SHARDED_COUNTER_PER_THREAD, 0) != 0) {
+        perror("sharded_counter_init");
+        exit(1);
+    }
+    sharded_counter_add(&c, 1);
+
+    volatile int64_t sink = 0;
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < reads; i++) {
+        sink += sharded_counter_read(&c);
+    }
+    uint64_t exact = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (size_t i = 0; i < reads; i++) {
+        sink += sharded_counter_read_approx(&c);
+    }
+    uint64_t approx = bench_now_ns() - start;
+    (void)sink;
+
+    printf("\nReads with %u shards: exact %.2f ns, approx %.2f ns (error bound %d)\n",
+           c.mask + 1, (double)exact / (double)reads, (double)approx / (double)reads,
+           (int)(c.mask + 1) * SHARDED_COUNTER_BATCH);
+    sharded_counter_destroy(&c);
+}
+
+int main(int argc, char **argv) {
+    size_t increments = 10000000;
+    int max_threads = bench_num_cpus();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:h")) != -1) {
+        switch (opt) {
+        case 'n': increments = (size_t)atol(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n increments_per_thread] [-t max_threads]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (increments == 0 || max_threads <= 0) {
+        fprintf(stderr, "Usage: %s [-n increments_per_thread] [-t max_threads]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Counter benchmark: %d CPUs, batch %d\n", bench_num_cpus(), SHARDED_COUNTER_BATCH);
+    printf("%-15s %8s %10s %14s %6s\n", "counter", "threads", "ns/inc", "incs/s", "check");
+
+    for (int threads = 1; threads != 0; threads = bench_next_threads(threads, max_threads)) {
+        for (int k = C_SEQ_CST; k <= C_SHARDED_CPU; k++) {
+            run_counter_case((counter_kind_t)k, threads, increments);
+        }
+    }
+
+    run_read_case(increments);
+    return 0;
+}
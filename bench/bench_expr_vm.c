@@ -0,0 +1,219 @@
+/**
+ * bench_expr_vm.c - Formula evaluation: indirect calls vs bytecode dispatch
+ *
+ * Builds a set of random formulas over two inputs (r0, r1). The formulas
+ * mix constants and inputs, so part of every formula can be folded. Each
+ * formula is evaluated for many input pairs four ways:
+ * 1. calls     - the operations[] approach: a loop over the bytecode that
+ *                makes one indirect call through a function-pointer table
+ *                per arithmetic instruction
+ * 2. switch    - expr_vm_run_switch()
+ * 3. threaded  - expr_vm_run_threaded() (computed goto)
+ * 4. folded    - expr_program_fold() output run by expr_vm_run()
+ *
+ * Each formula runs on a batch of consecutive inputs before the next one
+ * takes over, like a formula applied to the rows of a table. With -b 1
+ * every call is a different formula.
+ *
+ * Prints formulas per second and ns per instruction of the original
+ * program, and checks that every way produced the same results.
+ *
+ * Usage: bench_expr_vm [-n evaluations] [-f formulas] [-l length] [-b batch]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "expr_vm.h"
+
+// ---------------------------------------------------------------------------
+// The operations[] table from function_pointer_examples
+// ---------------------------------------------------------------------------
+
+static int add(int a, int b) { return expr_apply(EXPR_OP_ADD, a, b); }
+static int subtract(int a, int b) { return expr_apply(EXPR_OP_SUB, a, b); }
+static int multiply(int a, int b) { return expr_apply(EXPR_OP_MUL, a, b); }
+static int divide(int a, int b) { return expr_apply(EXPR_OP_DIV, a, b); }
+
+static int (*const operations[4])(int, int) = {add, subtract, multiply, divide};
+
+// Evaluate a program with one call through operations[] per arithmetic op.
+// noinline keeps the compiler from turning the table back into a switch.
+static __attribute__((noinline)) int run_calls(const expr_program_t *p, int *regs) {
+    const uint32_t *pc = p->code;
+    for (;;) {
+        uint32_t w = *pc++;
+        unsigned op = EXPR_OPCODE(w);
+        if (op <= EXPR_OP_DIV) {
+            regs[EXPR_DST(w)] = operations[op](regs[EXPR_A(w)], regs[EXPR_B(w)]);
+        } else if (op == EXPR_OP_MOV) {
+            regs[EXPR_DST(w)] = regs[EXPR_A(w)];
+        } else if (op == EXPR_OP_IMM) {
+            regs[EXPR_DST(w)] = (int)*pc++;
+        } else {
+            return regs[EXPR_A(w)];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Formula generation
+// ---------------------------------------------------------------------------
+
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// `length` instructions: small constants go to r2..r5, then the first
+// third of the operations combine only those constants (the part the
+// folder removes), and the rest read any register and write r2..r7.
+static void build_formula(expr_program_t *p, int length) {
+    for (int r = 2; r < 6; r++) {
+        expr_emit_imm(p, r, (int)(rng_next() % 19) - 9);
+    }
+    int last = 2;
+    int ops = length - 5;
+    for (int i = 0; i < ops; i++) {
+        expr_opcode_t op = (expr_opcode_t)(rng_next() % 4);
+        bool constant = i < ops / 3;
+        int dst = constant ? 2 + (int)(rng_next() % 4) : 2 + (int)(rng_next() % 6);
+        int a = constant ? 2 + (int)(rng_next() % 4) : (int)(rng_next() % 8);
+        int b = constant ? 2 + (int)(rng_next() % 4) : (int)(rng_next() % 8);
+        expr_emit(p, op, dst, a, b);
+        last = dst;
+    }
+    expr_emit_halt(p, last);
+}
+
+// Instructions in a program (IMM counts once even though it takes two words)
+static size_t count_instructions(const expr_program_t *p) {
+    size_t n = 0;
+    for (size_t i = 0; i < p->len; i++, n++) {
+        if (EXPR_OPCODE(p->code[i]) == EXPR_OP_IMM) {
+            i++;
+        }
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+typedef int (*run_fn)(const expr_program_t *, int *);
+
+static int run_folded(const expr_program_t *p, int *regs) {
+    return expr_vm_run(p, regs);
+}
+
+// Formulas take turns; each one runs on `batch` consecutive input pairs
+static uint64_t evaluate_all(const char *name, run_fn run, const expr_program_t *programs, int formulas,
+                             size_t evaluations, size_t batch, uint64_t *checksum) {
+    uint64_t sum = 0;
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    for (size_t e = 0; e < evaluations; e++) {
+        int regs[EXPR_VM_REGS] = {(int)e, (int)(e * 7 + 3)};
+        sum += (unsigned)run(&programs[(e / batch) % formulas], regs);
+    }
+    *checksum = sum;
+    uint64_t ns = bench_now_ns() - t0;
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, (double)evaluations, "%s formulas=%d batch=%zu", name, formulas, batch);
+    return ns;
+}
+
+int main(int argc, char **argv) {
+    size_t evaluations = 4000000;
+    int formulas = 1024;
+    int length = 16;
+    size_t batch = 64;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:l:b:h")) != -1) {
+        switch (opt) {
+        case 'n': evaluations = (size_t)atol(optarg); break;
+        case 'f': formulas = atoi(optarg); break;
+        case 'l': length = atoi(optarg); break;
+        case 'b': batch = (size_t)atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n evaluations] [-f formulas] [-l length] [-b batch]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (evaluations == 0 || formulas <= 0 || length < 5 || batch == 0) {
+        fprintf(stderr, "Usage: %s [-n evaluations] [-f formulas] [-l length >= 5] [-b batch]\n", argv[0]);
+        return 1;
+    }
+
+    expr_program_t *programs = (expr_program_t *)malloc(formulas * sizeof(expr_program_t));
+    expr_program_t *folded = (expr_program_t *)malloc(formulas * sizeof(expr_program_t));
+    if (programs == NULL || folded == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    size_t original_ins = 0, folded_ins = 0;
+    for (int f = 0; f < formulas; f++) {
+        expr_program_init(&programs[f]);
+        expr_program_init(&folded[f]);
+        build_formula(&programs[f], length);
+        if (programs[f].code == NULL || expr_program_fold(&folded[f], &programs[f]) != 0) {
+            perror("build_formula");
+            return 1;
+        }
+        original_ins += count_instructions(&programs[f]);
+        folded_ins += count_instructions(&folded[f]);
+    }
+
+    printf("Expression VM benchmark: %d formulas, %.1f instructions each (%.1f after folding), batch %zu\n",
+           formulas, (double)original_ins / formulas, (double)folded_ins / formulas, batch);
+    printf("%-10s %14s %10s %10s %6s\n", "dispatch", "formulas/s", "ns/formula", "ns/insn", "check");
+
+    struct {
+        const char *name;
+        run_fn run;
+        const expr_program_t *programs;
+    } cases[] = {
+        {"calls", run_calls, programs},
+        {"switch", expr_vm_run_switch, programs},
+#ifdef EXPR_VM_COMPUTED_GOTO
+        {"threaded", expr_vm_run_threaded, programs},
+#endif
+        {"folded", run_folded, folded},
+    };
+
+    uint64_t expected = 0;
+    double insns_per_formula = (double)original_ins / formulas;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        uint64_t checksum;
+        uint64_t ns = evaluate_all(cases[c].name, cases[c].run, cases[c].programs, formulas,
+                                    evaluations, batch, &checksum);
+        if (c == 0) {
+            expected = checksum;
+        }
+        double per_formula = (double)ns / (double)evaluations;
+        printf("%-10s %14.0f %10.2f %10.3f %6s\n", cases[c].name, 1e9 / per_formula,
+               per_formula, per_formula / insns_per_formula, checksum == expected ? "ok" : "FAIL");
+        fflush(stdout);
+    }
+
+    for (int f = 0; f < formulas; f++) {
+        expr_program_free(&programs[f]);
+        expr_program_free(&folded[f]);
+    }
+    free(programs);
+    free(folded);
+    return 0;
+}
@@ -0,0 +1,223 @@
+/**
+ * bench_hash_map.c - Striped hash_map_t vs the same map behind one lock
+ *
+ * Every thread runs a random mix of lookups and writes on keys drawn from
+ * a fixed range; half of the writes insert, the other half remove. The map
+ * starts at its smallest size, so the first part of each run also
+ * measures incremental resizing. Compared variants:
+ * 1. global  - every operation takes one adaptive simple_lock_t (the
+ *              pattern simple_threading.c uses)
+ * 2. striped - hash_map_t's own striped writer locks and lock-free reads
+ *
+ * Each case prints operations per second and the p99 and worst write
+ * latency. The worst write shows whether any insert paid for a full
+ * rehash. A lookup that returns a value stored under another key counts
+ * as an error.
+ *
+ * Usage: bench_hash_map [-n ops_per_thread] [-t max_threads] [-k key_range]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "hash_map.h"
+
+typedef enum { M_GLOBAL, M_STRIPED } map_kind_t;
+
+static const char *map_names[] = {"global", "striped"};
+
+static const int read_percents[] = {50, 90, 99};
+#define NUM_READ_PERCENTS (int)(sizeof(read_percents) / sizeof(read_percents[0]))
+
+// Writes sampled for the latency percentiles, per thread
+#define MAX_WRITE_SAMPLES 1000000
+
+#define LOCK_STRIPES 64
+
+typedef struct {
+    map_kind_t kind;
+    hash_map_t map;
+    simple_lock_t global;     // Only used by M_GLOBAL
+    size_t ops;
+    int key_range;
+    int read_percent;
+} bench_map_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) bench_map_t *bm;
+    uint64_t seed;
+    uint64_t errors;
+    uint64_t max_write_ns;
+    bench_samples_t writes;
+} map_worker_t;
+
+// Every value encodes its key, so readers can check what they got
+static void *value_for(int key) {
+    return (void *)((uintptr_t)key * 2 + 1);
+}
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void *map_function(void *arg) {
+    map_worker_t *w = (map_worker_t *)arg;
+    bench_map_t *bm = w->bm;
+    bool global = bm->kind == M_GLOBAL;
+
+    for (size_t i = 0; i < bm->ops; i++) {
+        uint64_t r = next_random(&w->seed);
+        int key = (int)((r >> 8) % (uint64_t)bm->key_range);
+        if ((int)(r % 100) < bm->read_percent) {
+            void *v = NULL;
+            if (global) {
+                simple_lock_acquire(&bm->global);
+            }
+            bool found = hash_map_get(&bm->map, key, &v);
+            if (global) {
+                simple_lock_release(&bm->global);
+            }
+            w->errors += found && v != value_for(key);
+            continue;
+        }
+
+        uint64_t start = bench_now_ns();
+        if (global) {
+            simple_lock_acquire(&bm->global);
+        }
+        if (r & 0x80) {
+            if (hash_map_put(&bm->map, key, value_for(key)) != 0) {
+                perror("hash_map_put");
+                exit(1);
+            }
+        } else {
+            hash_map_remove(&bm->map, key, NULL);
+        }
+        if (global) {
+            simple_lock_release(&bm->global);
+        }
+        uint64_t elapsed = bench_now_ns() - start;
+        bench_samples_add(&w->writes, elapsed);
+        if (elapsed > w->max_write_ns) {
+            w->max_write_ns = elapsed;
+        }
+    }
+    return NULL;
+}
+
+static void run_map_case(map_kind_t kind, int threads, size_t ops, int key_range, int read_percent) {
+    bench_map_t bm;
+    bm.kind = kind;
+    bm.ops = ops;
+    bm.key_range = key_range;
+    bm.read_percent = read_percent;
+    simple_lock_init_mode(&bm.global, SIMPLE_LOCK_ADAPTIVE);
+    if (hash_map_init(&bm.map, 0, LOCK_STRIPES) != 0) {
+        perror("hash_map_init");
+        exit(1);
+    }
+
+    pthread_t *tids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    map_worker_t *workers = (map_worker_t *)aligned_alloc(CACHE_LINE_SIZE, threads * sizeof(map_worker_t));
+    if (tids == NULL || workers == NULL) {
+        perror("run_map_case");
+        exit(1);
+    }
+
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < threads; i++) {
+        memset(&workers[i], 0, sizeof(map_worker_t));
+        workers[i].bm = &bm;
+        workers[i].seed = 0x9e3779b97f4a7c15ull * (uint64_t)(i + 1);
+        bench_samples_init(&workers[i].writes, MAX_WRITE_SAMPLES);
+        if (pthread_create(&tids[i], NULL, map_function, &workers[i]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_perf_stop(&perf);
+
+    uint64_t errors = 0;
+    uint64_t max_write = 0;
+    bench_samples_t writes;
+    bench_samples_init(&writes, 1);
+    for (int i = 0; i < threads; i++) {
+        errors += workers[i].errors;
+        if (workers[i].max_write_ns > max_write) {
+            max_write = workers[i].max_write_ns;
+        }
+        bench_samples_merge(&writes, &workers[i].writes);
+        bench_samples_free(&workers[i].writes);
+    }
+    bench_samples_sort(&writes);
+
+    double total_ops = (double)ops * threads;
+    printf("%-8s %8d %6d%% %14.0f %12.2f %12.2f %10zu %7llu\n", map_names[kind], threads, read_percent,
+           total_ops * 1e9 / (double)elapsed,
+           (double)bench_samples_percentile(&writes, 0.99) / 1000.0, (double)max_write / 1000.0,
+           hash_map_size(&bm.map), (unsigned long long)errors);
+    fflush(stdout);
+    bench_perf_report(&perf, total_ops, "%s threads=%d read_pct=%d keys=%d", map_names[kind], threads,
+                      read_percent, key_range);
+
+    bench_samples_free(&writes);
+    hash_map_destroy(&bm.map);
+    free(workers);
+    free(tids);
+}
+
+int main(int argc, char **argv) {
+    size_t ops = 1000000;
+    int max_threads = bench_num_cpus();
+    int key_range = 65536;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:k:h")) != -1) {
+        switch (opt) {
+        case 'n': ops = (size_t)atol(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        case 'k': key_range = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n ops_per_thread] [-t max_threads] [-k key_range]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (ops == 0 || max_threads <= 0 || key_range <= 0) {
+        fprintf(stderr, "Usage: %s [-n ops_per_thread] [-t max_threads] [-k key_range]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Hash map benchmark: %d CPUs, %d keys, %d stripes, resize chunk %d\n",
+           bench_num_cpus(), key_range, LOCK_STRIPES, HASH_MAP_MIGRATE_CHUNK);
+    printf("%-8s %8s %7s %14s %12s %12s %10s %7s\n",
+           "map", "threads", "reads", "ops/s", "p99 write us", "max write us", "size", "errors");
+
+    for (int threads = 1; threads != 0; threads = bench_next_threads(threads, max_threads)) {
+        for (int r = 0; r < NUM_READ_PERCENTS; r++) {
+            for (int k = M_GLOBAL; k <= M_STRIPED; k++) {
+                run_map_case((map_kind_t)k, threads, ops, key_range, read_percents[r]);
+            }
+        }
+    }
+
+    return 0;
+}
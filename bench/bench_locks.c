@@ -0,0 +1,527 @@
+/**
+ * bench_locks.c - Lock contention benchmark
+ *
+ * Runs every lock from simple_lock.h, cohort_lock.h and rw_lock.h against pthread_mutex_t and
+ * pthread_spinlock_t and sweeps:
+ * 1. Thread count, from 1 up to the number of online CPUs
+ * 2. Critical-section length, from empty to about 10µs
+ * 3. Read/write ratio (reads take the shared side when a lock has one)
+ *
+ * For each case it reports throughput in acquisitions per second and the
+ * p50/p99/p999 time spent inside acquire.
+ *
+ * Every sweep runs once per thread placement policy from affinity.h: none,
+ * compact and scatter unless -p picks others. Compact keeps the lock's
+ * cache line within one core or socket; scatter makes it cross sockets.
+ *
+ * With -f it instead measures false sharing: every thread uses a private
+ * lock and counter, laid out either packed together or one per cache line.
+ *
+ * Usage: bench_locks [-d ms_per_case] [-t max_threads] [-l lock_name] [-p placement]... [-f]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "simple_lock.h"
+#include "rw_lock.h"
+#include "affinity.h"
+#include "cohort_lock.h"
+
+// Latency samples kept per thread and case
+#define SAMPLES_PER_THREAD (1 << 16)
+
+// Words of shared data touched inside the critical section
+#define SHARED_WORDS 8
+
+// Most -p options accepted
+#define MAX_PLACEMENTS 8
+
+// A placement policy as given on the command line, and the CPUs it picked
+typedef struct {
+    const char *spec;
+    affinity_plan_t plan;
+} placement_t;
+
+// Start `fn` on thread `index` of `placement`; exits on failure
+static void start_thread(pthread_t *tid, const placement_t *placement, int index,
+                         void *(*fn)(void *), void *arg) {
+    pthread_attr_t attr;
+    if (affinity_attr_init(&attr, &placement->plan, index) != 0 ||
+        pthread_create(tid, &attr, fn, arg) != 0) {
+        perror("Failed to create thread");
+        exit(1);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+// ---------------------------------------------------------------------------
+// Lock adapters
+// ---------------------------------------------------------------------------
+
+// Any lock under test, padded so it never shares a line with its neighbours
+typedef union {
+    simple_lock_t simple;
+    ticket_lock_t ticket;
+    mcs_lock_t mcs;
+    cohort_lock_t cohort;
+    rw_lock_t rw;
+    pthread_mutex_t mutex;
+    pthread_spinlock_t spin;
+    char pad[2 * CACHE_LINE_SIZE];
+} any_lock_t;
+
+// Table entry describing how to drive one lock type, in the same spirit as
+// the operations[] function-pointer table in pointer_examples.c
+typedef struct {
+    const char *name;
+    void (*init)(any_lock_t *lock);
+    void (*acquire)(any_lock_t *lock);
+    void (*release)(any_lock_t *lock);
+    void (*acquire_shared)(any_lock_t *lock); // NULL: readers use acquire
+    void (*release_shared)(any_lock_t *lock); // NULL: readers use release
+    void (*destroy)(any_lock_t *lock);        // NULL: nothing to clean up
+} lock_ops_t;
+
+static void simple_sleep_init(any_lock_t *l) { simple_lock_init(&l->simple); }
+static void simple_adaptive_init(any_lock_t *l) { simple_lock_init_mode(&l->simple, SIMPLE_LOCK_ADAPTIVE); }
+static void simple_acquire(any_lock_t *l) { simple_lock_acquire(&l->simple); }
+static void simple_release(any_lock_t *l) { simple_lock_release(&l->simple); }
+
+static void ticket_init(any_lock_t *l) { ticket_lock_init(&l->ticket); }
+static void ticket_acquire(any_lock_t *l) { ticket_lock_acquire(&l->ticket); }
+static void ticket_release(any_lock_t *l) { ticket_lock_release(&l->ticket); }
+
+static void mcs_init(any_lock_t *l) { mcs_lock_init(&l->mcs); }
+static void mcs_acquire(any_lock_t *l) { mcs_lock_acquire(&l->mcs); }
+static void mcs_release(any_lock_t *l) { mcs_lock_release(&l->mcs); }
+
+static void cohort_init(any_lock_t *l) { cohort_lock_init(&l->cohort); }
+static void cohort_acquire(any_lock_t *l) { cohort_lock_acquire(&l->cohort); }
+static void cohort_release(any_lock_t *l) { cohort_lock_release(&l->cohort); }
+
+static void rw_central_init(any_lock_t *l) { rw_lock_init(&l->rw); }
+static void rw_acquire(any_lock_t *l) { rw_lock_acquire_exclusive(&l->rw); }
+static void rw_release(any_lock_t *l) { rw_lock_release_exclusive(&l->rw); }
+static void rw_acquire_shared(any_lock_t *l) { rw_lock_acquire_shared(&l->rw); }
+static void rw_release_shared(any_lock_t *l) { rw_lock_release_shared(&l->rw); }
+static void rw_destroy(any_lock_t *l) { rw_lock_destroy(&l->rw); }
+
+static void rw_percpu_init(any_lock_t *l) {
+    if (rw_lock_init_mode(&l->rw, RW_LOCK_PER_CPU) != 0) {
+        perror("rw_lock_init_mode");
+        exit(1);
+    }
+}
+
+static void mutex_init(any_lock_t *l) { pthread_mutex_init(&l->mutex, NULL); }
+static void mutex_acquire(any_lock_t *l) { pthread_mutex_lock(&l->mutex); }
+static void mutex_release(any_lock_t *l) { pthread_mutex_unlock(&l->mutex); }
+static void mutex_destroy(any_lock_t *l) { pthread_mutex_destroy(&l->mutex); }
+
+static void spin_init(any_lock_t *l) { pthread_spin_init(&l->spin, PTHREAD_PROCESS_PRIVATE); }
+static void spin_acquire(any_lock_t *l) { pthread_spin_lock(&l->spin); }
+static void spin_release(any_lock_t *l) { pthread_spin_unlock(&l->spin); }
+static void spin_destroy(any_lock_t *l) { pthread_spin_destroy(&l->spin); }
+
+static const lock_ops_t lock_table[] = {
+    {"simple_sleep",    simple_sleep_init,    simple_acquire, simple_release, NULL, NULL, NULL},
+    {"simple_adaptive", simple_adaptive_init, simple_acquire, simple_release, NULL, NULL, NULL},
+    {"ticket",          ticket_init,          ticket_acquire, ticket_release, NULL, NULL, NULL},
+    {"mcs",             mcs_init,             mcs_acquire,    mcs_release,    NULL, NULL, NULL},
+    {"cohort",          cohort_init,          cohort_acquire, cohort_release, NULL, NULL, NULL},
+    {"rw_central",      rw_central_init,      rw_acquire,     rw_release,
+                        rw_acquire_shared,    rw_release_shared,              rw_destroy},
+    {"rw_percpu",       rw_percpu_init,       rw_acquire,     rw_release,
+                        rw_acquire_shared,    rw_release_shared,              rw_destroy},
+    {"pthread_mutex",   mutex_init,           mutex_acquire,  mutex_release,  NULL, NULL, mutex_destroy},
+    {"pthread_spin",    spin_init,            spin_acquire,   spin_release,   NULL, NULL, spin_destroy},
+};
+
+#define NUM_LOCKS (sizeof(lock_table) / sizeof(lock_table[0]))
+
+// ---------------------------------------------------------------------------
+// Benchmark case
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const lock_ops_t *ops;
+    any_lock_t *lock;
+    uint64_t work_loops;        // Busy work inside the critical section
+    int read_pct;               // Percentage of acquisitions that are reads
+    volatile bool start;        // Released by main once all threads exist
+    volatile bool stop;         // Set by main when the case is over
+    _Alignas(CACHE_LINE_SIZE) uint64_t shared[SHARED_WORDS];
+} bench_case_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) bench_case_t *bc;
+    unsigned int seed;
+    uint64_t ops;
+    uint64_t checksum;
+    bench_samples_t samples;
+} worker_t;
+
+// xorshift32: cheap per-thread randomness for the read/write choice
+static inline unsigned int next_random(unsigned int *state) {
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void *worker_function(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    bench_case_t *bc = w->bc;
+    const lock_ops_t *ops = bc->ops;
+
+    unsigned int spins = 0;
+    while (!__atomic_load_n(&bc->start, __ATOMIC_ACQUIRE)) {
+        spin_wait(&spins);
+    }
+
+    while (!__atomic_load_n(&bc->stop, __ATOMIC_RELAXED)) {
+        bool is_read = (int)(next_random(&w->seed) % 100) < bc->read_pct;
+
+        uint64_t t0 = bench_now_ns();
+        if (is_read && ops->acquire_shared != NULL) {
+            ops->acquire_shared(bc->lock);
+        } else {
+            ops->acquire(bc->lock);
+        }
+        uint64_t t1 = bench_now_ns();
+        bench_samples_add(&w->samples, t1 - t0);
+
+        // Critical section: readers scan the shared words, writers bump them
+        if (is_read) {
+            for (int i = 0; i < SHARED_WORDS; i++) {
+                w->checksum += bc->shared[i];
+            }
+        } else {
+            for (int i = 0; i < SHARED_WORDS; i++) {
+                bc->shared[i]++;
+            }
+        }
+        bench_work(bc->work_loops);
+
+        if (is_read && ops->release_shared != NULL) {
+            ops->release_shared(bc->lock);
+        } else {
+            ops->release(bc->lock);
+        }
+        w->ops++;
+    }
+
+    return NULL;
+}
+
+static void run_case(const lock_ops_t *ops, const placement_t *placement, int threads, int cs_ns,
+                     int read_pct, double loops_per_us, int duration_ms) {
+    static any_lock_t lock_storage __attribute__((aligned(CACHE_LINE_SIZE)));
+    bench_case_t bc;
+    memset(&bc, 0, sizeof(bc));
+    bc.ops = ops;
+    bc.lock = &lock_storage;
+    bc.work_loops = (uint64_t)(loops_per_us * cs_ns / 1000.0);
+    bc.read_pct = read_pct;
+    ops->init(bc.lock);
+
+    pthread_t *tids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    worker_t *workers = (worker_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                  threads * sizeof(worker_t));
+    if (tids == NULL || workers == NULL) {
+        perror("run_case");
+        exit(1);
+    }
+
+    bench_perf_t perf;
+    bench_perf_start(&perf);  // Before the threads, so that they are counted
+    for (int i = 0; i < threads; i++) {
+        memset(&workers[i], 0, sizeof(worker_t));
+        workers[i].bc = &bc;
+        workers[i].seed = 0x9e3779b9u * (unsigned int)(i + 1);
+        bench_samples_init(&workers[i].samples, SAMPLES_PER_THREAD);
+        start_thread(&tids[i], placement, i, worker_function, &workers[i]);
+    }
+
+    uint64_t begin = bench_now_ns();
+    __atomic_store_n(&bc.start, true, __ATOMIC_RELEASE);
+    usleep((useconds_t)duration_ms * 1000);
+    __atomic_store_n(&bc.stop, true, __ATOMIC_RELAXED);
+
+    bench_samples_t all;
+    bench_samples_init(&all, SAMPLES_PER_THREAD);
+    uint64_t total_ops = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        total_ops += workers[i].ops;
+        bench_samples_merge(&all, &workers[i].samples);
+        bench_samples_free(&workers[i].samples);
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+    bench_perf_stop(&perf);
+
+    bench_samples_sort(&all);
+    printf("%-16s %-9s %7d %7d %6d%% %14.0f %9llu %9llu %9llu\n",
+           ops->name, placement->spec, threads, cs_ns, read_pct,
+           (double)total_ops * 1e9 / (double)elapsed,
+           (unsigned long long)bench_samples_percentile(&all, 0.50),
+           (unsigned long long)bench_samples_percentile(&all, 0.99),
+           (unsigned long long)bench_samples_percentile(&all, 0.999));
+    bench_perf_report(&perf, (double)total_ops, "%s placement=%s threads=%d cs_ns=%d read_pct=%d",
+                      ops->name, placement->spec, threads, cs_ns, read_pct);
+#ifdef SIMPLE_LOCK_STATS
+    // Built with make LOCK_STATS=1: show what the lock itself recorded
+    if (ops->init == simple_sleep_init || ops->init == simple_adaptive_init) {
+        bc.lock->simple.stats.name = ops->name;
+        lock_stats_dump(stdout, &bc.lock->simple.stats, 0, false);
+    }
+#endif
+    fflush(stdout);
+
+    bench_samples_free(&all);
+    if (ops->destroy != NULL) {
+        ops->destroy(bc.lock);
+    }
+    free(workers);
+    free(tids);
+}
+
+// ---------------------------------------------------------------------------
+// False-sharing mode
+// ---------------------------------------------------------------------------
+
+// Each thread increments its own counter under its own lock, so there is no
+// logical contention at all. With the packed layout PACKED_PER_LINE
+// lock+counter pairs share every cache line; with the padded layout each
+// pair has its own.
+typedef struct {
+    simple_lock_t lock;
+    uint64_t counter;
+} packed_counter_t;
+
+#define PACKED_PER_LINE (CACHE_LINE_SIZE / sizeof(packed_counter_t))
+
+typedef struct {
+    padded_simple_lock_t lock;  // Fills whole lines by itself
+    uint64_t counter;           // Starts the next line, shared with nobody
+} padded_counter_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) simple_lock_t *lock;
+    uint64_t *counter;
+    volatile bool *start;
+    volatile bool *stop;
+    uint64_t ops;
+} fs_worker_t;
+
+static void *false_sharing_worker(void *arg) {
+    fs_worker_t *w = (fs_worker_t *)arg;
+
+    unsigned int spins = 0;
+    while (!__atomic_load_n(w->start, __ATOMIC_ACQUIRE)) {
+        spin_wait(&spins);
+    }
+    while (!__atomic_load_n(w->stop, __ATOMIC_RELAXED)) {
+        simple_lock_acquire(w->lock);
+        (*w->counter)++;
+        simple_lock_release(w->lock);
+        w->ops++;
+    }
+    return NULL;
+}
+
+static void run_false_sharing_case(bool padded, const placement_t *placement, int threads,
+                                   int duration_ms) {
+    packed_counter_t *packed = NULL;
+    padded_counter_t *pads = NULL;
+    pthread_t *tids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    fs_worker_t *workers = (fs_worker_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                        threads * sizeof(fs_worker_t));
+    if (tids == NULL || workers == NULL) {
+        perror("run_false_sharing_case");
+        exit(1);
+    }
+
+    if (padded) {
+        pads = (padded_counter_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                 threads * sizeof(padded_counter_t));
+    } else {
+        size_t bytes = threads * sizeof(packed_counter_t);
+        bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        packed = (packed_counter_t *)aligned_alloc(CACHE_LINE_SIZE, bytes);
+    }
+    if (pads == NULL && packed == NULL) {
+        perror("run_false_sharing_case");
+        exit(1);
+    }
+
+    volatile bool start = false;
+    volatile bool stop = false;
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    for (int i = 0; i < threads; i++) {
+        memset(&workers[i], 0, sizeof(fs_worker_t));
+        if (padded) {
+            padded_simple_lock_init(&pads[i].lock);
+            pads[i].counter = 0;
+            workers[i].lock = &pads[i].lock.lock;
+            workers[i].counter = &pads[i].counter;
+        } else {
+            simple_lock_init(&packed[i].lock);
+            packed[i].counter = 0;
+            workers[i].lock = &packed[i].lock;
+            workers[i].counter = &packed[i].counter;
+        }
+        workers[i].start = &start;
+        workers[i].stop = &stop;
+        start_thread(&tids[i], placement, i, false_sharing_worker, &workers[i]);
+    }
+
+    uint64_t begin = bench_now_ns();
+    __atomic_store_n(&start, true, __ATOMIC_RELEASE);
+    usleep((useconds_t)duration_ms * 1000);
+    __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+
+    uint64_t total_ops = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        total_ops += workers[i].ops;
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+    bench_perf_stop(&perf);
+
+    printf("%-8s %-9s %7d %10zu %14.0f %14.0f\n",
+           padded ? "padded" : "packed", placement->spec, threads,
+           padded ? sizeof(padded_counter_t) : sizeof(packed_counter_t),
+           (double)total_ops * 1e9 / (double)elapsed,
+           (double)total_ops * 1e9 / (double)elapsed / threads);
+    bench_perf_report(&perf, (double)total_ops, "false_sharing %s placement=%s threads=%d",
+                      padded ? "padded" : "packed", placement->spec, threads);
+    fflush(stdout);
+
+    free(packed);
+    free(pads);
+    free(workers);
+    free(tids);
+}
+
+static void run_false_sharing(const placement_t *placements, int num_placements, int max_threads,
+                              int duration_ms) {
+    printf("False sharing: one private lock + counter per thread, %zu packed per cache line, %d ms per case\n",
+           PACKED_PER_LINE, duration_ms);
+    printf("%-8s %-9s %7s %10s %14s %14s\n",
+           "layout", "placement", "threads", "bytes/slot", "incr/s", "incr/s/thread");
+    for (int p = 0; p < num_placements; p++) {
+        for (int threads = 1; threads != 0; threads = bench_next_threads(threads, max_threads)) {
+            run_false_sharing_case(false, &placements[p], threads, duration_ms);
+            run_false_sharing_case(true, &placements[p], threads, duration_ms);
+        }
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-d ms_per_case] [-t max_threads] [-l lock_name] [-p placement]... [-f]\n",
+            prog);
+    fprintf(stderr, "  -p  none, compact, scatter or a CPU list like 0,2,4-7; repeatable\n");
+    fprintf(stderr, "      (default: none, compact and scatter)\n");
+    fprintf(stderr, "  -f  compare packed vs cache-line padded lock layouts (false sharing)\n");
+    fprintf(stderr, "Locks:");
+    for (size_t i = 0; i < NUM_LOCKS; i++) {
+        fprintf(stderr, " %s", lock_table[i].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+    int duration_ms = 200;
+    int max_threads = bench_num_cpus();
+    const char *only_lock = NULL;
+    bool false_sharing = false;
+    placement_t placements[MAX_PLACEMENTS];
+    int num_placements = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:l:p:fh")) != -1) {
+        switch (opt) {
+        case 'd': duration_ms = atoi(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        case 'l': only_lock = optarg; break;
+        case 'p':
+            if (num_placements == MAX_PLACEMENTS) {
+                usage(argv[0]);
+                return 1;
+            }
+            placements[num_placements++].spec = optarg;
+            break;
+        case 'f': false_sharing = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (duration_ms <= 0 || max_threads <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (num_placements == 0) {
+        const char *defaults[] = {"none", "compact", "scatter"};
+        for (int p = 0; p < 3; p++) {
+            placements[num_placements++].spec = defaults[p];
+        }
+    }
+    for (int p = 0; p < num_placements; p++) {
+        if (affinity_plan_init(&placements[p].plan, placements[p].spec) != 0) {
+            fprintf(stderr, "Invalid placement '%s'\n", placements[p].spec);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (false_sharing) {
+        run_false_sharing(placements, num_placements, max_threads, duration_ms);
+        return 0;
+    }
+
+    const int cs_lengths_ns[] = {0, 100, 1000, 10000};
+    const int read_pcts[] = {0, 50, 90};
+    double loops_per_us = bench_work_calibrate();
+
+    printf("Lock benchmark: %d CPUs, %d ms per case, %.0f work loops/us\n",
+           bench_num_cpus(), duration_ms, loops_per_us);
+    printf("%-16s %-9s %7s %7s %7s %14s %9s %9s %9s\n",
+           "lock", "placement", "threads", "cs_ns", "reads", "acq/s", "p50_ns", "p99_ns", "p999_ns");
+
+    for (size_t l = 0; l < NUM_LOCKS; l++) {
+        if (only_lock != NULL && strcmp(only_lock, lock_table[l].name) != 0) {
+            continue;
+        }
+        for (int p = 0; p < num_placements; p++) {
+            for (int threads = 1; threads != 0; threads = bench_next_threads(threads, max_threads)) {
+                for (size_t c = 0; c < sizeof(cs_lengths_ns) / sizeof(cs_lengths_ns[0]); c++) {
+                    for (size_t r = 0; r < sizeof(read_pcts) / sizeof(read_pcts[0]); r++) {
+                        run_case(&lock_table[l], &placements[p], threads, cs_lengths_ns[c],
+                                 read_pcts[r], loops_per_us, duration_ms);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int p = 0; p < num_placements; p++) {
+        affinity_plan_destroy(&placements[p].plan);
+    }
+    return 0;
+}
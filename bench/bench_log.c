@@ -0,0 +1,316 @@
+/**
+ * bench_log.c - Cost of a log call on the hot path: stdio vs async_log
+ *
+ * Every thread logs a fixed number of short formatted lines. Methods:
+ * 1. fprintf     - stdio on a shared FILE (its internal lock plus buffered write)
+ * 2. write       - snprintf plus one write(2) per line
+ * 3. async       - async_log_printf into the per-thread ring
+ * 4. async_raw   - async_log_write of a preformatted line (no formatting)
+ *
+ * Each call is timed individually, and the clock reads are included. The
+ * program prints mean ns/call and p50/p99/p999 latency. For the async
+ * methods, the time until the flusher has written everything is reported
+ * separately as "drain". Output goes to /dev/null unless -o names a file.
+ *
+ * A final check has CHECK_THREADS threads, more than one writev(2) batch
+ * can hold, each log one line per round between barriers while main
+ * flushes. It then reads the output back and prints ok if every line
+ * came out whole, exactly once.
+ *
+ * Usage: bench_log [-n lines_per_thread] [-t max_threads] [-o path]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "async_log.h"
+#include "barrier.h"
+
+// Big enough that the flusher keeps up with a burst from one thread
+#define BENCH_RING_SIZE (1u << 20)
+
+// Enough rings with pending lines to fill more than one drain batch
+#define CHECK_THREADS (ASYNC_LOG_MAX_IOV + 16)
+#define CHECK_ROUNDS 20
+
+typedef enum { LOG_FPRINTF, LOG_WRITE, LOG_ASYNC, LOG_ASYNC_RAW, LOG_METHODS } log_method_t;
+
+static const char *method_names[] = {"fprintf", "write", "async", "async_raw"};
+
+typedef struct {
+    log_method_t method;
+    int fd;
+    FILE *file;
+    async_log_t log;
+    size_t lines;
+    atomic_bool start;
+} log_bench_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) log_bench_t *b;
+    int id;
+    bench_samples_t samples;
+    uint64_t dropped;
+} log_worker_t;
+
+static void *log_worker(void *arg) {
+    log_worker_t *w = (log_worker_t *)arg;
+    log_bench_t *b = w->b;
+    char line[128];
+    int raw_len = snprintf(line, sizeof(line), "thread %d: preformatted line\n", w->id);
+
+    while (!atomic_load_explicit(&b->start, memory_order_acquire)) {
+        cpu_relax();
+    }
+
+    for (size_t i = 0; i < b->lines; i++) {
+        uint64_t t0 = bench_now_ns();
+        switch (b->method) {
+        case LOG_FPRINTF:
+            fprintf(b->file, "thread %d: line %zu value %d\n", w->id, i, (int)(i * 7));
+            break;
+        case LOG_WRITE: {
+            int n = snprintf(line, sizeof(line), "thread %d: line %zu value %d\n", w->id, i, (int)(i * 7));
+            if (write(b->fd, line, (size_t)n) < 0) {
+                perror("write");
+                exit(1);
+            }
+            break;
+        }
+        case LOG_ASYNC:
+            w->dropped += !async_log_printf(&b->log, "thread %d: line %zu value %d\n", w->id, i, (int)(i * 7));
+            break;
+        case LOG_ASYNC_RAW:
+            w->dropped += !async_log_write(&b->log, line, (size_t)raw_len);
+            break;
+        default:
+            break;
+        }
+        bench_samples_add(&w->samples, bench_now_ns() - t0);
+    }
+    return NULL;
+}
+
+static void run_case(log_method_t method, int threads, size_t lines, int fd) {
+    log_bench_t b;
+    memset(&b, 0, sizeof(b));
+    b.method = method;
+    b.fd = fd;
+    b.lines = lines;
+    // Started before async_log_init so that the writer thread is counted
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    if (method == LOG_FPRINTF) {
+        b.file = fdopen(dup(fd), "w");
+        if (b.file == NULL) {
+            perror("fdopen");
+            exit(1);
+        }
+    }
+    if ((method == LOG_ASYNC || method == LOG_ASYNC_RAW) &&
+        async_log_init(&b.log, fd, BENCH_RING_SIZE) != 0) {
+        perror("async_log_init");
+        exit(1);
+    }
+
+    pthread_t *tids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    log_worker_t *workers = (log_worker_t *)aligned_alloc(CACHE_LINE_SIZE, threads * sizeof(log_worker_t));
+    if (tids == NULL || workers == NULL) {
+        perror("run_case");
+        exit(1);
+    }
+    for (int i = 0; i < threads; i++) {
+        memset(&workers[i], 0, sizeof(log_worker_t));
+        workers[i].b = &b;
+        workers[i].id = i;
+        bench_samples_init(&workers[i].samples, lines);
+        if (pthread_create(&tids[i], NULL, log_worker, &workers[i]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+
+    atomic_store_explicit(&b.start, true, memory_order_release);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    uint64_t logged = bench_now_ns();
+
+    // Time until the output has really been handed to the kernel
+    if (method == LOG_FPRINTF) {
+        fclose(b.file);
+    } else if (method == LOG_ASYNC || method == LOG_ASYNC_RAW) {
+        async_log_destroy(&b.log);
+    }
+    uint64_t drained = bench_now_ns();
+    bench_perf_stop(&perf);
+
+    bench_samples_t all;
+    bench_samples_init(&all, (size_t)threads * lines);
+    uint64_t dropped = 0;
+    for (int i = 0; i < threads; i++) {
+        bench_samples_merge(&all, &workers[i].samples);
+        bench_samples_free(&workers[i].samples);
+        dropped += workers[i].dropped;
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < all.count; i++) {
+        sum += all.values[i];
+    }
+    bench_samples_sort(&all);
+
+    printf("%-10s %7d %10.1f %8llu %8llu %8llu %10.2f %10llu\n", method_names[method], threads,
+           (double)sum / (double)all.count,
+           (unsigned long long)bench_samples_percentile(&all, 0.50),
+           (unsigned long long)bench_samples_percentile(&all, 0.99),
+           (unsigned long long)bench_samples_percentile(&all, 0.999),
+           (double)(drained - logged) / 1e6, (unsigned long long)dropped);
+    fflush(stdout);
+    bench_perf_report(&perf, (double)threads * lines, "%s threads=%d", method_names[method], threads);
+
+    bench_samples_free(&all);
+    free(workers);
+    free(tids);
+}
+
+// ---------------------------------------------------------------------------
+// Many-threads check
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    async_log_t log;
+    barrier_t barrier;  // CHECK_THREADS workers plus main
+} log_check_t;
+
+typedef struct {
+    log_check_t *c;
+    int id;
+} log_check_worker_t;
+
+static void *log_check_worker(void *arg) {
+    log_check_worker_t *w = (log_check_worker_t *)arg;
+    for (int round = 0; round < CHECK_ROUNDS; round++) {
+        async_log_printf(&w->c->log, "check %d %d\n", w->id, round);
+        barrier_wait(&w->c->barrier); // Every thread has a line pending
+        barrier_wait(&w->c->barrier); // main has flushed them
+    }
+    return NULL;
+}
+
+// Log from CHECK_THREADS threads at once, then read the output back
+static void run_check(const char *dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/bench_log.XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        exit(1);
+    }
+
+    log_check_t c;
+    log_check_worker_t workers[CHECK_THREADS];
+    pthread_t tids[CHECK_THREADS];
+    if (async_log_init(&c.log, fd, 4096) != 0 || barrier_init(&c.barrier, CHECK_THREADS + 1) != 0) {
+        perror("run_check");
+        exit(1);
+    }
+    for (int i = 0; i < CHECK_THREADS; i++) {
+        workers[i].c = &c;
+        workers[i].id = i;
+        if (pthread_create(&tids[i], NULL, log_check_worker, &workers[i]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+    for (int round = 0; round < CHECK_ROUNDS; round++) {
+        barrier_wait(&c.barrier);
+        async_log_flush(&c.log);
+        barrier_wait(&c.barrier);
+    }
+    for (int i = 0; i < CHECK_THREADS; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    async_log_destroy(&c.log);
+
+    // Each thread's lines must all be there, in order
+    int next[CHECK_THREADS] = {0};
+    int lines = 0;
+    bool ok = true;
+    FILE *in = fdopen(fd, "r");
+    if (in == NULL || fseek(in, 0, SEEK_SET) != 0) {
+        perror(path);
+        exit(1);
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        int id, round;
+        char end;
+        if (sscanf(line, "check %d %d%c", &id, &round, &end) != 3 || end != '\n' ||
+            id < 0 || id >= CHECK_THREADS || round != next[id]) {
+            ok = false;
+            break;
+        }
+        next[id]++;
+        lines++;
+    }
+    fclose(in);
+    unlink(path);
+
+    printf("check: %d threads x %d rounds, %d lines read back %s\n", CHECK_THREADS, CHECK_ROUNDS, lines,
+           ok && lines == CHECK_THREADS * CHECK_ROUNDS ? "ok" : "FAIL");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    size_t lines = 200000;
+    int max_threads = bench_num_cpus();
+    const char *path = "/dev/null";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:o:h")) != -1) {
+        switch (opt) {
+        case 'n': lines = (size_t)atol(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        case 'o': path = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-n lines_per_thread] [-t max_threads] [-o path]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (lines == 0 || max_threads <= 0) {
+        fprintf(stderr, "Usage: %s [-n lines_per_thread] [-t max_threads] [-o path]\n", argv[0]);
+        return 1;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    printf("Logging benchmark: %d CPUs, %zu lines per thread to %s\n", bench_num_cpus(), lines, path);
+    printf("%-10s %7s %10s %8s %8s %8s %10s %10s\n",
+           "method", "threads", "ns/call", "p50", "p99", "p999", "drain_ms", "dropped");
+
+    for (int threads = 1; threads != 0; threads = bench_next_threads(threads, max_threads)) {
+        for (int m = 0; m < LOG_METHODS; m++) {
+            run_case((log_method_t)m, threads, lines, fd);
+        }
+    }
+
+    close(fd);
+
+    run_check(getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp");
+    return 0;
+}
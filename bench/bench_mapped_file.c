@@ -0,0 +1,245 @@
+/**
+ * bench_mapped_file.c - Loading an int array with read() vs mmap
+ *
+ * Writes a file of random ints through mapped_file_create, then sums it
+ * with array_sum after loading it in different ways:
+ * 1. read       - malloc a buffer and read() the whole file into it
+ * 2. mmap       - mapped_file_open with no hints
+ * 3. sequential - MAPPED_FILE_SEQUENTIAL
+ * 4. populate   - MAPPED_FILE_POPULATE (all page faults up front)
+ * 5. huge       - MAPPED_FILE_HUGE_PAGES | MAPPED_FILE_SEQUENTIAL
+ * 6. chunks     - mapped_chunks_t with a 4MB window
+ *
+ * Each case prints GB/s for open + sum + close (best of REPEATS), the
+ * minor and major page faults of that run, and whether the sum matched.
+ * A second table probes random ints through mappings with and without
+ * MAPPED_FILE_RANDOM. With -c every run starts with the file evicted from
+ * the page cache, so the numbers include the disk.
+ *
+ * Usage: bench_mapped_file [-m megabytes] [-c] [-d dir]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "array_kernels.h"
+#include "mapped_file.h"
+
+#define REPEATS 3
+
+#define CHUNK_SIZE (4u << 20)
+
+#define PROBES 1000000
+
+typedef enum { L_READ, L_MMAP, L_SEQUENTIAL, L_POPULATE, L_HUGE, L_CHUNKS, L_COUNT } load_kind_t;
+
+static const char *load_names[] = {"read", "mmap", "sequential", "populate", "huge", "chunks"};
+
+static const int load_flags[] = {
+    0, MAPPED_FILE_READ, MAPPED_FILE_SEQUENTIAL, MAPPED_FILE_POPULATE,
+    MAPPED_FILE_HUGE_PAGES | MAPPED_FILE_SEQUENTIAL, MAPPED_FILE_SEQUENTIAL,
+};
+
+// Drop the file's clean pages from the page cache
+static void evict(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+static long long load_and_sum(load_kind_t kind, const char *path, size_t bytes) {
+    long long sum = 0;
+    if (kind == L_READ) {
+        int *buf = (int *)malloc(bytes);
+        int fd = open(path, O_RDONLY);
+        if (buf == NULL || fd < 0) {
+            perror("read case");
+            exit(1);
+        }
+        size_t done = 0;
+        while (done < bytes) {
+            ssize_t got = read(fd, (char *)buf + done, bytes - done);
+            if (got <= 0) {
+                perror("read");
+                exit(1);
+            }
+            done += (size_t)got;
+        }
+        close(fd);
+        sum = array_sum(buf, bytes / sizeof(int));
+        free(buf);
+    } else if (kind == L_CHUNKS) {
+        mapped_chunks_t c;
+        if (mapped_chunks_open(&c, path, CHUNK_SIZE, load_flags[kind]) != 0) {
+            perror("mapped_chunks_open");
+            exit(1);
+        }
+        int more;
+        while ((more = mapped_chunks_next(&c)) > 0) {
+            size_t n;
+            const int *a = mapped_chunks_ints(&c, &n);
+            sum += array_sum(a, n);
+        }
+        if (more < 0) {
+            perror("mapped_chunks_next");
+            exit(1);
+        }
+        mapped_chunks_close(&c);
+    } else {
+        mapped_file_t f;
+        if (mapped_file_open(&f, path, load_flags[kind]) != 0) {
+            perror("mapped_file_open");
+            exit(1);
+        }
+        size_t n;
+        const int *a = mapped_file_ints(&f, &n);
+        sum = array_sum(a, n);
+        mapped_file_close(&f);
+    }
+    return sum;
+}
+
+static void run_load_case(load_kind_t kind, const char *path, size_t bytes, bool cold, long long expected) {
+    double best = 0;
+    long best_minor = 0, best_major = 0;
+    bool ok = true;
+    for (int r = 0; r < REPEATS; r++) {
+        if (cold) {
+            evict(path);
+        }
+        bench_memory_t before, after;
+        bench_memory_read(&before);
+        bench_perf_t perf;
+        bench_perf_start(&perf);
+        uint64_t t0 = bench_now_ns();
+        long long sum = load_and_sum(kind, path, bytes);
+        double seconds = (double)(bench_now_ns() - t0) / 1e9;
+        bench_perf_stop(&perf);
+        bench_memory_read(&after);
+        bench_perf_report(&perf, (double)(bytes / sizeof(int)), "load %s %s run=%d", load_names[kind],
+                          cold ? "cold" : "warm", r);
+        ok = ok && sum == expected;
+        double gbs = (double)bytes / seconds / 1e9;
+        if (gbs > best) {
+            best = gbs;
+            best_minor = after.minor_faults - before.minor_faults;
+            best_major = after.major_faults - before.major_faults;
+        }
+    }
+    printf("%-12s %10.2f %12ld %12ld %6s\n", load_names[kind], best, best_minor, best_major, ok ? "ok" : "FAIL");
+    fflush(stdout);
+}
+
+// ns per random int read through a fresh mapping
+static void run_probe_case(const char *name, const char *path, int flags, bool cold) {
+    if (cold) {
+        evict(path);
+    }
+    mapped_file_t f;
+    if (mapped_file_open(&f, path, flags) != 0) {
+        perror("mapped_file_open");
+        exit(1);
+    }
+    size_t n;
+    const int *a = mapped_file_ints(&f, &n);
+
+    bench_memory_t before, after;
+    bench_memory_read(&before);
+    uint64_t x = 88172645463325252ull; // xorshift64
+    long long sink = 0;
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < PROBES; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        sink += a[x % n];
+    }
+    double ns = (double)(bench_now_ns() - t0) / PROBES;
+    bench_perf_stop(&perf);
+    bench_memory_read(&after);
+    bench_perf_report(&perf, PROBES, "probe %s %s", name, cold ? "cold" : "warm");
+    __asm__ __volatile__("" : : "g"(sink) : "memory");
+    mapped_file_close(&f);
+
+    printf("%-12s %10.1f %12ld %12ld\n", name, ns, after.minor_faults - before.minor_faults,
+           after.major_faults - before.major_faults);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    size_t megabytes = 256;
+    bool cold = false;
+    const char *dir = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:cd:h")) != -1) {
+        switch (opt) {
+        case 'm': megabytes = (size_t)atol(optarg); break;
+        case 'c': cold = true; break;
+        case 'd': dir = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-m megabytes] [-c] [-d dir]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (megabytes == 0) {
+        fprintf(stderr, "Usage: %s [-m megabytes] [-c] [-d dir]\n", argv[0]);
+        return 1;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/bench_mapped_file.XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    // Generate the data straight into the page cache, then write it out so
+    // that eviction with -c can drop it
+    size_t bytes = megabytes << 20;
+    mapped_file_t out;
+    if (mapped_file_create(&out, path, bytes, MAPPED_FILE_SEQUENTIAL) != 0) {
+        perror("mapped_file_create");
+        unlink(path);
+        return 1;
+    }
+    size_t n;
+    int *a = mapped_file_ints(&out, &n);
+    long long expected = 0;
+    for (size_t i = 0; i < n; i++) {
+        a[i] = (int)(i * 2654435761u % 2001) - 1000;
+        expected += a[i];
+    }
+    if (mapped_file_sync(&out) != 0) {
+        perror("mapped_file_sync");
+    }
+    mapped_file_close(&out);
+
+    printf("Mapped file benchmark: %zuMB file in %s, %s page cache, kernels %s\n",
+           megabytes, dir, cold ? "cold" : "warm", array_kernels()->name);
+    printf("%-12s %10s %12s %12s %6s\n", "load", "GB/s", "minor flt", "major flt", "check");
+    for (int k = L_READ; k < L_COUNT; k++) {
+        run_load_case((load_kind_t)k, path, bytes, cold, expected);
+    }
+
+    printf("%-12s %10s %12s %12s\n", "probe", "ns/probe", "minor flt", "major flt");
+    run_probe_case("mmap", path, MAPPED_FILE_READ, cold);
+    run_probe_case("random", path, MAPPED_FILE_RANDOM, cold);
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * bench_matrix.c - Row-pointer (int**) matrix vs contiguous matrix_t
+ *
+ * For square-ish sizes from 3x4 up to 8192x8192 it measures:
+ * 1. alloc+free  - rows + 1 callocs/frees vs one aligned allocation
+ * 2. row-major   - summing every element along rows
+ * 3. col-major   - summing every element down columns
+ *
+ * Traversal times are in ns per element, averaged over enough repetitions
+ * to touch at least ~32M elements per measurement.
+ *
+ * Usage: bench_matrix [-m max_dim]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "matrix.h"
+
+#define TARGET_ELEMENTS (32u << 20)
+
+// ---------------------------------------------------------------------------
+// The layout from pointer_to_pointer_examples
+// ---------------------------------------------------------------------------
+
+static int **ptr_matrix_alloc(size_t rows, size_t cols) {
+    int **m = (int **)malloc(rows * sizeof(int *));
+    if (m == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < rows; i++) {
+        m[i] = (int *)calloc(cols, sizeof(int));
+        if (m[i] == NULL) {
+            perror("calloc");
+            exit(1);
+        }
+    }
+    return m;
+}
+
+static void ptr_matrix_free(int **m, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        free(m[i]);
+    }
+    free(m);
+}
+
+static long long ptr_matrix_sum_row_major(int **m, size_t rows, size_t cols) {
+    long long sum = 0;
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            sum += m[i][j];
+        }
+    }
+    return sum;
+}
+
+static long long ptr_matrix_sum_col_major(int **m, size_t rows, size_t cols) {
+    long long sum = 0;
+    for (size_t j = 0; j < cols; j++) {
+        for (size_t i = 0; i < rows; i++) {
+            sum += m[i][j];
+        }
+    }
+    return sum;
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+// Counters for the section being timed
+static bench_perf_t perf;
+
+static void perf_report(const char *size, const char *section, double ops) {
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, ops, "%s %s", size, section);
+}
+
+static void run_size(size_t rows, size_t cols) {
+    size_t elements = rows * cols;
+    int reps = (int)(TARGET_ELEMENTS / elements);
+    if (reps < 1) {
+        reps = 1;
+    }
+    int alloc_reps = reps < 1000 ? reps : 1000;
+    char size[32];
+    snprintf(size, sizeof(size), "%zux%zu", rows, cols);
+
+    // Allocation cost
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    for (int r = 0; r < alloc_reps; r++) {
+        int **pm = ptr_matrix_alloc(rows, cols);
+        ptr_matrix_free(pm, rows);
+    }
+    uint64_t ptr_alloc = (bench_now_ns() - t0) / alloc_reps;
+    perf_report(size, "ptr_alloc", alloc_reps);
+
+    bench_perf_start(&perf);
+    t0 = bench_now_ns();
+    for (int r = 0; r < alloc_reps; r++) {
+        matrix_t m;
+        if (matrix_init(&m, rows, cols) != 0) {
+            perror("matrix_init");
+            exit(1);
+        }
+        matrix_free(&m);
+    }
+    uint64_t contig_alloc = (bench_now_ns() - t0) / alloc_reps;
+    perf_report(size, "contig_alloc", alloc_reps);
+
+    // Traversal cost, on identical contents
+    int **pm = ptr_matrix_alloc(rows, cols);
+    matrix_t m;
+    if (pm == NULL || matrix_init(&m, rows, cols) != 0) {
+        perror("allocation");
+        exit(1);
+    }
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            pm[i][j] = (int)((i * cols + j) & 0xff);
+            *matrix_at(&m, i, j) = pm[i][j];
+        }
+    }
+
+    long long check_ptr = 0, check_contig = 0;
+    double ns[4];
+    double visits = (double)reps * elements;
+
+    bench_perf_start(&perf);
+    t0 = bench_now_ns();
+    for (int r = 0; r < reps; r++) check_ptr += ptr_matrix_sum_row_major(pm, rows, cols);
+    ns[0] = (double)(bench_now_ns() - t0) / visits;
+    perf_report(size, "ptr_row", visits);
+
+    bench_perf_start(&perf);
+    t0 = bench_now_ns();
+    for (int r = 0; r < reps; r++) check_contig += matrix_sum_row_major(&m);
+    ns[1] = (double)(bench_now_ns() - t0) / visits;
+    perf_report(size, "contig_row", visits);
+
+    bench_perf_start(&perf);
+    t0 = bench_now_ns();
+    for (int r = 0; r < reps; r++) check_ptr += ptr_matrix_sum_col_major(pm, rows, cols);
+    ns[2] = (double)(bench_now_ns() - t0) / visits;
+    perf_report(size, "ptr_col", visits);
+
+    bench_perf_start(&perf);
+    t0 = bench_now_ns();
+    for (int r = 0; r < reps; r++) check_contig += matrix_sum_col_major(&m);
+    ns[3] = (double)(bench_now_ns() - t0) / visits;
+    perf_report(size, "contig_col", visits);
+
+    printf("%-11s %12llu %12llu %9.3f %9.3f %9.3f %9.3f %6s\n", size,
+           (unsigned long long)ptr_alloc, (unsigned long long)contig_alloc,
+           ns[0], ns[1], ns[2], ns[3], check_ptr == check_contig ? "ok" : "FAIL");
+    fflush(stdout);
+
+    ptr_matrix_free(pm, rows);
+    matrix_free(&m);
+}
+
+int main(int argc, char **argv) {
+    size_t max_dim = 8192;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:h")) != -1) {
+        switch (opt) {
+        case 'm': max_dim = (size_t)atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-m max_dim]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    printf("Matrix layout benchmark (alloc in ns per matrix, traversal in ns/element)\n");
+    printf("%-11s %12s %12s %9s %9s %9s %9s %6s\n", "size",
+           "alloc_ptr", "alloc_contig", "row_ptr", "row_cont", "col_ptr", "col_cont", "check");
+
+    // The 3x4 example from pointer_to_pointer_examples, then square sizes
+    const size_t dims[] = {64, 256, 1024, 2048, 4096, 8192};
+    run_size(3, 4);
+    for (size_t d = 0; d < sizeof(dims) / sizeof(dims[0]) && dims[d] <= max_dim; d++) {
+        run_size(dims[d], dims[d]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,339 @@
+/**
+ * bench_matrix_kernels.c - Transpose and multiply: naive vs blocked vs parallel
+ *
+ * For square matrices from 256x256 up to max_dim it runs every kernel in
+ * matrix_kernels.h, plus the same naive loops over the int** layout from
+ * pointer_to_pointer_examples:
+ * 1. ptr_naive    - int** rows, textbook loops
+ * 2. naive        - matrix_t, textbook loops
+ * 3. tiled_rows   - blocked multiply on scale_add, one row of c at a time
+ * 4. tiled        - blocked, with the best block kernel (AVX2 registers)
+ * 5. recursive    - cache-oblivious
+ * 6. parallel     - tiled, split across a thread_pool_t
+ *
+ * Transposes report GB/s (bytes read plus bytes written), multiplies
+ * report GOP/s counting one multiply and one add per inner step (2n^3
+ * integer operations). Every result is compared with the naive kernel,
+ * or with the tiled one for sizes where the naive multiply would take
+ * minutes.
+ * With BENCH_PERF set the parallel rows count only the calling thread,
+ * since the pool's workers were started before the case (see bench_perf.h).
+ *
+ * Usage: bench_matrix_kernels [-m max_dim] [-t threads]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "matrix_kernels.h"
+
+// Each transpose measurement moves at least this many elements
+#define TARGET_ELEMENTS (32u << 20)
+
+// Each multiply measurement does at least this many operations
+#define TARGET_OPS (1ull << 31)
+
+// Larger naive multiplies are skipped: they run at a few hundred MOP/s
+#define NAIVE_MAX_DIM 1024
+
+typedef enum {
+    K_PTR_NAIVE, K_NAIVE, K_TILED_ROWS, K_TILED, K_RECURSIVE, K_PARALLEL, K_COUNT
+} kernel_kind_t;
+
+static const char *kernel_names[] = {"ptr_naive", "naive", "tiled_rows", "tiled", "recursive", "parallel"};
+
+static thread_pool_t pool;
+
+// ---------------------------------------------------------------------------
+// The layout from pointer_to_pointer_examples
+// ---------------------------------------------------------------------------
+
+static int **ptr_matrix_alloc(size_t rows, size_t cols) {
+    int **m = (int **)malloc(rows * sizeof(int *));
+    if (m == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < rows; i++) {
+        m[i] = (int *)calloc(cols, sizeof(int));
+        if (m[i] == NULL) {
+            perror("calloc");
+            exit(1);
+        }
+    }
+    return m;
+}
+
+static void ptr_matrix_free(int **m, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        free(m[i]);
+    }
+    free(m);
+}
+
+static void ptr_matrix_transpose(int **dst, int **src, size_t rows, size_t cols) {
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            dst[j][i] = src[i][j];
+        }
+    }
+}
+
+static void ptr_matrix_multiply(int **c, int **a, int **b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            unsigned sum = 0;
+            for (size_t k = 0; k < n; k++) {
+                sum += (unsigned)a[i][k] * (unsigned)b[k][j];
+            }
+            c[i][j] = (int)sum;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+static void matrix_alloc_or_die(matrix_t *m, size_t rows, size_t cols) {
+    if (matrix_init(m, rows, cols) != 0) {
+        perror("matrix_init");
+        exit(1);
+    }
+}
+
+// Small values so that the products stay far from overflow
+static void fill(matrix_t *m, int **pm, int seed) {
+    for (size_t i = 0; i < m->rows; i++) {
+        for (size_t j = 0; j < m->cols; j++) {
+            int v = (int)((i * 31 + j * 17 + (size_t)seed) % 13) - 6;
+            *matrix_at(m, i, j) = v;
+            pm[i][j] = v;
+        }
+    }
+}
+
+static bool same(const matrix_t *m, const matrix_t *ref) {
+    for (size_t i = 0; i < m->rows; i++) {
+        if (memcmp(matrix_row(m, i), matrix_row(ref, i), m->cols * sizeof(int)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same_ptr(int **pm, const matrix_t *ref) {
+    for (size_t i = 0; i < ref->rows; i++) {
+        if (memcmp(pm[i], matrix_row(ref, i), ref->cols * sizeof(int)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void check(int rc, const char *what) {
+    if (rc != 0) {
+        fprintf(stderr, "%s failed\n", what);
+        exit(1);
+    }
+}
+
+static void print_row(const char *op, kernel_kind_t kind, size_t n, double rate, const char *unit,
+                      bool ok) {
+    char size[48];
+    snprintf(size, sizeof(size), "%zux%zu", n, n);
+    printf("%-10s %-13s %-11s %10.2f %-6s %6s\n", op, kernel_names[kind], size, rate, unit, ok ? "ok" : "FAIL");
+    fflush(stdout);
+}
+
+// ---------------------------------------------------------------------------
+// Transpose
+// ---------------------------------------------------------------------------
+
+static int run_transpose(kernel_kind_t kind, matrix_t *dst, const matrix_t *src, int **pdst, int **psrc) {
+    switch (kind) {
+    case K_PTR_NAIVE:
+        ptr_matrix_transpose(pdst, psrc, src->rows, src->cols);
+        return 0;
+    case K_NAIVE:
+        return matrix_transpose_naive(dst, src);
+    case K_TILED:
+        return matrix_transpose_tiled(dst, src);
+    case K_RECURSIVE:
+        return matrix_transpose_recursive(dst, src);
+    case K_PARALLEL:
+        return matrix_transpose_parallel(&pool, dst, src);
+    default:
+        return -1;
+    }
+}
+
+static void bench_transpose(size_t n) {
+    matrix_t src, dst, ref;
+    matrix_alloc_or_die(&src, n, n);
+    matrix_alloc_or_die(&dst, n, n);
+    matrix_alloc_or_die(&ref, n, n);
+    int **psrc = ptr_matrix_alloc(n, n);
+    int **pdst = ptr_matrix_alloc(n, n);
+    fill(&src, psrc, 1);
+    check(matrix_transpose_naive(&ref, &src), "matrix_transpose_naive");
+
+    size_t elements = n * n;
+    int reps = (int)(TARGET_ELEMENTS / elements);
+    if (reps < 1) {
+        reps = 1;
+    }
+
+    for (int k = K_PTR_NAIVE; k < K_COUNT; k++) {
+        if (k == K_TILED_ROWS) {
+            continue; // Only the multiply has block kernels to choose from
+        }
+        memset(dst.data, 0, dst.rows * dst.stride * sizeof(int));
+        bench_perf_t perf;
+        bench_perf_start(&perf);
+        uint64_t t0 = bench_now_ns();
+        for (int r = 0; r < reps; r++) {
+            check(run_transpose((kernel_kind_t)k, &dst, &src, pdst, psrc), kernel_names[k]);
+        }
+        double seconds = (double)(bench_now_ns() - t0) / 1e9;
+        bench_perf_stop(&perf);
+        bench_perf_report(&perf, (double)elements * reps, "transpose %s %zux%zu", kernel_names[k], n, n);
+        double bytes = 2.0 * (double)elements * sizeof(int) * reps;
+        bool ok = k == K_PTR_NAIVE ? same_ptr(pdst, &ref) : same(&dst, &ref);
+        print_row("transpose", (kernel_kind_t)k, n, bytes / seconds / 1e9, "GB/s", ok);
+    }
+
+    ptr_matrix_free(psrc, n);
+    ptr_matrix_free(pdst, n);
+    matrix_free(&src);
+    matrix_free(&dst);
+    matrix_free(&ref);
+}
+
+// ---------------------------------------------------------------------------
+// Multiply
+// ---------------------------------------------------------------------------
+
+static int run_multiply(kernel_kind_t kind, matrix_t *c, const matrix_t *a, const matrix_t *b,
+                        int **pc, int **pa, int **pb) {
+    switch (kind) {
+    case K_PTR_NAIVE:
+        ptr_matrix_multiply(pc, pa, pb, a->rows);
+        return 0;
+    case K_NAIVE:
+        return matrix_multiply_naive(c, a, b);
+    case K_TILED_ROWS:
+        return matrix_multiply_tiled_with(matrix_multiply_block_scale_add, c, a, b);
+    case K_TILED:
+        return matrix_multiply_tiled(c, a, b);
+    case K_RECURSIVE:
+        return matrix_multiply_recursive(c, a, b);
+    case K_PARALLEL:
+        return matrix_multiply_parallel(&pool, c, a, b);
+    default:
+        return -1;
+    }
+}
+
+static void bench_multiply(size_t n) {
+    matrix_t a, b, c, ref;
+    matrix_alloc_or_die(&a, n, n);
+    matrix_alloc_or_die(&b, n, n);
+    matrix_alloc_or_die(&c, n, n);
+    matrix_alloc_or_die(&ref, n, n);
+    int **pa = ptr_matrix_alloc(n, n);
+    int **pb = ptr_matrix_alloc(n, n);
+    int **pc = ptr_matrix_alloc(n, n);
+    fill(&a, pa, 1);
+    fill(&b, pb, 5);
+    bool naive = n <= NAIVE_MAX_DIM;
+    if (naive) {
+        check(matrix_multiply_naive(&ref, &a, &b), "matrix_multiply_naive");
+    } else {
+        check(matrix_multiply_tiled(&ref, &a, &b), "matrix_multiply_tiled");
+    }
+
+    double ops = 2.0 * (double)n * n * n;
+    int reps = (int)((double)TARGET_OPS / ops);
+    if (reps < 1) {
+        reps = 1;
+    }
+
+    for (int k = K_PTR_NAIVE; k < K_COUNT; k++) {
+        if (!naive && (k == K_PTR_NAIVE || k == K_NAIVE)) {
+            continue;
+        }
+        memset(c.data, 0xff, c.rows * c.stride * sizeof(int)); // Kernels must overwrite c
+        int kreps = k == K_PTR_NAIVE || k == K_NAIVE ? 1 : reps;
+        bench_perf_t perf;
+        bench_perf_start(&perf);
+        uint64_t t0 = bench_now_ns();
+        for (int r = 0; r < kreps; r++) {
+            check(run_multiply((kernel_kind_t)k, &c, &a, &b, pc, pa, pb), kernel_names[k]);
+        }
+        double seconds = (double)(bench_now_ns() - t0) / 1e9;
+        bench_perf_stop(&perf);
+        bench_perf_report(&perf, ops * kreps, "multiply %s %zux%zu", kernel_names[k], n, n);
+        bool ok = k == K_PTR_NAIVE ? same_ptr(pc, &ref) : same(&c, &ref);
+        print_row("multiply", (kernel_kind_t)k, n, ops * kreps / seconds / 1e9, "GOP/s", ok);
+    }
+
+    ptr_matrix_free(pa, n);
+    ptr_matrix_free(pb, n);
+    ptr_matrix_free(pc, n);
+    matrix_free(&a);
+    matrix_free(&b);
+    matrix_free(&c);
+    matrix_free(&ref);
+}
+
+int main(int argc, char **argv) {
+    size_t max_dim = 2048;
+    int threads = bench_num_cpus();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:t:h")) != -1) {
+        switch (opt) {
+        case 'm': max_dim = (size_t)atol(optarg); break;
+        case 't': threads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-m max_dim] [-t threads]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_dim == 0 || threads <= 0) {
+        fprintf(stderr, "Usage: %s [-m max_dim] [-t threads]\n", argv[0]);
+        return 1;
+    }
+
+    if (thread_pool_init(&pool, threads) != 0) {
+        perror("thread_pool_init");
+        return 1;
+    }
+
+    printf("Matrix kernel benchmark: %d CPUs, %d pool threads, scale_add %s, "
+           "transpose block %d, multiply block %dx%d\n",
+           bench_num_cpus(), threads, array_kernels()->name, MATRIX_TRANSPOSE_BLOCK,
+           MATRIX_MULTIPLY_BLOCK_DEPTH, MATRIX_MULTIPLY_BLOCK_COLS);
+    printf("%-10s %-13s %-11s %10s %-6s %6s\n", "op", "kernel", "size", "rate", "unit", "check");
+
+    // 1000 is not a multiple of any block size, so it covers the edges
+    const size_t dims[] = {256, 1000, 1024, 2048};
+    for (size_t d = 0; d < sizeof(dims) / sizeof(dims[0]) && dims[d] <= max_dim; d++) {
+        bench_transpose(dims[d]);
+    }
+    for (size_t d = 0; d < sizeof(dims) / sizeof(dims[0]) && dims[d] <= max_dim; d++) {
+        bench_multiply(dims[d]);
+    }
+
+    thread_pool_wait(&pool);
+    thread_pool_destroy(&pool);
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * bench_parallel.c - Array kernels on one thread vs parallel_for/parallel_reduce
+ *
+ * For arrays of 64K, 1M, 16M and 64M ints and a growing number of pool
+ * workers it compares the array_kernels.h kernels on the calling thread
+ * with the parallel.h wrappers built on them:
+ * 1. sum    - parallel_array_sum (parallel_reduce)
+ * 2. minmax - parallel_array_minmax (parallel_reduce)
+ * 3. fill   - parallel_array_fill (parallel_for)
+ *
+ * Each case prints GB/s for both versions and the speedup. The calling
+ * thread takes part in every parallel call, so N workers means up to N + 1
+ * threads. The parallel results are checked against the serial ones.
+ * It also prints the cost of a parallel_for over a few empty iterations,
+ * which is the floor for how short a loop is worth splitting.
+ * With BENCH_PERF set the counters cover only the calling thread, since
+ * the pool's workers were started before the case (see bench_perf.h).
+ *
+ * Usage: bench_parallel [-m max_elements] [-t max_workers]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "parallel.h"
+
+// Each measurement touches at least this many elements
+#define TARGET_ELEMENTS (256u << 20)
+
+#define EMPTY_CALLS 20000
+
+typedef enum { P_SUM, P_MINMAX, P_FILL, P_COUNT } parallel_kind_t;
+
+static const char *kind_names[] = {"sum", "minmax", "fill"};
+
+// Run one kernel once, serially (pool NULL) or on the pool, and fold its
+// result into a number we can compare
+static long long run_kernel(parallel_kind_t kind, thread_pool_t *pool, const int *a, int *dst, size_t n,
+                            int value) {
+    int lo, hi;
+    switch (kind) {
+    case P_SUM:
+        return pool != NULL ? parallel_array_sum(pool, a, n) : array_sum(a, n);
+    case P_MINMAX:
+        if (pool != NULL) {
+            parallel_array_minmax(pool, a, n, &lo, &hi);
+        } else {
+            array_minmax(a, n, &lo, &hi);
+        }
+        return (long long)lo * 1000003 + hi;
+    case P_FILL:
+        if (pool != NULL) {
+            parallel_array_fill(pool, dst, value, n);
+        } else {
+            array_fill(dst, value, n);
+        }
+        return value;
+    default:
+        return 0;
+    }
+}
+
+// GB/s of one kernel. *check gets a result that covers everything the
+// kernel computed or wrote. The pool's workers already exist, so only the
+// calling thread's share of the work shows up in the perf counters.
+static double measure(parallel_kind_t kind, thread_pool_t *pool, const int *a, int *dst, size_t n,
+                      long long *check) {
+    size_t reps = TARGET_ELEMENTS / n;
+    if (reps < 1) {
+        reps = 1;
+    }
+    array_fill(dst, 0, n);
+    *check = run_kernel(kind, pool, a, dst, n, 7); // Also warms up the pool and caches
+    if (kind == P_FILL) {
+        *check = array_sum(dst, n);
+    }
+
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    long long sink = 0;
+    for (size_t r = 0; r < reps; r++) {
+        sink += run_kernel(kind, pool, a, dst, n, (int)r);
+    }
+    double seconds = (double)(bench_now_ns() - t0) / 1e9;
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, (double)(n * reps), "%s %s elements=%zu workers=%d", kind_names[kind],
+                      pool != NULL ? "parallel" : "serial", n, pool != NULL ? pool->num_workers : 0);
+    __asm__ __volatile__("" : : "g"(sink) : "memory"); // Keep the results alive
+    return (double)n * sizeof(int) * reps / seconds / 1e9;
+}
+
+static void empty_range(size_t begin, size_t end, void *ctx) {
+    (void)begin;
+    (void)end;
+    (void)ctx;
+}
+
+// ns per parallel_for call that splits into one chunk per thread
+static double empty_call_ns(thread_pool_t *pool) {
+    size_t n = (size_t)pool->num_workers + 1;
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < EMPTY_CALLS; i++) {
+        parallel_for(pool, 0, n, 1, empty_range, NULL);
+    }
+    return (double)(bench_now_ns() - t0) / EMPTY_CALLS;
+}
+
+static void run_workers(int workers, const int *a, int *dst, size_t max_elements) {
+    thread_pool_t pool;
+    if (thread_pool_init(&pool, workers) != 0) {
+        perror("thread_pool_init");
+        exit(1);
+    }
+
+    const size_t sizes[] = {64u << 10, 1u << 20, 16u << 20, 64u << 20};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= max_elements; s++) {
+        size_t n = sizes[s];
+        char size[32];
+        if (n * sizeof(int) >= (1u << 20)) {
+            snprintf(size, sizeof(size), "%zuMB", n * sizeof(int) >> 20);
+        } else {
+            snprintf(size, sizeof(size), "%zuKB", n * sizeof(int) >> 10);
+        }
+
+        for (int k = P_SUM; k < P_COUNT; k++) {
+            long long serial_result, parallel_result;
+            double serial = measure((parallel_kind_t)k, NULL, a, dst, n, &serial_result);
+            double parallel = measure((parallel_kind_t)k, &pool, a, dst, n, &parallel_result);
+            printf("%-8s %8s %8d %12.2f %12.2f %8.2fx %6s\n", kind_names[k], size, workers,
+                   serial, parallel, parallel / serial, serial_result == parallel_result ? "ok" : "FAIL");
+            fflush(stdout);
+        }
+    }
+    printf("%-8s %8s %8d %12s %12.0f %9s %6s\n", "empty", "-", workers, "-", empty_call_ns(&pool), "ns/call", "-");
+    fflush(stdout);
+
+    thread_pool_destroy(&pool);
+}
+
+int main(int argc, char **argv) {
+    size_t max_elements = 64u << 20;
+    int max_workers = bench_num_cpus();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:t:h")) != -1) {
+        switch (opt) {
+        case 'm': max_elements = (size_t)atol(optarg); break;
+        case 't': max_workers = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-m max_elements] [-t max_workers]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_elements == 0 || max_workers <= 0) {
+        fprintf(stderr, "Usage: %s [-m max_elements] [-t max_workers]\n", argv[0]);
+        return 1;
+    }
+
+    // aligned_alloc wants a whole number of alignment units
+    size_t bytes = (max_elements * sizeof(int) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    int *a = (int *)aligned_alloc(CACHE_LINE_SIZE, bytes);
+    int *dst = (int *)aligned_alloc(CACHE_LINE_SIZE, bytes); // For fill
+    if (a == NULL || dst == NULL) {
+        perror("aligned_alloc");
+        return 1;
+    }
+    for (size_t i = 0; i < max_elements; i++) {
+        a[i] = (int)(i * 2654435761u % 2001) - 1000;
+    }
+
+    printf("Parallel array benchmark: %d CPUs, kernels %s, min grain %d elements\n",
+           bench_num_cpus(), array_kernels()->name, PARALLEL_ARRAY_MIN_GRAIN);
+    printf("%-8s %8s %8s %12s %12s %9s %6s\n", "kernel", "size", "workers",
+           "serial GB/s", "par GB/s", "speedup", "check");
+
+    for (int workers = 1; workers != 0; workers = bench_next_threads(workers, max_workers)) {
+        run_workers(workers, a, dst, max_elements);
+    }
+
+    free(dst);
+    free(a);
+    return 0;
+}
@@ -0,0 +1,294 @@
+/**
+ * bench_perf.h - Hardware and software event counters for benchmark cases
+ *
+ * Wall-clock time says how fast a case was, not why. Wrapped around a
+ * case, these helpers count with perf_event_open(2):
+ *
+ *     cycles, instructions  - IPC: stalled on memory, or busy computing?
+ *     cache_misses          - last-level misses, e.g. a lock line bouncing
+ *     branch_misses
+ *     dtlb_misses           - data TLB load misses (see arena backings)
+ *     context_switches      - sleeping in futex_wait, preemption
+ *     page_faults
+ *
+ *     bench_perf_t perf;
+ *     bench_perf_start(&perf);            // before the threads are created
+ *     ... run the case ...
+ *     bench_perf_stop(&perf);             // after they are joined
+ *     bench_perf_report(&perf, ops, "%s threads=%d", name, threads);
+ *
+ * Counting is off unless the environment asks for it:
+ *
+ *     BENCH_PERF=csv   or   BENCH_PERF=json   (one JSON object per line)
+ *     BENCH_PERF_FILE=path                    (appended to; default stderr)
+ *
+ * so the normal tables on stdout stay as they are. Each record carries
+ * the benchmark, the case label, the number of operations the benchmark
+ * counted, the time between start and stop and the resulting ops/s next
+ * to the counters.
+ *
+ * The counters follow the calling thread and every thread it creates
+ * after bench_perf_start. A thread's counts are added when it exits, so
+ * join the threads before bench_perf_stop; threads that were already
+ * running (a thread pool created earlier) are not counted. Kernel time is
+ * included when /proc/sys/kernel/perf_event_paranoid allows it and
+ * excluded otherwise. A counter the machine does not have (virtual
+ * machines often have no hardware PMU) is reported as empty or null.
+ *
+ * Call these from one thread only. Programs must define _GNU_SOURCE before
+ * their first #include.
+ */
+
+#ifndef BENCH_PERF_H
+#define BENCH_PERF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "bench.h"
+
+typedef enum {
+    BENCH_PERF_CYCLES,
+    BENCH_PERF_INSTRUCTIONS,
+    BENCH_PERF_CACHE_MISSES,
+    BENCH_PERF_BRANCH_MISSES,
+    BENCH_PERF_DTLB_MISSES,
+    BENCH_PERF_CONTEXT_SWITCHES,
+    BENCH_PERF_PAGE_FAULTS,
+    BENCH_PERF_EVENTS
+} bench_perf_event_t;
+
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} bench_perf_event_desc_t;
+
+static const bench_perf_event_desc_t bench_perf_events[BENCH_PERF_EVENTS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+typedef enum { BENCH_PERF_OFF, BENCH_PERF_CSV, BENCH_PERF_JSON } bench_perf_format_t;
+
+typedef struct {
+    int fds[BENCH_PERF_EVENTS];
+    int64_t values[BENCH_PERF_EVENTS];  // -1 where the counter is unavailable
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+} bench_perf_t;
+
+// ---------------------------------------------------------------------------
+// Configuration
+// ---------------------------------------------------------------------------
+
+// The output format from BENCH_PERF, read once
+static inline bench_perf_format_t bench_perf_format(void) {
+    static int format = -1;
+    if (format < 0) {
+        const char *env = getenv("BENCH_PERF");
+        if (env == NULL || *env == '\0' || strcmp(env, "0") == 0) {
+            format = BENCH_PERF_OFF;
+        } else if (strcmp(env, "json") == 0) {
+            format = BENCH_PERF_JSON;
+        } else {
+            format = BENCH_PERF_CSV;  // "csv", "1", anything else
+        }
+    }
+    return (bench_perf_format_t)format;
+}
+
+static inline bool bench_perf_enabled(void) {
+    return bench_perf_format() != BENCH_PERF_OFF;
+}
+
+// Where records go: BENCH_PERF_FILE (appended) or stderr. *fresh tells
+// whether nothing has been written there yet, so CSV needs a header.
+static inline FILE *bench_perf_stream(bool *fresh) {
+    static FILE *stream = NULL;
+    static bool written = false;
+    if (stream == NULL) {
+        const char *path = getenv("BENCH_PERF_FILE");
+        stream = path != NULL && *path != '\0' ? fopen(path, "a") : NULL;
+        if (stream == NULL) {
+            if (path != NULL && *path != '\0') {
+                perror(path);
+            }
+            stream = stderr;
+        } else if (ftell(stream) > 0) {
+            written = true;  // Appending to earlier records
+        }
+    }
+    *fresh = !written;
+    written = true;
+    return stream;
+}
+
+// ---------------------------------------------------------------------------
+// Counting
+// ---------------------------------------------------------------------------
+
+static inline int bench_perf_open(const bench_perf_event_desc_t *e) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = e->type;
+    attr.config = e->config;
+    attr.disabled = 1;
+    attr.inherit = 1;  // Threads created from here on count too
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        attr.exclude_kernel = 1;  // perf_event_paranoid >= 2: user space only
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+    return fd;
+}
+
+// Open and start every counter (nothing when counting is off)
+static inline void bench_perf_start(bench_perf_t *p) {
+    for (int i = 0; i < BENCH_PERF_EVENTS; i++) {
+        p->fds[i] = -1;
+        p->values[i] = -1;
+    }
+    p->elapsed_ns = 0;
+    if (bench_perf_enabled()) {
+        for (int i = 0; i < BENCH_PERF_EVENTS; i++) {
+            p->fds[i] = bench_perf_open(&bench_perf_events[i]);
+        }
+        for (int i = 0; i < BENCH_PERF_EVENTS; i++) {
+            if (p->fds[i] >= 0) {
+                ioctl(p->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+    p->start_ns = bench_now_ns();
+}
+
+// Stop the counters and read them. When the kernel had to multiplex more
+// events than the PMU has counters, the counts are scaled up to the time
+// the events were enabled.
+static inline void bench_perf_stop(bench_perf_t *p) {
+    p->elapsed_ns = bench_now_ns() - p->start_ns;
+    for (int i = 0; i < BENCH_PERF_EVENTS; i++) {
+        if (p->fds[i] >= 0) {
+            ioctl(p->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int i = 0; i < BENCH_PERF_EVENTS; i++) {
+        if (p->fds[i] < 0) {
+            continue;
+        }
+        uint64_t v[3];  // value, time enabled, time running
+        if (read(p->fds[i], v, sizeof(v)) == (ssize_t)sizeof(v) && v[2] > 0) {
+            double scale = v[2] < v[1] ? (double)v[1] / (double)v[2] : 1.0;
+            p->values[i] = (int64_t)((double)v[0] * scale);
+        }
+        close(p->fds[i]);
+        p->fds[i] = -1;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+// Write s quoted for CSV ("" for ") or JSON (\" and \\)
+static inline void bench_perf_quote(FILE *out, const char *s, bench_perf_format_t format) {
+    fputc('"', out);
+    for (; *s != '\0'; s++) {
+        if (*s == '"') {
+            fputs(format == BENCH_PERF_CSV ? "\"\"" : "\\\"", out);
+        } else if (*s == '\\' && format == BENCH_PERF_JSON) {
+            fputs("\\\\", out);
+        } else if ((unsigned char)*s >= ' ') {
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Write one record for the case measured by p: `ops` operations, labelled
+// with a printf-style format. Does nothing when counting is off.
+__attribute__((format(printf, 3, 4)))
+static inline void bench_perf_report(const bench_perf_t *p, double ops, const char *fmt, ...) {
+    bench_perf_format_t format = bench_perf_format();
+    if (format == BENCH_PERF_OFF) {
+        return;
+    }
+    char label[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(label, sizeof(label), fmt, args);
+    va_end(args);
+
+    bool fresh;
+    FILE *out = bench_perf_stream(&fresh);
+    double seconds = (double)p->elapsed_ns / 1e9;
+    double rate = seconds > 0 ? ops / seconds : 0;
+    const int64_t *v = p->values;
+    bool ipc = v[BENCH_PERF_CYCLES] > 0 && v[BENCH_PERF_INSTRUCTIONS] >= 0;
+
+    if (format == BENCH_PERF_CSV) {
+        if (fresh) {
+            fputs("bench,case,ops,seconds,ops_per_sec,ipc", out);
+            for (int i = 0; i < BENCH_PERF_EVENTS; i++) {
+                fprintf(out, ",%s", bench_perf_events[i].name);
+            }
+            fputc('\n', out);
+        }
+        fprintf(out, "%s,", program_invocation_short_name);
+        bench_perf_quote(out, label, format);
+        fprintf(out, ",%.0f,%.6f,%.1f,", ops, seconds, rate);
+        if (ipc) {
+            fprintf(out, "%.3f", (double)v[BENCH_PERF_INSTRUCTIONS] / (double)v[BENCH_PERF_CYCLES]);
+        }
+        for (int i = 0; i < BENCH_PERF_EVENTS; i++) {
+            if (v[i] >= 0) {
+                fprintf(out, ",%lld", (long long)v[i]);
+            } else {
+                fputc(',', out);
+            }
+        }
+    } else {
+        fputs("{\"bench\":", out);
+        bench_perf_quote(out, program_invocation_short_name, format);
+        fputs(",\"case\":", out);
+        bench_perf_quote(out, label, format);
+        fprintf(out, ",\"ops\":%.0f,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"ipc\":", ops, seconds, rate);
+        if (ipc) {
+            fprintf(out, "%.3f", (double)v[BENCH_PERF_INSTRUCTIONS] / (double)v[BENCH_PERF_CYCLES]);
+        } else {
+            fputs("null", out);
+        }
+        for (int i = 0; i < BENCH_PERF_EVENTS; i++) {
+            if (v[i] >= 0) {
+                fprintf(out, ",\"%s\":%lld", bench_perf_events[i].name, (long long)v[i]);
+            } else {
+                fprintf(out, ",\"%s\":null", bench_perf_events[i].name);
+            }
+        }
+        fputc('}', out);
+    }
+    fputc('\n', out);
+    fflush(out);
+}
+
+#endif // BENCH_PERF_H
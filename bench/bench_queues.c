@@ -0,0 +1,300 @@
+/**
+ * bench_queues.c - Throughput of the lock-free queues vs a locked queue
+ *
+ * Producers push a fixed number of items each, consumers pop until they
+ * see a stop marker. Compared queues:
+ * 1. locked       - ring buffer guarded by an adaptive simple_lock_t
+ * 2. mpmc         - mpmc_queue_t, one item per operation
+ * 3. mpmc_batch   - mpmc_queue_t, BATCH items per operation
+ * 4. spsc         - spsc_queue_t (only with 1 producer and 1 consumer)
+ * 5. spsc_batch   - spsc_queue_t, BATCH items per operation
+ *
+ * Every run checks that the sum of consumed items matches what was produced.
+ *
+ * Usage: bench_queues [-n items_per_producer] [-t max_threads]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "mpmc_queue.h"
+#include "simple_lock.h"
+
+#define QUEUE_CAPACITY 1024
+#define BATCH 32
+
+// Consumers stop when they dequeue this marker
+#define STOP_ITEM ((void *)UINTPTR_MAX)
+
+// ---------------------------------------------------------------------------
+// Baseline: ring buffer behind a simple_lock_t
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    simple_lock_t lock;
+    void **slots;
+    size_t mask;
+    size_t head;
+    size_t tail;
+} locked_queue_t;
+
+static int locked_queue_init(locked_queue_t *q, size_t capacity) {
+    size_t n = queue_round_capacity(capacity);
+    simple_lock_init_mode(&q->lock, SIMPLE_LOCK_ADAPTIVE);
+    q->slots = (void **)calloc(n, sizeof(void *));
+    q->mask = n - 1;
+    q->head = 0;
+    q->tail = 0;
+    return q->slots != NULL ? 0 : -1;
+}
+
+static bool locked_queue_enqueue(locked_queue_t *q, void *item) {
+    bool ok = false;
+    simple_lock_acquire(&q->lock);
+    if (q->tail - q->head <= q->mask) {
+        q->slots[q->tail++ & q->mask] = item;
+        ok = true;
+    }
+    simple_lock_release(&q->lock);
+    return ok;
+}
+
+static bool locked_queue_dequeue(locked_queue_t *q, void **item) {
+    bool ok = false;
+    simple_lock_acquire(&q->lock);
+    if (q->head != q->tail) {
+        *item = q->slots[q->head++ & q->mask];
+        ok = true;
+    }
+    simple_lock_release(&q->lock);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark driver
+// ---------------------------------------------------------------------------
+
+typedef enum { Q_LOCKED, Q_MPMC, Q_MPMC_BATCH, Q_SPSC, Q_SPSC_BATCH } queue_kind_t;
+
+static const char *queue_names[] = {"locked", "mpmc", "mpmc_batch", "spsc", "spsc_batch"};
+
+typedef struct {
+    queue_kind_t kind;
+    locked_queue_t locked;
+    mpmc_queue_t mpmc;
+    spsc_queue_t spsc;
+    size_t items_per_producer;
+} bench_queue_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) bench_queue_t *bq;
+    int id;
+    uint64_t sum;
+} queue_worker_t;
+
+static void enqueue_all(bench_queue_t *bq, void *const *items, size_t n) {
+    size_t done = 0;
+    unsigned int spins = 0;
+    while (done < n) {
+        size_t k = 0;
+        switch (bq->kind) {
+        case Q_LOCKED: k = locked_queue_enqueue(&bq->locked, items[done]); break;
+        case Q_MPMC: k = mpmc_queue_enqueue(&bq->mpmc, items[done]); break;
+        case Q_MPMC_BATCH: k = mpmc_queue_enqueue_batch(&bq->mpmc, items + done, n - done); break;
+        case Q_SPSC: k = spsc_queue_enqueue(&bq->spsc, items[done]); break;
+        case Q_SPSC_BATCH: k = spsc_queue_enqueue_batch(&bq->spsc, items + done, n - done); break;
+        }
+        if (k == 0) {
+            spin_wait(&spins); // Full: wait for the consumers
+        }
+        done += k;
+    }
+}
+
+static size_t dequeue_some(bench_queue_t *bq, void **items, size_t n) {
+    switch (bq->kind) {
+    case Q_LOCKED: return locked_queue_dequeue(&bq->locked, items);
+    case Q_MPMC: return mpmc_queue_dequeue(&bq->mpmc, items);
+    case Q_MPMC_BATCH: return mpmc_queue_dequeue_batch(&bq->mpmc, items, n);
+    case Q_SPSC: return spsc_queue_dequeue(&bq->spsc, items);
+    case Q_SPSC_BATCH: return spsc_queue_dequeue_batch(&bq->spsc, items, n);
+    }
+    return 0;
+}
+
+static void *producer_function(void *arg) {
+    queue_worker_t *w = (queue_worker_t *)arg;
+    bench_queue_t *bq = w->bq;
+    void *items[BATCH];
+
+    // Item values are 1..items_per_producer, offset per producer
+    uintptr_t next = (uintptr_t)w->id * bq->items_per_producer + 1;
+    size_t left = bq->items_per_producer;
+    while (left > 0) {
+        size_t n = left < BATCH ? left : BATCH;
+        for (size_t i = 0; i < n; i++) {
+            items[i] = (void *)next;
+            w->sum += next;
+            next++;
+        }
+        enqueue_all(bq, items, n);
+        left -= n;
+    }
+    return NULL;
+}
+
+static void *consumer_function(void *arg) {
+    queue_worker_t *w = (queue_worker_t *)arg;
+    void *items[BATCH];
+    unsigned int spins = 0;
+
+    while (true) {
+        size_t k = dequeue_some(w->bq, items, BATCH);
+        if (k == 0) {
+            spin_wait(&spins); // Empty: wait for the producers
+            continue;
+        }
+        for (size_t i = 0; i < k; i++) {
+            if (items[i] == STOP_ITEM) {
+                // Batch dequeue can pick up several stop markers at once;
+                // hand the surplus back for the other consumers
+                for (size_t j = i + 1; j < k; j++) {
+                    if (items[j] == STOP_ITEM) {
+                        enqueue_all(w->bq, &items[j], 1);
+                    } else {
+                        w->sum += (uintptr_t)items[j];
+                    }
+                }
+                return NULL;
+            }
+            w->sum += (uintptr_t)items[i];
+        }
+    }
+}
+
+static void run_queue_case(queue_kind_t kind, int producers, int consumers, size_t items) {
+    bench_queue_t bq;
+    memset(&bq, 0, sizeof(bq));
+    bq.kind = kind;
+    bq.items_per_producer = items;
+
+    int rc = 0;
+    if (kind == Q_LOCKED) {
+        rc = locked_queue_init(&bq.locked, QUEUE_CAPACITY);
+    } else if (kind == Q_MPMC || kind == Q_MPMC_BATCH) {
+        rc = mpmc_queue_init(&bq.mpmc, QUEUE_CAPACITY);
+    } else {
+        rc = spsc_queue_init(&bq.spsc, QUEUE_CAPACITY);
+    }
+    if (rc != 0) {
+        perror("queue init");
+        exit(1);
+    }
+
+    int total = producers + consumers;
+    pthread_t *tids = (pthread_t *)malloc(total * sizeof(pthread_t));
+    queue_worker_t *workers = (queue_worker_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                              total * sizeof(queue_worker_t));
+    if (tids == NULL || workers == NULL) {
+        perror("run_queue_case");
+        exit(1);
+    }
+
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < total; i++) {
+        memset(&workers[i], 0, sizeof(queue_worker_t));
+        workers[i].bq = &bq;
+        workers[i].id = i < producers ? i : i - producers;
+        void *(*fn)(void *) = i < producers ? producer_function : consumer_function;
+        if (pthread_create(&tids[i], NULL, fn, &workers[i]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+
+    uint64_t produced = 0;
+    for (int i = 0; i < producers; i++) {
+        pthread_join(tids[i], NULL);
+        produced += workers[i].sum;
+    }
+
+    // All real items are in; tell every consumer to stop.
+    // (With SPSC there is one consumer and main acts as the only producer now.)
+    void *stop = STOP_ITEM;
+    for (int i = 0; i < consumers; i++) {
+        enqueue_all(&bq, &stop, 1);
+    }
+
+    uint64_t consumed = 0;
+    for (int i = producers; i < total; i++) {
+        pthread_join(tids[i], NULL);
+        consumed += workers[i].sum;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_perf_stop(&perf);
+
+    double total_items = (double)items * producers;
+    printf("%-12s %9d %9d %12.1f %14.0f %6s\n", queue_names[kind], producers, consumers,
+           (double)elapsed / total_items, total_items * 1e9 / (double)elapsed,
+           produced == consumed ? "ok" : "FAIL");
+    fflush(stdout);
+    bench_perf_report(&perf, total_items, "%s producers=%d consumers=%d", queue_names[kind], producers,
+                      consumers);
+
+    free(workers);
+    free(tids);
+    free(bq.locked.slots);
+    mpmc_queue_destroy(&bq.mpmc);
+    spsc_queue_destroy(&bq.spsc);
+}
+
+int main(int argc, char **argv) {
+    size_t items = 1000000;
+    int max_threads = bench_num_cpus();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:h")) != -1) {
+        switch (opt) {
+        case 'n': items = (size_t)atol(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n items_per_producer] [-t max_threads]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (items == 0 || max_threads <= 0) {
+        fprintf(stderr, "Usage: %s [-n items_per_producer] [-t max_threads]\n", argv[0]);
+        return 1;
+    }
+    if (max_threads < 2) {
+        max_threads = 2; // Need at least one producer and one consumer
+    }
+
+    printf("Queue benchmark: %d CPUs, capacity %d, batch %d\n",
+           bench_num_cpus(), QUEUE_CAPACITY, BATCH);
+    printf("%-12s %9s %9s %12s %14s %6s\n",
+           "queue", "producers", "consumers", "ns/item", "items/s", "check");
+
+    // 1P/1C, then half producers / half consumers up to max_threads
+    for (int pairs = 1; pairs != 0; pairs = bench_next_threads(pairs, max_threads / 2)) {
+        for (int k = Q_LOCKED; k <= Q_SPSC_BATCH; k++) {
+            if ((k == Q_SPSC || k == Q_SPSC_BATCH) && pairs != 1) {
+                continue;
+            }
+            run_queue_case((queue_kind_t)k, pairs, pairs, items);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+/**
+ * bench_reclaim.c - Epochs vs hazard pointers vs a reader-writer lock
+ *
+ * Writers keep replacing one shared node with a new one and hand the old
+ * node to the reclamation scheme. Readers keep loading the current node
+ * and checking its contents. Compared schemes:
+ * 1. ebr    - readers in ebr_enter/ebr_exit, writers call ebr_retire
+ * 2. hp     - readers protect the node with hp_protect, writers hp_retire
+ * 3. rwlock - readers take rw_lock_t shared, writers swap under the
+ *             exclusive lock and free the old node at once
+ *
+ * For each case it prints reads/s, updates/s, the time from retire to
+ * free (p50/p99), and the most nodes that were retired but not yet freed.
+ * A freed node is poisoned first, so a reader that sees a freed node
+ * shows up as an error.
+ *
+ * Usage: bench_reclaim [-d ms] [-t max_readers] [-w writers]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "reclaim.h"
+#include "rw_lock.h"
+
+#define MAX_LATENCY_SAMPLES 1000000
+
+typedef enum { R_EBR, R_HP, R_RWLOCK } reclaim_kind_t;
+
+static const char *reclaim_names[] = {"ebr", "hp", "rwlock"};
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) bench_samples_t latency;  // Retire-to-free, ns
+    uint64_t updates;
+    int64_t peak_retired;
+} writer_stats_t;
+
+typedef struct {
+    uint64_t value;
+    uint64_t check;          // ~value while the node is live
+    uint64_t retired_ns;
+    writer_stats_t *stats;   // Writer that retired the node
+} node_t;
+
+typedef struct {
+    reclaim_kind_t kind;
+    _Alignas(CACHE_LINE_SIZE) node_t *current;
+    _Alignas(CACHE_LINE_SIZE) int64_t retired;  // Retired but not yet freed
+    ebr_t ebr;
+    hp_domain_t hp;
+    rw_lock_t lock;
+    atomic_bool start;
+    atomic_bool stop;
+} bench_reclaim_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) bench_reclaim_t *br;
+    uint64_t reads;
+    uint64_t errors;
+    writer_stats_t stats;
+} reclaim_worker_t;
+
+// Freeing a node touches `retired`, so node_free needs to find the case
+static bench_reclaim_t *current_case;
+
+// Only frees during the measurement count towards the latency
+static atomic_bool recording;
+
+static node_t *node_new(uint64_t value) {
+    node_t *n = (node_t *)malloc(sizeof(node_t));
+    if (n == NULL) {
+        perror("node_new");
+        exit(1);
+    }
+    n->value = value;
+    n->check = ~value;
+    n->retired_ns = 0;
+    n->stats = NULL;
+    return n;
+}
+
+static void node_free(void *p) {
+    node_t *n = (node_t *)p;
+    if (n->stats != NULL && atomic_load_explicit(&recording, memory_order_relaxed)) {
+        bench_samples_add(&n->stats->latency, bench_now_ns() - n->retired_ns);
+    }
+    __atomic_fetch_sub(&current_case->retired, 1, __ATOMIC_RELAXED);
+    n->check = n->value; // Poison: a reader that still sees this node fails its check
+    free(n);
+}
+
+static void wait_for_start(bench_reclaim_t *br) {
+    while (!atomic_load_explicit(&br->start, memory_order_acquire)) {
+        cpu_relax();
+    }
+}
+
+static bool node_ok(const node_t *n) {
+    return n->check == ~n->value;
+}
+
+static void *reader_function(void *arg) {
+    reclaim_worker_t *w = (reclaim_worker_t *)arg;
+    bench_reclaim_t *br = w->br;
+    ebr_thread_t *et = br->kind == R_EBR ? ebr_register(&br->ebr) : NULL;
+    hp_thread_t *ht = br->kind == R_HP ? hp_register(&br->hp) : NULL;
+    if ((br->kind == R_EBR && et == NULL) || (br->kind == R_HP && ht == NULL)) {
+        perror("register");
+        exit(1);
+    }
+    wait_for_start(br);
+
+    while (!atomic_load_explicit(&br->stop, memory_order_relaxed)) {
+        node_t *n;
+        switch (br->kind) {
+        case R_EBR:
+            ebr_enter(et);
+            n = __atomic_load_n(&br->current, __ATOMIC_ACQUIRE);
+            w->errors += !node_ok(n);
+            ebr_exit(et);
+            break;
+        case R_HP:
+            n = (node_t *)hp_protect(ht, 0, (void *const *)&br->current);
+            w->errors += !node_ok(n);
+            hp_clear(ht, 0);
+            break;
+        case R_RWLOCK:
+            rw_lock_acquire_shared(&br->lock);
+            n = br->current;
+            w->errors += !node_ok(n);
+            rw_lock_release_shared(&br->lock);
+            break;
+        }
+        w->reads++;
+    }
+
+    if (et != NULL) {
+        ebr_unregister(et);
+    }
+    if (ht != NULL) {
+        hp_unregister(ht);
+    }
+    return NULL;
+}
+
+static void *writer_function(void *arg) {
+    reclaim_worker_t *w = (reclaim_worker_t *)arg;
+    bench_reclaim_t *br = w->br;
+    ebr_thread_t *et = br->kind == R_EBR ? ebr_register(&br->ebr) : NULL;
+    hp_thread_t *ht = br->kind == R_HP ? hp_register(&br->hp) : NULL;
+    if ((br->kind == R_EBR && et == NULL) || (br->kind == R_HP && ht == NULL)) {
+        perror("register");
+        exit(1);
+    }
+    wait_for_start(br);
+
+    uint64_t value = 0;
+    while (!atomic_load_explicit(&br->stop, memory_order_relaxed)) {
+        node_t *n = node_new(++value);
+        node_t *old;
+        if (br->kind == R_RWLOCK) {
+            rw_lock_acquire_exclusive(&br->lock);
+            old = br->current;
+            br->current = n;
+            rw_lock_release_exclusive(&br->lock);
+            old->stats = &w->stats;
+            old->retired_ns = bench_now_ns();
+            if (w->stats.peak_retired == 0) {
+                w->stats.peak_retired = 1; // Freed right away
+            }
+            __atomic_fetch_add(&br->retired, 1, __ATOMIC_RELAXED);
+            node_free(old);
+        } else {
+            old = __atomic_exchange_n(&br->current, n, __ATOMIC_ACQ_REL);
+            old->stats = &w->stats;
+            old->retired_ns = bench_now_ns();
+            int64_t retired = __atomic_add_fetch(&br->retired, 1, __ATOMIC_RELAXED);
+            if (retired > w->stats.peak_retired) {
+                w->stats.peak_retired = retired;
+            }
+            int rc = br->kind == R_EBR ? ebr_retire(et, old, node_free) : hp_retire(ht, old, node_free);
+            if (rc != 0) {
+                perror("retire");
+                exit(1);
+            }
+        }
+        w->stats.updates++;
+    }
+
+    if (et != NULL) {
+        ebr_unregister(et);
+    }
+    if (ht != NULL) {
+        hp_unregister(ht);
+    }
+    return NULL;
+}
+
+static void run_reclaim_case(reclaim_kind_t kind, int readers, int writers, int duration_ms) {
+    bench_reclaim_t br;
+    br.kind = kind;
+    br.retired = 0;
+    br.current = node_new(0);
+    ebr_init(&br.ebr);
+    hp_init(&br.hp);
+    rw_lock_init(&br.lock);
+    atomic_init(&br.start, false);
+    atomic_init(&br.stop, false);
+    current_case = &br;
+
+    int total = readers + writers;
+    pthread_t *tids = (pthread_t *)malloc(total * sizeof(pthread_t));
+    reclaim_worker_t *workers = (reclaim_worker_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                                  total * sizeof(reclaim_worker_t));
+    if (tids == NULL || workers == NULL) {
+        perror("run_reclaim_case");
+        exit(1);
+    }
+
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    for (int i = 0; i < total; i++) {
+        memset(&workers[i], 0, sizeof(reclaim_worker_t));
+        workers[i].br = &br;
+        void *(*fn)(void *) = reader_function;
+        if (i >= readers) {
+            bench_samples_init(&workers[i].stats.latency, MAX_LATENCY_SAMPLES);
+            fn = writer_function;
+        }
+        if (pthread_create(&tids[i], NULL, fn, &workers[i]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+
+    atomic_store_explicit(&recording, true, memory_order_relaxed);
+    uint64_t start = bench_now_ns();
+    atomic_store_explicit(&br.start, true, memory_order_release);
+    usleep((useconds_t)duration_ms * 1000);
+    atomic_store_explicit(&br.stop, true, memory_order_relaxed);
+    for (int i = 0; i < total; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_perf_stop(&perf);
+    atomic_store_explicit(&recording, false, memory_order_relaxed);
+
+    uint64_t reads = 0;
+    uint64_t updates = 0;
+    uint64_t errors = 0;
+    int64_t peak = 0;
+    bench_samples_t latency;
+    bench_samples_init(&latency, 1);
+    for (int i = 0; i < total; i++) {
+        reads += workers[i].reads;
+        errors += workers[i].errors;
+        if (i >= readers) {
+            updates += workers[i].stats.updates;
+            if (workers[i].stats.peak_retired > peak) {
+                peak = workers[i].stats.peak_retired;
+            }
+            bench_samples_merge(&latency, &workers[i].stats.latency);
+            bench_samples_free(&workers[i].stats.latency);
+        }
+    }
+    bench_samples_sort(&latency);
+
+    double seconds = (double)elapsed / 1e9;
+    printf("%-8s %8d %8d %14.0f %12.0f %10.1f %10.1f %10lld %10.1f %7llu\n",
+           reclaim_names[kind], readers, writers, (double)reads / seconds, (double)updates / seconds,
+           (double)bench_samples_percentile(&latency, 0.50) / 1000.0,
+           (double)bench_samples_percentile(&latency, 0.99) / 1000.0,
+           (long long)peak, (double)peak * sizeof(node_t) / 1024.0, (unsigned long long)errors);
+    fflush(stdout);
+    bench_perf_report(&perf, (double)(reads + updates), "%s readers=%d writers=%d", reclaim_names[kind],
+                      readers, writers);
+
+    bench_samples_free(&latency);
+    ebr_destroy(&br.ebr);
+    hp_destroy(&br.hp);
+    rw_lock_destroy(&br.lock);
+    free(br.current);
+    free(workers);
+    free(tids);
+}
+
+int main(int argc, char **argv) {
+    int duration_ms = 200;
+    int max_readers = bench_num_cpus();
+    int writers = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:w:h")) != -1) {
+        switch (opt) {
+        case 'd': duration_ms = atoi(optarg); break;
+        case 't': max_readers = atoi(optarg); break;
+        case 'w': writers = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d ms] [-t max_readers] [-w writers]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (duration_ms <= 0 || max_readers <= 0 || writers <= 0) {
+        fprintf(stderr, "Usage: %s [-d ms] [-t max_readers] [-w writers]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Reclamation benchmark: %d CPUs, %d ms per case, EBR batch %d, HP scan threshold %d\n",
+           bench_num_cpus(), duration_ms, EBR_RETIRE_BATCH, HP_SCAN_THRESHOLD);
+    printf("%-8s %8s %8s %14s %12s %10s %10s %10s %10s %7s\n", "scheme", "readers", "writers",
+           "reads/s", "updates/s", "p50 us", "p99 us", "peak", "peak KB", "errors");
+
+    for (int readers = 1; readers != 0; readers = bench_next_threads(readers, max_readers)) {
+        for (int k = R_EBR; k <= R_RWLOCK; k++) {
+            run_reclaim_case((reclaim_kind_t)k, readers, writers, duration_ms);
+        }
+    }
+
+    return 0;
+}
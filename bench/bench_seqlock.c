@@ -0,0 +1,231 @@
+/**
+ * bench_seqlock.c - Reading a small shared struct under different locks
+ *
+ * One writer rewrites a 32-byte config struct every few microseconds.
+ * Readers copy it in a loop and check that all four fields match, which
+ * they only do if the copy was not torn by a write. Compared locks:
+ * 1. simple_lock - adaptive simple_lock_t around every read and write
+ * 2. rw_lock     - rw_lock_t with one central reader counter
+ * 3. rw_percpu   - rw_lock_t with a reader counter per CPU
+ * 4. seqlock     - seqlock_load / seqlock_store
+ *
+ * Each case prints reads/s, writes/s and the number of torn reads.
+ *
+ * Usage: bench_seqlock [-d ms] [-t max_readers] [-w write_interval_us]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "simple_lock.h"
+#include "rw_lock.h"
+#include "seqlock.h"
+
+typedef enum { S_SIMPLE_LOCK, S_RW_LOCK, S_RW_PERCPU, S_SEQLOCK } snapshot_kind_t;
+
+static const char *snapshot_names[] = {"simple_lock", "rw_lock", "rw_percpu", "seqlock"};
+
+// The shared snapshot: a write sets every field to the same value
+typedef struct {
+    uint64_t version;
+    uint64_t a;
+    uint64_t b;
+    uint64_t c;
+} config_t;
+
+typedef struct {
+    snapshot_kind_t kind;
+    simple_lock_t lock;
+    rw_lock_t rw;
+    seqlock_t seq;
+    _Alignas(CACHE_LINE_SIZE) config_t config;
+    int write_interval_us;
+    atomic_bool start;
+    atomic_bool stop;
+} bench_snapshot_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) bench_snapshot_t *bs;
+    uint64_t ops;
+    uint64_t torn;
+} snapshot_worker_t;
+
+static void wait_for_start(bench_snapshot_t *bs) {
+    while (!atomic_load_explicit(&bs->start, memory_order_acquire)) {
+        cpu_relax();
+    }
+}
+
+static void read_config(bench_snapshot_t *bs, config_t *out) {
+    switch (bs->kind) {
+    case S_SIMPLE_LOCK:
+        simple_lock_acquire(&bs->lock);
+        *out = bs->config;
+        simple_lock_release(&bs->lock);
+        break;
+    case S_RW_LOCK:
+    case S_RW_PERCPU:
+        rw_lock_acquire_shared(&bs->rw);
+        *out = bs->config;
+        rw_lock_release_shared(&bs->rw);
+        break;
+    case S_SEQLOCK:
+        seqlock_load(&bs->seq, out, &bs->config, sizeof(config_t));
+        break;
+    }
+}
+
+static void write_config(bench_snapshot_t *bs, const config_t *in) {
+    switch (bs->kind) {
+    case S_SIMPLE_LOCK:
+        simple_lock_acquire(&bs->lock);
+        bs->config = *in;
+        simple_lock_release(&bs->lock);
+        break;
+    case S_RW_LOCK:
+    case S_RW_PERCPU:
+        rw_lock_acquire_exclusive(&bs->rw);
+        bs->config = *in;
+        rw_lock_release_exclusive(&bs->rw);
+        break;
+    case S_SEQLOCK:
+        seqlock_store(&bs->seq, &bs->config, in, sizeof(config_t));
+        break;
+    }
+}
+
+static void *reader_function(void *arg) {
+    snapshot_worker_t *w = (snapshot_worker_t *)arg;
+    bench_snapshot_t *bs = w->bs;
+    wait_for_start(bs);
+
+    config_t copy;
+    while (!atomic_load_explicit(&bs->stop, memory_order_relaxed)) {
+        read_config(bs, &copy);
+        w->torn += copy.a != copy.version || copy.b != copy.version || copy.c != copy.version;
+        w->ops++;
+    }
+    return NULL;
+}
+
+static void *writer_function(void *arg) {
+    snapshot_worker_t *w = (snapshot_worker_t *)arg;
+    bench_snapshot_t *bs = w->bs;
+    wait_for_start(bs);
+
+    config_t next;
+    while (!atomic_load_explicit(&bs->stop, memory_order_relaxed)) {
+        w->ops++;
+        next.version = next.a = next.b = next.c = w->ops;
+        write_config(bs, &next);
+        if (bs->write_interval_us > 0) {
+            usleep((useconds_t)bs->write_interval_us);
+        }
+    }
+    return NULL;
+}
+
+static void run_snapshot_case(snapshot_kind_t kind, int readers, int duration_ms, int write_interval_us) {
+    bench_snapshot_t bs;
+    memset(&bs, 0, sizeof(bs));
+    bs.kind = kind;
+    bs.write_interval_us = write_interval_us;
+    simple_lock_init_mode(&bs.lock, SIMPLE_LOCK_ADAPTIVE);
+    if (rw_lock_init_mode(&bs.rw, kind == S_RW_PERCPU ? RW_LOCK_PER_CPU : RW_LOCK_CENTRAL) != 0) {
+        perror("rw_lock_init_mode");
+        exit(1);
+    }
+    seqlock_init(&bs.seq);
+    atomic_init(&bs.start, false);
+    atomic_init(&bs.stop, false);
+
+    int total = readers + 1;
+    pthread_t *tids = (pthread_t *)malloc(total * sizeof(pthread_t));
+    snapshot_worker_t *workers = (snapshot_worker_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                                    total * sizeof(snapshot_worker_t));
+    if (tids == NULL || workers == NULL) {
+        perror("run_snapshot_case");
+        exit(1);
+    }
+
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    for (int i = 0; i < total; i++) {
+        memset(&workers[i], 0, sizeof(snapshot_worker_t));
+        workers[i].bs = &bs;
+        // The last thread is the writer
+        void *(*fn)(void *) = i < readers ? reader_function : writer_function;
+        if (pthread_create(&tids[i], NULL, fn, &workers[i]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+
+    uint64_t start = bench_now_ns();
+    atomic_store_explicit(&bs.start, true, memory_order_release);
+    usleep((useconds_t)duration_ms * 1000);
+    atomic_store_explicit(&bs.stop, true, memory_order_relaxed);
+    for (int i = 0; i < total; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double seconds = (double)(bench_now_ns() - start) / 1e9;
+    bench_perf_stop(&perf);
+
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    for (int i = 0; i < readers; i++) {
+        reads += workers[i].ops;
+        torn += workers[i].torn;
+    }
+    printf("%-12s %8d %14.0f %12.0f %7llu\n", snapshot_names[kind], readers,
+           (double)reads / seconds, (double)workers[readers].ops / seconds, (unsigned long long)torn);
+    bench_perf_report(&perf, (double)reads, "%s readers=%d", snapshot_names[kind], readers);
+    fflush(stdout);
+
+    rw_lock_destroy(&bs.rw);
+    free(workers);
+    free(tids);
+}
+
+int main(int argc, char **argv) {
+    int duration_ms = 200;
+    int max_readers = bench_num_cpus();
+    int write_interval_us = 10;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:w:h")) != -1) {
+        switch (opt) {
+        case 'd': duration_ms = atoi(optarg); break;
+        case 't': max_readers = atoi(optarg); break;
+        case 'w': write_interval_us = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d ms] [-t max_readers] [-w write_interval_us]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (duration_ms <= 0 || max_readers <= 0 || write_interval_us < 0) {
+        fprintf(stderr, "Usage: %s [-d ms] [-t max_readers] [-w write_interval_us]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Snapshot benchmark: %d CPUs, %d ms per case, one write every %d us\n",
+           bench_num_cpus(), duration_ms, write_interval_us);
+    printf("%-12s %8s %14s %12s %7s\n", "lock", "readers", "reads/s", "writes/s", "torn");
+
+    for (int readers = 1; readers != 0; readers = bench_next_threads(readers, max_readers)) {
+        for (int k = S_SIMPLE_LOCK; k <= S_SEQLOCK; k++) {
+            run_snapshot_case((snapshot_kind_t)k, readers, duration_ms, write_interval_us);
+        }
+    }
+
+    return 0;
+}
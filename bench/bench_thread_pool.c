@@ -0,0 +1,138 @@
+/**
+ * bench_thread_pool.c - Task dispatch cost: pthread per task vs thread pool
+ *
+ * Measures the cost of running many empty tasks:
+ * 1. pthread_create + pthread_join for every task (what main() used to do)
+ * 2. thread_pool_submit from outside the pool (injection queue)
+ * 3. thread_pool_submit from inside a task (worker's own Chase-Lev deque,
+ *    spread to the other workers by stealing)
+ *
+ * Usage: bench_thread_pool [-n tasks] [-t max_workers]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "thread_pool.h"
+
+static uint64_t tasks_run = 0;
+
+// The "work": one relaxed increment so the task is not optimized away
+static void *empty_task(void *arg) {
+    (void)arg;
+    __atomic_fetch_add(&tasks_run, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+typedef struct {
+    thread_pool_t *pool;
+    int count;
+} spawner_arg_t;
+
+// Root task that fans out `count` children from inside the pool
+static void *spawner_task(void *arg) {
+    spawner_arg_t *s = (spawner_arg_t *)arg;
+    for (int i = 0; i < s->count; i++) {
+        thread_pool_submit(s->pool, empty_task, NULL);
+    }
+    return NULL;
+}
+
+static void report(const char *mode, int workers, int tasks, uint64_t elapsed_ns) {
+    printf("%-20s %8d %10d %12.1f %14.0f\n", mode, workers, tasks,
+           (double)elapsed_ns / tasks, (double)tasks * 1e9 / (double)elapsed_ns);
+    fflush(stdout);
+}
+
+static void bench_pthread_per_task(int tasks) {
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < tasks; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, empty_task, NULL) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+        pthread_join(t, NULL);
+    }
+    report("pthread_create", 1, tasks, bench_now_ns() - start);
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, tasks, "pthread_create workers=1 tasks=%d", tasks);
+}
+
+static void bench_pool(int workers, int tasks, bool from_inside) {
+    // Counted from before the workers start to after they are joined, so
+    // the record includes the pool's startup and warm-up as well
+    bench_perf_t perf;
+    bench_perf_start(&perf);
+    thread_pool_t pool;
+    if (thread_pool_init(&pool, workers) != 0) {
+        perror("thread_pool_init");
+        exit(1);
+    }
+
+    // Warm up: let every worker start and park once
+    for (int i = 0; i < workers; i++) {
+        thread_pool_submit(&pool, empty_task, NULL);
+    }
+    thread_pool_wait(&pool);
+
+    spawner_arg_t spawner = {&pool, tasks};
+    uint64_t start = bench_now_ns();
+    if (from_inside) {
+        thread_pool_submit(&pool, spawner_task, &spawner);
+    } else {
+        for (int i = 0; i < tasks; i++) {
+            thread_pool_submit(&pool, empty_task, NULL);
+        }
+    }
+    thread_pool_wait(&pool);
+    uint64_t elapsed = bench_now_ns() - start;
+
+    const char *mode = from_inside ? "pool_submit_inside" : "pool_submit_outside";
+    report(mode, workers, tasks, elapsed);
+    thread_pool_destroy(&pool);
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, tasks, "%s workers=%d tasks=%d", mode, workers, tasks);
+}
+
+int main(int argc, char **argv) {
+    int tasks = 200000;
+    int max_workers = bench_num_cpus();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:h")) != -1) {
+        switch (opt) {
+        case 'n': tasks = atoi(optarg); break;
+        case 't': max_workers = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n tasks] [-t max_workers]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (tasks <= 0 || max_workers <= 0) {
+        fprintf(stderr, "Usage: %s [-n tasks] [-t max_workers]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Thread pool dispatch benchmark: %d CPUs\n", bench_num_cpus());
+    printf("%-20s %8s %10s %12s %14s\n", "mode", "workers", "tasks", "ns/task", "tasks/s");
+
+    // Thread creation is slow enough that a smaller run gives the same answer
+    bench_pthread_per_task(tasks < 10000 ? tasks : 10000);
+
+    for (int workers = 1; workers != 0; workers = bench_next_threads(workers, max_workers)) {
+        bench_pool(workers, tasks, false);
+        bench_pool(workers, tasks, true);
+    }
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * bench_vector.c - Push throughput of vector.h vs realloc-by-one
+ *
+ * For n = 1K, 16K, 256K and 4M ints (up to -n) it compares:
+ * 1. realloc+1  - the naive buffer: realloc to size + 1 on every push
+ * 2. vector     - int_vector_push with doubling growth
+ * 3. reserved   - int_vector_reserve(n) first, then push
+ *
+ * Prints ns per push, pushes per second, the number of reallocations and
+ * how many of them moved the data to a new address.
+ *
+ * Usage: bench_vector [-n max_elements]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+#include "vector.h"
+
+VECTOR_DECLARE(int_vector, int)
+
+// Counters for the case being timed; report() stops them
+static bench_perf_t perf;
+
+static void report(size_t n, const char *method, uint64_t ns, size_t reallocs, size_t moves) {
+    bench_perf_stop(&perf);
+    bench_perf_report(&perf, (double)n, "%s elements=%zu", method, n);
+    printf("%-10zu %-10s %10.2f %14.0f %10zu %10zu\n", n, method, (double)ns / (double)n,
+           (double)n * 1e9 / (double)ns, reallocs, moves);
+    fflush(stdout);
+}
+
+static void run_naive(size_t n) {
+    int *data = NULL;
+    size_t reallocs = 0, moves = 0;
+
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i++) {
+        int *grown = (int *)realloc(data, (i + 1) * sizeof(int));
+        if (grown == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+        reallocs++;
+        moves += grown != data;
+        data = grown;
+        data[i] = (int)i;
+    }
+    uint64_t ns = bench_now_ns() - t0;
+
+    report(n, "realloc+1", ns, reallocs, moves);
+    free(data);
+}
+
+static void run_vector(size_t n, bool reserve) {
+    int_vector_t v;
+    int_vector_init(&v);
+    size_t reallocs = 0;
+
+    bench_perf_start(&perf);
+    uint64_t t0 = bench_now_ns();
+    if (reserve) {
+        if (int_vector_reserve(&v, n) != 0) {
+            perror("int_vector_reserve");
+            exit(1);
+        }
+        reallocs++;
+    }
+    for (size_t i = 0; i < n; i++) {
+        size_t capacity = v.capacity;
+        if (int_vector_push(&v, (int)i) != 0) {
+            perror("int_vector_push");
+            exit(1);
+        }
+        reallocs += v.capacity != capacity;
+    }
+    uint64_t ns = bench_now_ns() - t0;
+
+    // Every vector reallocation moves: aligned_alloc cannot grow in place
+    report(n, reserve ? "reserved" : "vector", ns, reallocs, reallocs);
+    int_vector_free(&v);
+}
+
+int main(int argc, char **argv) {
+    size_t max_elements = 16u << 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+        case 'n': max_elements = (size_t)atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n max_elements]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    printf("Vector push benchmark\n");
+    printf("%-10s %-10s %10s %14s %10s %10s\n", "elements", "method", "ns/push", "pushes/s", "reallocs", "moves");
+
+    for (size_t n = 1024; n <= max_elements; n *= 16) {
+        run_naive(n);
+        run_vector(n, false);
+        run_vector(n, true);
+    }
+
+    return 0;
+}
@@ -0,0 +1,374 @@
+/**
+ * affinity.h - Thread placement policies and NUMA-node-local memory
+ *
+ * By default the scheduler may run a thread on any CPU and move it at any
+ * time. Threads that hand a lock back and forth then pay for the lock's
+ * cache line crossing cores, or sockets, in ways that change from run to
+ * run. This header pins threads according to a placement policy:
+ *
+ * 1. none    - leave placement to the scheduler
+ * 2. compact - fill CPUs in topology order: hyperthread siblings first, then
+ *              the other cores of the same socket, then the next socket
+ * 3. scatter - spread threads out: one per NUMA node (or socket) in turn, and
+ *              within a node one per physical core before any sibling
+ * 4. a list  - explicit CPUs such as "0,2,4-7", used in that order
+ *
+ *     affinity_plan_t plan;
+ *     affinity_plan_init(&plan, "scatter");
+ *     pthread_attr_t attr;
+ *     affinity_attr_init(&attr, &plan, i);          // thread i's CPU
+ *     pthread_create(&tid, &attr, fn, arg);
+ *     pthread_attr_destroy(&attr);
+ *     affinity_plan_destroy(&plan);
+ *
+ * Thread i gets the plan's i-th CPU, wrapping around when there are more
+ * threads than CPUs. Only CPUs in the process's current affinity mask are
+ * used. Topology comes from /sys/devices/system; where that is missing,
+ * every CPU counts as its own core on node 0.
+ *
+ * affinity_alloc_on_node() returns zeroed pages that the kernel prefers to
+ * place on one NUMA node, so per-thread data can live next to the thread's
+ * CPU. Without NUMA support the pages are placed by first touch.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (pthread_attr_setaffinity_np and CPU_SET are GNU extensions).
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+typedef enum {
+    AFFINITY_NONE,
+    AFFINITY_COMPACT,
+    AFFINITY_SCATTER,
+    AFFINITY_LIST
+} affinity_policy_t;
+
+typedef struct {
+    affinity_policy_t policy;
+    int *cpus;    // CPUs in placement order (NULL for AFFINITY_NONE)
+    int count;
+} affinity_plan_t;
+
+static inline const char *affinity_policy_name(affinity_policy_t policy) {
+    switch (policy) {
+    case AFFINITY_COMPACT: return "compact";
+    case AFFINITY_SCATTER: return "scatter";
+    case AFFINITY_LIST:    return "list";
+    default:               return "none";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Topology
+// ---------------------------------------------------------------------------
+
+// One integer from a sysfs file, or `fallback` when it cannot be read
+static inline int affinity_read_int(const char *path, int fallback) {
+    FILE *f = fopen(path, "r");
+    int value;
+    if (f == NULL) {
+        return fallback;
+    }
+    if (fscanf(f, "%d", &value) != 1) {
+        value = fallback;
+    }
+    fclose(f);
+    return value;
+}
+
+// NUMA node of `cpu`: the cpuN directory holds a nodeM link. -1 if unknown.
+static inline int affinity_cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return -1;
+    }
+    int node = -1;
+    struct dirent *e;
+    while ((e = readdir(dir)) != NULL) {
+        if (strncmp(e->d_name, "node", 4) == 0 && isdigit((unsigned char)e->d_name[4])) {
+            node = atoi(e->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+typedef struct {
+    int cpu;
+    int domain;   // NUMA node, or the socket when the node is unknown
+    int package;
+    int core;
+    int sibling;  // 0 for the first hardware thread of a core, 1 for the next...
+} affinity_cpu_info_t;
+
+static inline int affinity_compare_compact(const void *a, const void *b) {
+    const affinity_cpu_info_t *x = (const affinity_cpu_info_t *)a;
+    const affinity_cpu_info_t *y = (const affinity_cpu_info_t *)b;
+    if (x->domain != y->domain) return x->domain - y->domain;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+// Within a domain: every core's first hardware thread, then the second...
+static inline int affinity_compare_spread(const void *a, const void *b) {
+    const affinity_cpu_info_t *x = (const affinity_cpu_info_t *)a;
+    const affinity_cpu_info_t *y = (const affinity_cpu_info_t *)b;
+    if (x->domain != y->domain) return x->domain - y->domain;
+    if (x->sibling != y->sibling) return x->sibling - y->sibling;
+    return affinity_compare_compact(a, b);
+}
+
+// The CPUs this process may run on, with their topology, in compact order.
+// Returns the count, or -1 on failure.
+static inline int affinity_topology(affinity_cpu_info_t **out) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return -1;
+    }
+    int count = CPU_COUNT(&allowed);
+    affinity_cpu_info_t *info = (affinity_cpu_info_t *)calloc(count > 0 ? count : 1, sizeof(*info));
+    if (info == NULL) {
+        return -1;
+    }
+
+    char path[96];
+    int n = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && n < count; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        int package = affinity_read_int(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        int node = affinity_cpu_node(cpu);
+
+        info[n].cpu = cpu;
+        info[n].package = package;
+        info[n].core = affinity_read_int(path, cpu);
+        info[n].domain = node >= 0 ? node : package;
+        n++;
+    }
+
+    // Number the hardware threads of each core
+    qsort(info, n, sizeof(*info), affinity_compare_compact);
+    for (int i = 1; i < n; i++) {
+        bool same_core = info[i].domain == info[i - 1].domain &&
+                         info[i].package == info[i - 1].package && info[i].core == info[i - 1].core;
+        info[i].sibling = same_core ? info[i - 1].sibling + 1 : 0;
+    }
+    *out = info;
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Plans
+// ---------------------------------------------------------------------------
+
+// Parse "0,2,4-7" into `cpus` (at most `max` entries). Returns the count,
+// or -1 if the list is malformed or names a CPU outside the allowed set.
+static inline int affinity_parse_list(const char *spec, int *cpus, int max) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return -1;
+    }
+    int n = 0;
+    const char *p = spec;
+    while (*p != '\0') {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p) {
+            return -1;
+        }
+        long hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1) {
+                return -1;
+            }
+            p = end;
+        }
+        if (lo < 0 || hi < lo || hi >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long cpu = lo; cpu <= hi; cpu++) {
+            if (!CPU_ISSET((int)cpu, &allowed) || n >= max) {
+                return -1;
+            }
+            cpus[n++] = (int)cpu;
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+    return n > 0 ? n : -1;
+}
+
+static inline void affinity_plan_destroy(affinity_plan_t *plan) {
+    free(plan->cpus);
+    memset(plan, 0, sizeof(*plan));
+}
+
+// Build a plan from "none" (or NULL), "compact", "scatter" or a CPU list.
+// Returns 0 on success, -1 for an invalid spec or when out of memory.
+static inline int affinity_plan_init(affinity_plan_t *plan, const char *spec) {
+    memset(plan, 0, sizeof(*plan));
+    if (spec == NULL || strcmp(spec, "none") == 0) {
+        return 0;
+    }
+
+    affinity_cpu_info_t *info;
+    int n = affinity_topology(&info);
+    if (n <= 0) {
+        return -1;
+    }
+    plan->cpus = (int *)malloc(n * sizeof(int));
+    if (plan->cpus == NULL) {
+        free(info);
+        return -1;
+    }
+
+    if (strcmp(spec, "compact") == 0) {
+        plan->policy = AFFINITY_COMPACT;
+        for (int i = 0; i < n; i++) {
+            plan->cpus[i] = info[i].cpu;
+        }
+        plan->count = n;
+    } else if (strcmp(spec, "scatter") == 0) {
+        // Spread within each domain, then deal the domains out round-robin
+        plan->policy = AFFINITY_SCATTER;
+        qsort(info, n, sizeof(*info), affinity_compare_spread);
+        int *cursor = (int *)malloc(2 * n * sizeof(int));   // Next and end per domain
+        if (cursor == NULL) {
+            free(info);
+            affinity_plan_destroy(plan);
+            return -1;
+        }
+        int *limit = cursor + n;
+        int domains = 0;
+        for (int i = 0; i < n; i++) {
+            if (i == 0 || info[i].domain != info[i - 1].domain) {
+                cursor[domains++] = i;
+            }
+            limit[domains - 1] = i + 1;
+        }
+        while (plan->count < n) {
+            for (int d = 0; d < domains; d++) {
+                if (cursor[d] < limit[d]) {
+                    plan->cpus[plan->count++] = info[cursor[d]++].cpu;
+                }
+            }
+        }
+        free(cursor);
+    } else {
+        plan->policy = AFFINITY_LIST;
+        plan->count = affinity_parse_list(spec, plan->cpus, n);
+        if (plan->count < 0) {
+            free(info);
+            affinity_plan_destroy(plan);
+            return -1;
+        }
+    }
+    free(info);
+    return 0;
+}
+
+// CPU for the `index`-th thread, or -1 when the plan does not pin
+static inline int affinity_plan_cpu(const affinity_plan_t *plan, int index) {
+    if (plan == NULL || plan->count == 0) {
+        return -1;
+    }
+    return plan->cpus[index % plan->count];
+}
+
+// Initialize `attr` for the `index`-th thread of `plan` (NULL: no pinning).
+// Returns 0 on success, -1 on failure; destroy attr with pthread_attr_destroy.
+static inline int affinity_attr_init(pthread_attr_t *attr, const affinity_plan_t *plan, int index) {
+    if (pthread_attr_init(attr) != 0) {
+        return -1;
+    }
+    int cpu = affinity_plan_cpu(plan, index);
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_attr_setaffinity_np(attr, sizeof(set), &set) != 0) {
+            pthread_attr_destroy(attr);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// NUMA-node-local memory
+// ---------------------------------------------------------------------------
+
+// From <linux/mempolicy.h>: prefer the given node, fall back to others
+#define AFFINITY_MPOL_PREFERRED 1
+
+// Ask the kernel to place the not-yet-touched pages of an mmap'd range on
+// `node` (node < 0: leave them to first touch)
+static inline void affinity_bind_to_node(void *p, size_t bytes, int node) {
+#ifdef SYS_mbind
+    if (node >= 0 && node < 1024) {
+        unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+        memset(mask, 0, sizeof(mask));
+        mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+        // Only a preference: without NUMA support this fails harmlessly
+        // and the pages are placed by first touch instead
+        (void)syscall(SYS_mbind, p, bytes, AFFINITY_MPOL_PREFERRED, mask, 8 * sizeof(mask) + 1, 0);
+    }
+#else
+    (void)p;
+    (void)bytes;
+    (void)node;
+#endif
+}
+
+// Zeroed, page-aligned memory the kernel places on `node` when it can
+// (node < 0: wherever the first thread to touch it runs). Free it with
+// affinity_free(). Returns NULL when out of memory.
+static inline void *affinity_alloc_on_node(size_t bytes, int node) {
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    affinity_bind_to_node(p, bytes, node);
+    return p;
+}
+
+// Memory on the NUMA node of the CPU the caller is running on right now
+// (meaningful once the caller is pinned)
+static inline void *affinity_alloc_local(size_t bytes) {
+    int cpu = sched_getcpu();
+    return affinity_alloc_on_node(bytes, cpu >= 0 ? affinity_cpu_node(cpu) : -1);
+}
+
+static inline void affinity_free(void *p, size_t bytes) {
+    if (p != NULL) {
+        munmap(p, bytes);
+    }
+}
+
+#endif // AFFINITY_H
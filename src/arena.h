@@ -0,0 +1,381 @@
+/**
+ * arena.h - Arena (bump-pointer) allocator and fixed-size object pool
+ *
+ * General-purpose malloc has to handle any size, any lifetime and any
+ * order of frees. Much of our memory is simpler than that: a matrix, a
+ * parse tree or a batch of buffers that are all created together and
+ * thrown away together. For those:
+ *
+ * 1. arena_t - hands out memory by bumping a pointer through large chunks.
+ *              Allocation is an add and a compare; there is no per-object
+ *              free. arena_mark/arena_rewind drop everything allocated after
+ *              a point, and arena_release frees the whole arena in one call.
+ *
+ *     arena_t a;
+ *     arena_init(&a, 64 * 1024);                  // chunk size
+ *     int *row = ARENA_NEW_ARRAY(&a, int, cols);  // typed helper
+ *     arena_mark_t m = arena_mark(&a);
+ *     void *tmp = arena_alloc(&a, 256);           // scratch space...
+ *     arena_rewind(&a, m);                        // ...gone again
+ *     arena_release(&a);                          // everything gone
+ *
+ * 2. object_pool_t - recycles blocks of a single size through a free list,
+ *                    for objects that come and go individually.
+ *
+ * Both get their chunks from malloc by default. A large matrix spread over
+ * 4KB pages needs a TLB entry for every 4KB it touches, so both can
+ * instead take whole pages from the kernel, optionally on one NUMA node:
+ *
+ *     arena_init_backing(&a, 64u << 20, ARENA_BACKING_HUGE_PAGES, node);
+ *
+ * ARENA_BACKING_PAGES     - plain mmap'd pages
+ * ARENA_BACKING_HUGE_PAGES - 2MB-aligned chunks with MADV_HUGEPAGE, so
+ *                           transparent huge pages back them when
+ *                           /sys/kernel/mm/transparent_hugepage allows it
+ * ARENA_BACKING_HUGETLB   - pages reserved in vm.nr_hugepages. When none
+ *                           are free, the arena falls back to
+ *                           ARENA_BACKING_HUGE_PAGES and says so in
+ *                           a->backing.
+ *
+ * Chunks are rounded up to whole pages of the backing, so use chunk sizes
+ * of at least a few MB with the huge backings. node < 0 leaves placement
+ * to first touch.
+ *
+ * Neither structure is thread-safe; give each thread its own.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see affinity.h).
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "affinity.h"  // affinity_bind_to_node
+
+// Alignment of arena_alloc and object pool blocks: good for any scalar type
+#define ARENA_DEFAULT_ALIGNMENT alignof(max_align_t)
+
+// ---------------------------------------------------------------------------
+// Chunk memory
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    ARENA_BACKING_MALLOC,      // malloc (the default)
+    ARENA_BACKING_PAGES,       // mmap'd base pages
+    ARENA_BACKING_HUGE_PAGES,  // Transparent 2MB huge pages when available
+    ARENA_BACKING_HUGETLB      // Reserved hugetlbfs pages, else HUGE_PAGES
+} arena_backing_t;
+
+#define ARENA_HUGE_PAGE_SIZE (2u << 20)
+
+static inline const char *arena_backing_name(arena_backing_t backing) {
+    switch (backing) {
+    case ARENA_BACKING_PAGES: return "pages";
+    case ARENA_BACKING_HUGE_PAGES: return "huge_pages";
+    case ARENA_BACKING_HUGETLB: return "hugetlb";
+    default: return "malloc";
+    }
+}
+
+// Size actually allocated for a request of `bytes`: whole pages of the backing
+static inline size_t arena_backing_round(arena_backing_t backing, size_t bytes) {
+    size_t unit;
+    switch (backing) {
+    case ARENA_BACKING_MALLOC: return bytes;
+    case ARENA_BACKING_PAGES: unit = (size_t)sysconf(_SC_PAGESIZE); break;
+    default: unit = ARENA_HUGE_PAGE_SIZE; break;
+    }
+    return (bytes + unit - 1) / unit * unit;
+}
+
+// A 2MB-aligned anonymous mapping. Transparent huge pages can only back
+// aligned 2MB ranges, so map 2MB extra and unmap the ends.
+static inline void *arena_map_huge_aligned(size_t bytes) {
+    size_t span = bytes + ARENA_HUGE_PAGE_SIZE;
+    char *reserve = (char *)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserve == MAP_FAILED) {
+        return NULL;
+    }
+    char *p = (char *)(((uintptr_t)reserve + ARENA_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE_SIZE - 1));
+    if (p > reserve) {
+        munmap(reserve, (size_t)(p - reserve));
+    }
+    if (p + bytes < reserve + span) {
+        munmap(p + bytes, (size_t)(reserve + span - (p + bytes)));
+    }
+    return p;
+}
+
+// Memory for one chunk of `bytes` (already rounded by arena_backing_round).
+// *backing drops from HUGETLB to HUGE_PAGES when no huge pages are reserved.
+static inline void *arena_backing_alloc(arena_backing_t *backing, size_t bytes, int node) {
+    void *p;
+    switch (*backing) {
+    case ARENA_BACKING_MALLOC:
+        return malloc(bytes);
+    case ARENA_BACKING_HUGETLB:
+#ifdef MAP_HUGETLB
+        p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            affinity_bind_to_node(p, bytes, node);
+            return p;
+        }
+#endif
+        *backing = ARENA_BACKING_HUGE_PAGES;
+        // fall through
+    case ARENA_BACKING_HUGE_PAGES:
+        p = arena_map_huge_aligned(bytes);
+        if (p != NULL) {
+            // Placement first: both only affect pages not yet touched
+            affinity_bind_to_node(p, bytes, node);
+            madvise(p, bytes, MADV_HUGEPAGE);  // A hint; ignored where THP is off
+        }
+        return p;
+    default:
+        return affinity_alloc_on_node(bytes, node);
+    }
+}
+
+static inline void arena_backing_free(arena_backing_t backing, void *p, size_t bytes) {
+    if (backing == ARENA_BACKING_MALLOC) {
+        free(p);
+    } else if (p != NULL) {
+        munmap(p, bytes);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// arena_t
+// ---------------------------------------------------------------------------
+
+// Chunks form a singly linked list from newest to oldest
+typedef struct arena_chunk {
+    struct arena_chunk *prev;  // Previously allocated chunk
+    size_t size;               // Usable bytes after the header
+} arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t *chunk;  // Chunk we are bumping through (NULL before first use)
+    char *ptr;             // Next free byte in chunk
+    char *end;             // One past the last byte of chunk
+    size_t chunk_size;     // Default size of new chunks
+    arena_backing_t backing;
+    int node;              // NUMA node for page backings, -1 = first touch
+} arena_t;
+
+// A saved position: everything allocated after it can be dropped at once
+typedef struct {
+    arena_chunk_t *chunk;
+    char *ptr;
+} arena_mark_t;
+
+// Bytes reserved at the start of every chunk for its header
+#define ARENA_HEADER_SIZE \
+    ((sizeof(arena_chunk_t) + ARENA_DEFAULT_ALIGNMENT - 1) & ~(ARENA_DEFAULT_ALIGNMENT - 1))
+
+static inline char *arena_chunk_data(arena_chunk_t *chunk) {
+    return (char *)chunk + ARENA_HEADER_SIZE;
+}
+
+// Set up an empty arena. No memory is allocated until the first request.
+static inline void arena_init(arena_t *a, size_t chunk_size) {
+    a->chunk = NULL;
+    a->ptr = NULL;
+    a->end = NULL;
+    a->chunk_size = chunk_size > 0 ? chunk_size : 64 * 1024;
+    a->backing = ARENA_BACKING_MALLOC;
+    a->node = -1;
+}
+
+// Same, with chunks taken from `backing` (on `node` if >= 0)
+static inline void arena_init_backing(arena_t *a, size_t chunk_size, arena_backing_t backing, int node) {
+    arena_init(a, chunk_size);
+    a->backing = backing;
+    a->node = node;
+}
+
+// Slow path: start a new chunk big enough for `size` bytes at `align`
+static inline void *arena_alloc_slow(arena_t *a, size_t size, size_t align) {
+    size_t need = size + align;
+    size_t chunk_size = need > a->chunk_size ? need : a->chunk_size;
+    // Page backings round up; the rest of the last page is usable too
+    chunk_size = arena_backing_round(a->backing, ARENA_HEADER_SIZE + chunk_size) - ARENA_HEADER_SIZE;
+
+    arena_chunk_t *chunk = (arena_chunk_t *)arena_backing_alloc(&a->backing, ARENA_HEADER_SIZE + chunk_size,
+                                                                a->node);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->prev = a->chunk;
+    chunk->size = chunk_size;
+    a->chunk = chunk;
+    a->ptr = arena_chunk_data(chunk);
+    a->end = a->ptr + chunk_size;
+
+    uintptr_t p = ((uintptr_t)a->ptr + align - 1) & ~(uintptr_t)(align - 1);
+    a->ptr = (char *)p + size;
+    return (void *)p;
+}
+
+// Allocate `size` bytes aligned to `align` (a power of two). Returns NULL
+// only if a new chunk cannot be allocated.
+static inline void *arena_alloc_aligned(arena_t *a, size_t size, size_t align) {
+    uintptr_t p = ((uintptr_t)a->ptr + align - 1) & ~(uintptr_t)(align - 1);
+    if (a->ptr != NULL && p + size <= (uintptr_t)a->end) {
+        a->ptr = (char *)p + size;
+        return (void *)p;
+    }
+    return arena_alloc_slow(a, size, align);
+}
+
+// Allocate `size` bytes suitably aligned for any type
+static inline void *arena_alloc(arena_t *a, size_t size) {
+    return arena_alloc_aligned(a, size, ARENA_DEFAULT_ALIGNMENT);
+}
+
+// Allocate `size` zeroed bytes
+static inline void *arena_calloc(arena_t *a, size_t size) {
+    void *p = arena_alloc(a, size);
+    if (p != NULL) {
+        memset(p, 0, size);
+    }
+    return p;
+}
+
+// Typed helpers: ARENA_NEW(&a, node_t), ARENA_NEW_ARRAY(&a, int, 5)
+#define ARENA_NEW(a, type) \
+    ((type *)arena_alloc_aligned((a), sizeof(type), alignof(type)))
+#define ARENA_NEW_ARRAY(a, type, count) \
+    ((type *)arena_alloc_aligned((a), sizeof(type) * (count), alignof(type)))
+
+// Remember the current position
+static inline arena_mark_t arena_mark(const arena_t *a) {
+    arena_mark_t m = {a->chunk, a->ptr};
+    return m;
+}
+
+// Drop everything allocated since `m`, freeing chunks created after it
+static inline void arena_rewind(arena_t *a, arena_mark_t m) {
+    while (a->chunk != m.chunk) {
+        arena_chunk_t *prev = a->chunk->prev;
+        arena_backing_free(a->backing, a->chunk, ARENA_HEADER_SIZE + a->chunk->size);
+        a->chunk = prev;
+    }
+    a->ptr = m.ptr;
+    a->end = a->chunk != NULL ? arena_chunk_data(a->chunk) + a->chunk->size : NULL;
+}
+
+// Free every chunk at once; the arena can be used again afterwards
+static inline void arena_release(arena_t *a) {
+    arena_mark_t empty = {NULL, NULL};
+    arena_rewind(a, empty);
+}
+
+// ---------------------------------------------------------------------------
+// object_pool_t
+// ---------------------------------------------------------------------------
+
+// Free blocks are threaded through their own first bytes, so the free
+// list costs no memory. Blocks are carved from slabs that are only
+// returned to malloc (or the kernel) by object_pool_destroy.
+typedef struct object_pool_node {
+    struct object_pool_node *next;
+} object_pool_node_t;
+
+// Header at the start of every slab, inside its ARENA_HEADER_SIZE bytes
+typedef struct object_pool_slab {
+    struct object_pool_slab *next;
+    size_t bytes;                   // Whole slab, header included
+} object_pool_slab_t;
+
+_Static_assert(sizeof(object_pool_slab_t) <= ARENA_HEADER_SIZE, "slab header must fit in ARENA_HEADER_SIZE");
+
+typedef struct {
+    object_pool_node_t *free_list;  // Blocks ready for reuse
+    object_pool_slab_t *slabs;      // Every slab, newest first
+    size_t object_size;             // Block size, rounded up to the alignment
+    size_t objects_per_slab;
+    arena_backing_t backing;
+    int node;
+} object_pool_t;
+
+// Prepare a pool of `object_size`-byte blocks, allocated `objects_per_slab`
+// at a time
+static inline void object_pool_init(object_pool_t *p, size_t object_size,
+                                    size_t objects_per_slab) {
+    if (object_size < sizeof(object_pool_node_t)) {
+        object_size = sizeof(object_pool_node_t);
+    }
+    p->object_size = (object_size + ARENA_DEFAULT_ALIGNMENT - 1) & ~(ARENA_DEFAULT_ALIGNMENT - 1);
+    p->objects_per_slab = objects_per_slab > 0 ? objects_per_slab : 64;
+    p->free_list = NULL;
+    p->slabs = NULL;
+    p->backing = ARENA_BACKING_MALLOC;
+    p->node = -1;
+}
+
+// Same, with slabs taken from `backing` (on `node` if >= 0). Slabs grow to
+// whole pages, so a slab may hold more than objects_per_slab blocks.
+static inline void object_pool_init_backing(object_pool_t *p, size_t object_size, size_t objects_per_slab,
+                                            arena_backing_t backing, int node) {
+    object_pool_init(p, object_size, objects_per_slab);
+    p->backing = backing;
+    p->node = node;
+}
+
+// Grab a new slab and push all its blocks on the free list. Returns -1 on OOM.
+static inline int object_pool_grow(object_pool_t *p) {
+    size_t bytes = arena_backing_round(p->backing, ARENA_HEADER_SIZE + p->object_size * p->objects_per_slab);
+    object_pool_slab_t *slab = (object_pool_slab_t *)arena_backing_alloc(&p->backing, bytes, p->node);
+    if (slab == NULL) {
+        return -1;
+    }
+    slab->next = p->slabs;
+    slab->bytes = bytes;
+    p->slabs = slab;
+
+    char *block = (char *)slab + ARENA_HEADER_SIZE;
+    size_t count = (bytes - ARENA_HEADER_SIZE) / p->object_size;
+    for (size_t i = 0; i < count; i++) {
+        object_pool_node_t *node = (object_pool_node_t *)(block + i * p->object_size);
+        node->next = p->free_list;
+        p->free_list = node;
+    }
+    return 0;
+}
+
+// Take a block (uninitialized). Returns NULL only on OOM.
+static inline void *object_pool_alloc(object_pool_t *p) {
+    if (p->free_list == NULL && object_pool_grow(p) != 0) {
+        return NULL;
+    }
+    object_pool_node_t *node = p->free_list;
+    p->free_list = node->next;
+    return node;
+}
+
+// Give a block back for reuse
+static inline void object_pool_free(object_pool_t *p, void *obj) {
+    object_pool_node_t *node = (object_pool_node_t *)obj;
+    node->next = p->free_list;
+    p->free_list = node;
+}
+
+// Return every slab, including blocks still in use
+static inline void object_pool_destroy(object_pool_t *p) {
+    while (p->slabs != NULL) {
+        object_pool_slab_t *next = p->slabs->next;
+        arena_backing_free(p->backing, p->slabs, p->slabs->bytes);
+        p->slabs = next;
+    }
+    p->free_list = NULL;
+}
+
+#endif // ARENA_H
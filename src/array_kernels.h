@@ -0,0 +1,594 @@
+/**
+ * array_kernels.h - Bulk int array kernels with SIMD versions picked at runtime
+ *
+ * pointer_arithmetic_examples walks an array one element per step. These
+ * kernels do the same walks four or eight elements per instruction:
+ *
+ * 1. sum        - 64-bit sum of all elements (no overflow for any n we can store)
+ * 2. minmax     - smallest and largest element
+ * 3. fill       - set every element to a value
+ * 4. copy       - copy n elements (the ranges must not overlap)
+ * 5. scale_add  - dst[i] += scale * x[i], wrapping like unsigned arithmetic
+ * 6. find       - index of the first element equal to a value, or n
+ * 7. add, sub, mul - dst[i] = a[i] op b[i], wrapping on overflow; dst may
+ *                   be the same array as a or b
+ *
+ * Every kernel has a scalar version plus SSE2 and AVX2 versions on x86 and
+ * a NEON version on ARM. The SIMD versions are compiled with per-function
+ * target attributes, so no -m flags are needed. array_kernels() checks the
+ * CPU once and returns the best table:
+ *
+ *     const array_kernels_t *k = array_kernels();
+ *     long long total = k->sum(numbers, count);
+ *     size_t at = array_find(numbers, count, 40);   // same, via the wrappers
+ *
+ * array_kernels_for(ARRAY_ISA_SCALAR) and friends return one specific
+ * table (or NULL when this CPU or build cannot run it) for benchmarking.
+ * Inputs need no particular alignment.
+ */
+
+#ifndef ARRAY_KERNELS_H
+#define ARRAY_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ARRAY_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#define ARRAY_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef enum {
+    ARRAY_ISA_SCALAR,
+    ARRAY_ISA_SSE2,
+    ARRAY_ISA_AVX2,
+    ARRAY_ISA_NEON,
+    ARRAY_ISA_COUNT
+} array_isa_t;
+
+typedef struct {
+    const char *name;
+    long long (*sum)(const int *a, size_t n);
+    void (*minmax)(const int *a, size_t n, int *min, int *max);
+    void (*fill)(int *dst, int value, size_t n);
+    void (*copy)(int *dst, const int *src, size_t n);
+    void (*scale_add)(int *dst, const int *x, int scale, size_t n);
+    size_t (*find)(const int *a, size_t n, int value);
+    void (*add)(int *dst, const int *a, const int *b, size_t n);
+    void (*sub)(int *dst, const int *a, const int *b, size_t n);
+    void (*mul)(int *dst, const int *a, const int *b, size_t n);
+} array_kernels_t;
+
+// ---------------------------------------------------------------------------
+// Scalar baseline (also handles the tails of the SIMD loops)
+// ---------------------------------------------------------------------------
+
+static inline long long array_sum_scalar(const int *a, size_t n) {
+    long long sum = 0;
+    for (const int *end = a + n; a < end; a++) {
+        sum += *a;
+    }
+    return sum;
+}
+
+// On an empty array min is INT_MAX and max is INT_MIN
+static inline void array_minmax_scalar(const int *a, size_t n, int *min, int *max) {
+    int lo = INT_MAX, hi = INT_MIN;
+    for (const int *end = a + n; a < end; a++) {
+        lo = *a < lo ? *a : lo;
+        hi = *a > hi ? *a : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static inline void array_fill_scalar(int *dst, int value, size_t n) {
+    for (int *end = dst + n; dst < end; dst++) {
+        *dst = value;
+    }
+}
+
+static inline void array_copy_scalar(int *dst, const int *src, size_t n) {
+    for (int *end = dst + n; dst < end; dst++, src++) {
+        *dst = *src;
+    }
+}
+
+// Done in unsigned arithmetic so overflow wraps instead of being undefined
+static inline void array_scale_add_scalar(int *dst, const int *x, int scale, size_t n) {
+    for (int *end = dst + n; dst < end; dst++, x++) {
+        *dst = (int)((unsigned)*dst + (unsigned)scale * (unsigned)*x);
+    }
+}
+
+static inline size_t array_find_scalar(const int *a, size_t n, int value) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] == value) {
+            return i;
+        }
+    }
+    return n;
+}
+
+// Elementwise arithmetic, also in unsigned arithmetic so overflow wraps
+static inline void array_add_scalar(int *dst, const int *a, const int *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = (int)((unsigned)a[i] + (unsigned)b[i]);
+    }
+}
+
+static inline void array_sub_scalar(int *dst, const int *a, const int *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = (int)((unsigned)a[i] - (unsigned)b[i]);
+    }
+}
+
+static inline void array_mul_scalar(int *dst, const int *a, const int *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = (int)((unsigned)a[i] * (unsigned)b[i]);
+    }
+}
+
+static const array_kernels_t array_kernels_scalar = {
+    "scalar", array_sum_scalar, array_minmax_scalar, array_fill_scalar,
+    array_copy_scalar, array_scale_add_scalar, array_find_scalar,
+    array_add_scalar, array_sub_scalar, array_mul_scalar,
+};
+
+#ifdef ARRAY_KERNELS_X86
+
+// ---------------------------------------------------------------------------
+// SSE2 (4 ints per vector)
+// ---------------------------------------------------------------------------
+
+#define ARRAY_SSE2 __attribute__((target("sse2")))
+#define ARRAY_SSE2_HELPER __attribute__((always_inline, target("sse2")))
+
+// SSE2 has no signed 32-bit min/max or 32-bit low multiply (those arrived
+// with SSE4.1), so build them from compares and 32x32->64 multiplies.
+// They are forced inline so that even -O0 builds keep them in registers.
+static inline ARRAY_SSE2_HELPER __m128i array_sse2_min(__m128i a, __m128i b) {
+    __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static inline ARRAY_SSE2_HELPER __m128i array_sse2_max(__m128i a, __m128i b) {
+    __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+static inline ARRAY_SSE2_HELPER __m128i array_sse2_mullo(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline ARRAY_SSE2 long long array_sum_sse2(const int *a, size_t n) {
+    // Sign-extend each int to 64 bits by interleaving it with its sign mask.
+    // Two accumulators keep consecutive adds independent.
+    __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i sign = _mm_srai_epi32(v, 31);
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, sign));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, sign));
+    }
+    long long lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    return lanes[0] + lanes[1] + array_sum_scalar(a + i, n - i);
+}
+
+static inline ARRAY_SSE2 void array_minmax_sse2(const int *a, size_t n, int *min, int *max) {
+    __m128i lo = _mm_set1_epi32(INT_MAX), hi = _mm_set1_epi32(INT_MIN);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(a + i));
+        lo = array_sse2_min(lo, v);
+        hi = array_sse2_max(hi, v);
+    }
+    int lo_lanes[4], hi_lanes[4];
+    _mm_storeu_si128((__m128i *)lo_lanes, lo);
+    _mm_storeu_si128((__m128i *)hi_lanes, hi);
+    array_minmax_scalar(a + i, n - i, min, max);
+    for (int l = 0; l < 4; l++) {
+        *min = lo_lanes[l] < *min ? lo_lanes[l] : *min;
+        *max = hi_lanes[l] > *max ? hi_lanes[l] : *max;
+    }
+}
+
+static inline ARRAY_SSE2 void array_fill_sse2(int *dst, int value, size_t n) {
+    __m128i v = _mm_set1_epi32(value);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    array_fill_scalar(dst + i, value, n - i);
+}
+
+static inline ARRAY_SSE2 void array_copy_sse2(int *dst, const int *src, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_loadu_si128((const __m128i *)(src + i)));
+    }
+    array_copy_scalar(dst + i, src + i, n - i);
+}
+
+static inline ARRAY_SSE2 void array_scale_add_sse2(int *dst, const int *x, int scale, size_t n) {
+    __m128i s = _mm_set1_epi32(scale);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi32(d, array_sse2_mullo(v, s)));
+    }
+    array_scale_add_scalar(dst + i, x + i, scale, n - i);
+}
+
+static inline ARRAY_SSE2 size_t array_find_sse2(const int *a, size_t n, int value) {
+    __m128i needle = _mm_set1_epi32(value);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a + i)), needle);
+        int mask = _mm_movemask_epi8(eq); // 4 bits per matching int
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz((unsigned)mask) / 4;
+        }
+    }
+    return i + array_find_scalar(a + i, n - i, value);
+}
+
+static inline ARRAY_SSE2 void array_add_sse2(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi32(x, y));
+    }
+    array_add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static inline ARRAY_SSE2 void array_sub_sse2(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_sub_epi32(x, y));
+    }
+    array_sub_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static inline ARRAY_SSE2 void array_mul_sse2(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + i), array_sse2_mullo(x, y));
+    }
+    array_mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static const array_kernels_t array_kernels_sse2 = {
+    "sse2", array_sum_sse2, array_minmax_sse2, array_fill_sse2,
+    array_copy_sse2, array_scale_add_sse2, array_find_sse2,
+    array_add_sse2, array_sub_sse2, array_mul_sse2,
+};
+
+// ---------------------------------------------------------------------------
+// AVX2 (8 ints per vector)
+// ---------------------------------------------------------------------------
+
+#define ARRAY_AVX2 __attribute__((target("avx2")))
+
+static inline ARRAY_AVX2 long long array_sum_avx2(const int *a, size_t n) {
+    // Widen 4 ints at a time straight from memory; 16 per iteration
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(a + i))));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(a + i + 4))));
+        acc2 = _mm256_add_epi64(acc2, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(a + i + 8))));
+        acc3 = _mm256_add_epi64(acc3, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(a + i + 12))));
+    }
+    __m256i acc = _mm256_add_epi64(_mm256_add_epi64(acc0, acc1), _mm256_add_epi64(acc2, acc3));
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + array_sum_scalar(a + i, n - i);
+}
+
+static inline ARRAY_AVX2 void array_minmax_avx2(const int *a, size_t n, int *min, int *max) {
+    __m256i lo = _mm256_set1_epi32(INT_MAX), hi = _mm256_set1_epi32(INT_MIN);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(a + i));
+        lo = _mm256_min_epi32(lo, v);
+        hi = _mm256_max_epi32(hi, v);
+    }
+    int lo_lanes[8], hi_lanes[8];
+    _mm256_storeu_si256((__m256i *)lo_lanes, lo);
+    _mm256_storeu_si256((__m256i *)hi_lanes, hi);
+    array_minmax_scalar(a + i, n - i, min, max);
+    for (int l = 0; l < 8; l++) {
+        *min = lo_lanes[l] < *min ? lo_lanes[l] : *min;
+        *max = hi_lanes[l] > *max ? hi_lanes[l] : *max;
+    }
+}
+
+static inline ARRAY_AVX2 void array_fill_avx2(int *dst, int value, size_t n) {
+    __m256i v = _mm256_set1_epi32(value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    array_fill_scalar(dst + i, value, n - i);
+}
+
+static inline ARRAY_AVX2 void array_copy_avx2(int *dst, const int *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_loadu_si256((const __m256i *)(src + i)));
+    }
+    array_copy_scalar(dst + i, src + i, n - i);
+}
+
+static inline ARRAY_AVX2 void array_scale_add_avx2(int *dst, const int *x, int scale, size_t n) {
+    __m256i s = _mm256_set1_epi32(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_add_epi32(d, _mm256_mullo_epi32(v, s)));
+    }
+    array_scale_add_scalar(dst + i, x + i, scale, n - i);
+}
+
+static inline ARRAY_AVX2 size_t array_find_avx2(const int *a, size_t n, int value) {
+    __m256i needle = _mm256_set1_epi32(value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(a + i)), needle);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(eq);
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz(mask) / 4;
+        }
+    }
+    return i + array_find_scalar(a + i, n - i, value);
+}
+
+static inline ARRAY_AVX2 void array_add_avx2(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_add_epi32(x, y));
+    }
+    array_add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static inline ARRAY_AVX2 void array_sub_avx2(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_sub_epi32(x, y));
+    }
+    array_sub_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static inline ARRAY_AVX2 void array_mul_avx2(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_mullo_epi32(x, y));
+    }
+    array_mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static const array_kernels_t array_kernels_avx2 = {
+    "avx2", array_sum_avx2, array_minmax_avx2, array_fill_avx2,
+    array_copy_avx2, array_scale_add_avx2, array_find_avx2,
+    array_add_avx2, array_sub_avx2, array_mul_avx2,
+};
+
+#endif // ARRAY_KERNELS_X86
+
+#ifdef ARRAY_KERNELS_NEON
+
+// ---------------------------------------------------------------------------
+// NEON (4 ints per vector)
+// ---------------------------------------------------------------------------
+
+static inline long long array_sum_neon(const int *a, size_t n) {
+    // vpadalq adds neighbouring pairs into 64-bit lanes
+    int64x2_t acc0 = vdupq_n_s64(0), acc1 = vdupq_n_s64(0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vpadalq_s32(acc0, vld1q_s32(a + i));
+        acc1 = vpadalq_s32(acc1, vld1q_s32(a + i + 4));
+    }
+    int64x2_t acc = vaddq_s64(acc0, acc1);
+    return vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1) + array_sum_scalar(a + i, n - i);
+}
+
+static inline void array_minmax_neon(const int *a, size_t n, int *min, int *max) {
+    int32x4_t lo = vdupq_n_s32(INT_MAX), hi = vdupq_n_s32(INT_MIN);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t v = vld1q_s32(a + i);
+        lo = vminq_s32(lo, v);
+        hi = vmaxq_s32(hi, v);
+    }
+    int lo_lanes[4], hi_lanes[4];
+    vst1q_s32(lo_lanes, lo);
+    vst1q_s32(hi_lanes, hi);
+    array_minmax_scalar(a + i, n - i, min, max);
+    for (int l = 0; l < 4; l++) {
+        *min = lo_lanes[l] < *min ? lo_lanes[l] : *min;
+        *max = hi_lanes[l] > *max ? hi_lanes[l] : *max;
+    }
+}
+
+static inline void array_fill_neon(int *dst, int value, size_t n) {
+    int32x4_t v = vdupq_n_s32(value);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_s32(dst + i, v);
+    }
+    array_fill_scalar(dst + i, value, n - i);
+}
+
+static inline void array_copy_neon(int *dst, const int *src, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_s32(dst + i, vld1q_s32(src + i));
+    }
+    array_copy_scalar(dst + i, src + i, n - i);
+}
+
+static inline void array_scale_add_neon(int *dst, const int *x, int scale, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_s32(dst + i, vmlaq_n_s32(vld1q_s32(dst + i), vld1q_s32(x + i), scale));
+    }
+    array_scale_add_scalar(dst + i, x + i, scale, n - i);
+}
+
+static inline size_t array_find_neon(const int *a, size_t n, int value) {
+    int32x4_t needle = vdupq_n_s32(value);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t eq = vceqq_s32(vld1q_s32(a + i), needle);
+        uint32x2_t any = vorr_u32(vget_low_u32(eq), vget_high_u32(eq));
+        if ((vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) != 0) {
+            break; // The scalar scan below pins down the lane
+        }
+    }
+    return i + array_find_scalar(a + i, n - i, value);
+}
+
+static inline void array_add_neon(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t x = vld1q_s32(a + i);
+        int32x4_t y = vld1q_s32(b + i);
+        vst1q_s32(dst + i, vaddq_s32(x, y));
+    }
+    array_add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static inline void array_sub_neon(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t x = vld1q_s32(a + i);
+        int32x4_t y = vld1q_s32(b + i);
+        vst1q_s32(dst + i, vsubq_s32(x, y));
+    }
+    array_sub_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static inline void array_mul_neon(int *dst, const int *a, const int *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t x = vld1q_s32(a + i);
+        int32x4_t y = vld1q_s32(b + i);
+        vst1q_s32(dst + i, vmulq_s32(x, y));
+    }
+    array_mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static const array_kernels_t array_kernels_neon = {
+    "neon", array_sum_neon, array_minmax_neon, array_fill_neon,
+    array_copy_neon, array_scale_add_neon, array_find_neon,
+    array_add_neon, array_sub_neon, array_mul_neon,
+};
+
+#endif // ARRAY_KERNELS_NEON
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+// The table for one instruction set, or NULL if this CPU or build lacks it
+static inline const array_kernels_t *array_kernels_for(array_isa_t isa) {
+    switch (isa) {
+    case ARRAY_ISA_SCALAR:
+        return &array_kernels_scalar;
+#ifdef ARRAY_KERNELS_X86
+    case ARRAY_ISA_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2") ? &array_kernels_sse2 : NULL;
+    case ARRAY_ISA_AVX2:
+        // Also false when the OS does not save the 256-bit registers
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? &array_kernels_avx2 : NULL;
+#endif
+#ifdef ARRAY_KERNELS_NEON
+    case ARRAY_ISA_NEON:
+        return &array_kernels_neon; // Part of the baseline wherever __ARM_NEON is set
+#endif
+    default:
+        return NULL;
+    }
+}
+
+// The fastest table this CPU supports. The CPUID check runs once; racing
+// first callers store the same pointer.
+static inline const array_kernels_t *array_kernels(void) {
+    static const array_kernels_t *best = NULL;
+    const array_kernels_t *k = __atomic_load_n(&best, __ATOMIC_ACQUIRE);
+    if (k == NULL) {
+        for (int isa = ARRAY_ISA_COUNT - 1; k == NULL; isa--) {
+            k = array_kernels_for((array_isa_t)isa);
+        }
+        __atomic_store_n(&best, k, __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+// Wrappers that dispatch through array_kernels()
+static inline long long array_sum(const int *a, size_t n) {
+    return array_kernels()->sum(a, n);
+}
+
+static inline void array_minmax(const int *a, size_t n, int *min, int *max) {
+    array_kernels()->minmax(a, n, min, max);
+}
+
+static inline void array_fill(int *dst, int value, size_t n) {
+    array_kernels()->fill(dst, value, n);
+}
+
+static inline void array_copy(int *dst, const int *src, size_t n) {
+    array_kernels()->copy(dst, src, n);
+}
+
+static inline void array_scale_add(int *dst, const int *x, int scale, size_t n) {
+    array_kernels()->scale_add(dst, x, scale, n);
+}
+
+static inline size_t array_find(const int *a, size_t n, int value) {
+    return array_kernels()->find(a, n, value);
+}
+
+static inline void array_add(int *dst, const int *a, const int *b, size_t n) {
+    array_kernels()->add(dst, a, b, n);
+}
+
+static inline void array_sub(int *dst, const int *a, const int *b, size_t n) {
+    array_kernels()->sub(dst, a, b, n);
+}
+
+static inline void array_mul(int *dst, const int *a, const int *b, size_t n) {
+    array_kernels()->mul(dst, a, b, n);
+}
+
+#endif // ARRAY_KERNELS_H
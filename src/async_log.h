@@ -0,0 +1,387 @@
+/**
+ * async_log.h - Non-blocking buffered logging with a background flusher
+ *
+ * Calling printf inside a critical section takes stdio's own lock and may
+ * issue a write(2) while our lock is held. async_log_t moves all I/O off
+ * the hot path:
+ *
+ * 1. Each logging thread gets its own single-producer ring buffer, found
+ *    through a thread-local pointer. Logging formats the line, copies it
+ *    into the ring and publishes it with one release store. There are no
+ *    locks, no shared writes and no syscalls.
+ * 2. A flusher thread wakes every ASYNC_LOG_FLUSH_INTERVAL_NS (or sooner
+ *    when a ring passes half full). It gathers everything pending across
+ *    all rings into one writev(2) call.
+ * 3. A full ring never blocks the caller. The message is dropped, counted,
+ *    and reported in the output at the next flush.
+ *
+ *     async_log_t log;
+ *     async_log_init(&log, STDOUT_FILENO, 0);    // 0: default ring size
+ *     async_log_printf(&log, "thread %d\n", id); // tens of nanoseconds
+ *     async_log_flush(&log);                     // wait until written
+ *     async_log_destroy(&log);                   // final flush, stop
+ *
+ * Lines from one thread come out in order, but lines from different
+ * threads are not ordered relative to each other. Rings stay registered
+ * until async_log_destroy. A new thread that gets the pthread_t of an
+ * exited one takes over its ring. Nothing may log while or after
+ * async_log_destroy runs.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (for the futex and writev declarations).
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "cpu.h"
+#include "futex.h"
+
+// Default bytes of ring buffer per logging thread
+#define ASYNC_LOG_RING_SIZE (64 * 1024)
+
+// Longest line async_log_printf formats; longer lines are truncated, but
+// keep their trailing newline so they do not run into the next message
+#define ASYNC_LOG_MAX_LINE 512
+
+// How long the flusher sleeps when no ring asks for an early flush
+#define ASYNC_LOG_FLUSH_INTERVAL_NS (10 * 1000 * 1000)
+
+// Buffers gathered into one writev(2) call
+#define ASYNC_LOG_MAX_IOV 64
+
+typedef struct async_log_ring {
+    // Written only by the owning thread
+    _Alignas(CACHE_LINE_SIZE) size_t head;   // Bytes ever published
+    size_t cached_tail;                      // Last tail the producer saw
+    uint64_t dropped;                        // Messages that did not fit
+
+    // Written only by the flusher
+    _Alignas(CACHE_LINE_SIZE) size_t tail;   // Bytes ever written out
+
+    // Set once at registration
+    _Alignas(CACHE_LINE_SIZE) char *buf;
+    size_t mask;                             // Ring size - 1 (a power of two)
+    pthread_t owner;
+    struct async_log_ring *next;
+} async_log_ring_t;
+
+typedef struct {
+    int fd;
+    size_t ring_size;
+    uint64_t id;                 // Distinguishes loggers in the thread-local cache
+    async_log_ring_t *rings;     // Every registered ring, oldest first (append-only)
+    pthread_mutex_t register_lock;
+    pthread_t flusher;
+    uint32_t wake;               // Futex word: bumped to wake the flusher early
+    uint32_t flushed;            // Futex word: bumped after every flusher pass
+    bool stop;
+    uint64_t reported_drops;     // Flusher only
+} async_log_t;
+
+// Thread-local cache of this thread's ring for the logger it used last
+static __thread uint64_t async_log_tls_id;
+static __thread async_log_ring_t *async_log_tls_ring;
+
+static uint64_t async_log_next_id = 1;
+
+// ---------------------------------------------------------------------------
+// Flusher
+// ---------------------------------------------------------------------------
+
+// Write every iovec completely, retrying short writes and EINTR. On any
+// other error the rest of the data is dropped: logging must not get stuck.
+static inline void async_log_writev_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+}
+
+// One pass over all rings. Returns the number of bytes written.
+static inline size_t async_log_drain(async_log_t *log) {
+    struct iovec iov[ASYNC_LOG_MAX_IOV];
+    // A ring whose bytes have not wrapped takes one iovec, so a batch
+    // can hold as many rings as iovecs
+    async_log_ring_t *done[ASYNC_LOG_MAX_IOV];
+    size_t done_tail[ASYNC_LOG_MAX_IOV];
+    int count = 0, rings = 0;
+    size_t total = 0;
+    uint64_t dropped = 0;
+    char notice[64];
+
+    async_log_ring_t *r = __atomic_load_n(&log->rings, __ATOMIC_ACQUIRE);
+    while (r != NULL || rings > 0) {
+        if (r != NULL) {
+            size_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+            size_t tail = r->tail;
+            dropped += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+            if (head != tail) {
+                // Up to two pieces: up to the end of the buffer, then from the start
+                size_t size = r->mask + 1;
+                size_t start = tail & r->mask;
+                size_t len = head - tail;
+                size_t first = len < size - start ? len : size - start;
+                iov[count].iov_base = r->buf + start;
+                iov[count++].iov_len = first;
+                if (len > first) {
+                    iov[count].iov_base = r->buf;
+                    iov[count++].iov_len = len - first;
+                }
+                done[rings] = r;
+                done_tail[rings++] = head;
+                total += len;
+            }
+            r = __atomic_load_n(&r->next, __ATOMIC_ACQUIRE);
+        }
+
+        // Write out a full batch, or whatever is left at the end of the list
+        if (rings > 0 && (r == NULL || count + 2 > ASYNC_LOG_MAX_IOV)) {
+            async_log_writev_all(log->fd, iov, count);
+            for (int i = 0; i < rings; i++) {
+                __atomic_store_n(&done[i]->tail, done_tail[i], __ATOMIC_RELEASE);
+            }
+            count = 0;
+            rings = 0;
+        }
+    }
+
+    if (dropped > log->reported_drops) {
+        int n = snprintf(notice, sizeof(notice), "[async_log: %llu messages dropped]\n",
+                         (unsigned long long)(dropped - log->reported_drops));
+        log->reported_drops = dropped;
+        if (n > 0 && write(log->fd, notice, (size_t)n) < 0) {
+            // Nothing sensible to do if even the notice cannot be written
+        }
+    }
+    return total;
+}
+
+static inline void *async_log_flusher_main(void *arg) {
+    async_log_t *log = (async_log_t *)arg;
+    for (;;) {
+        uint32_t seen = __atomic_load_n(&log->wake, __ATOMIC_ACQUIRE);
+        bool stop = __atomic_load_n(&log->stop, __ATOMIC_ACQUIRE);
+        size_t written = async_log_drain(log);
+
+        __atomic_add_fetch(&log->flushed, 1, __ATOMIC_RELEASE);
+        futex_wake(&log->flushed, INT_MAX);
+
+        if (stop && written == 0) {
+            return NULL; // Stop requested and every ring is empty
+        }
+        if (written == 0) {
+            futex_wait_timeout(&log->wake, seen, ASYNC_LOG_FLUSH_INTERVAL_NS);
+        }
+    }
+}
+
+static inline void async_log_wake_flusher(async_log_t *log) {
+    __atomic_add_fetch(&log->wake, 1, __ATOMIC_RELEASE);
+    futex_wake(&log->wake, 1);
+}
+
+// ---------------------------------------------------------------------------
+// Setup
+// ---------------------------------------------------------------------------
+
+// Start a logger writing to fd with `ring_size` bytes per thread (rounded
+// up to a power of two; 0 means ASYNC_LOG_RING_SIZE). Returns 0 on
+// success, -1 if the flusher thread could not be started.
+static inline int async_log_init(async_log_t *log, int fd, size_t ring_size) {
+    size_t size = 4096;
+    size_t want = ring_size > 0 ? ring_size : ASYNC_LOG_RING_SIZE;
+    while (size < want) {
+        size <<= 1;
+    }
+
+    log->fd = fd;
+    log->ring_size = size;
+    log->id = __atomic_fetch_add(&async_log_next_id, 1, __ATOMIC_RELAXED);
+    log->rings = NULL;
+    log->wake = 0;
+    log->flushed = 0;
+    log->stop = false;
+    log->reported_drops = 0;
+    if (pthread_mutex_init(&log->register_lock, NULL) != 0) {
+        return -1;
+    }
+    if (pthread_create(&log->flusher, NULL, async_log_flusher_main, log) != 0) {
+        pthread_mutex_destroy(&log->register_lock);
+        return -1;
+    }
+    return 0;
+}
+
+// Slow path: find or create the calling thread's ring. Registration is
+// rare (once per thread per logger), so it may take a mutex.
+static inline async_log_ring_t *async_log_register(async_log_t *log) {
+    pthread_t self = pthread_self();
+    async_log_ring_t *r, *last = NULL;
+
+    pthread_mutex_lock(&log->register_lock);
+    for (r = log->rings; r != NULL; r = r->next) {
+        if (pthread_equal(r->owner, self)) {
+            break;
+        }
+        last = r;
+    }
+    if (r == NULL) {
+        r = (async_log_ring_t *)aligned_alloc(CACHE_LINE_SIZE, sizeof(async_log_ring_t));
+        char *buf = (char *)malloc(log->ring_size);
+        if (r == NULL || buf == NULL) {
+            free(r);
+            free(buf);
+            pthread_mutex_unlock(&log->register_lock);
+            return NULL;
+        }
+        memset(r, 0, sizeof(*r));
+        r->buf = buf;
+        r->mask = log->ring_size - 1;
+        r->owner = self;
+        // Append, so each pass drains rings in registration order. A line
+        // logged under a lock then usually comes out before the next
+        // holder's line. The flusher walks the list without the mutex.
+        __atomic_store_n(last != NULL ? &last->next : &log->rings, r, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&log->register_lock);
+
+    async_log_tls_id = log->id;
+    async_log_tls_ring = r;
+    return r;
+}
+
+static inline async_log_ring_t *async_log_thread_ring(async_log_t *log) {
+    if (async_log_tls_id == log->id) {
+        return async_log_tls_ring;
+    }
+    return async_log_register(log);
+}
+
+// ---------------------------------------------------------------------------
+// Logging
+// ---------------------------------------------------------------------------
+
+// Queue `len` bytes as they are (include the '\n'). Never blocks: returns
+// false if the message was dropped because this thread's ring is full.
+static inline bool async_log_write(async_log_t *log, const char *msg, size_t len) {
+    async_log_ring_t *r = async_log_thread_ring(log);
+    if (r == NULL) {
+        return false;
+    }
+    size_t size = r->mask + 1;
+    size_t head = r->head;
+
+    if (len > size - (head - r->cached_tail)) {
+        r->cached_tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (len > size - (head - r->cached_tail)) {
+            __atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+            async_log_wake_flusher(log);
+            return false;
+        }
+    }
+
+    size_t start = head & r->mask;
+    size_t first = len < size - start ? len : size - start;
+    memcpy(r->buf + start, msg, first);
+    memcpy(r->buf, msg + first, len - first);
+    __atomic_store_n(&r->head, head + len, __ATOMIC_RELEASE);
+
+    // Ask for an early flush once per crossing of the half-full mark
+    size_t used_before = head - r->cached_tail;
+    if (used_before <= size / 2 && used_before + len > size / 2) {
+        async_log_wake_flusher(log);
+    }
+    return true;
+}
+
+// printf into this thread's ring. Returns false if the line was dropped.
+__attribute__((format(printf, 2, 3)))
+static inline bool async_log_printf(async_log_t *log, const char *fmt, ...) {
+    char line[ASYNC_LOG_MAX_LINE];
+    va_list ap, again;
+    va_start(ap, fmt);
+    va_copy(again, ap);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        va_end(again);
+        return false;
+    }
+    size_t len = (size_t)n;
+    if (len >= sizeof(line)) {
+        // Truncated: find out whether the full line ended with a newline
+        // (only this slow path formats it twice)
+        len = sizeof(line) - 1;
+        char *full = (char *)malloc((size_t)n + 1);
+        bool newline = full != NULL ? vsnprintf(full, (size_t)n + 1, fmt, again) == n && full[n - 1] == '\n'
+                                    : fmt[0] != '\0' && fmt[strlen(fmt) - 1] == '\n';
+        free(full);
+        if (newline) {
+            line[len - 1] = '\n';
+        }
+    }
+    va_end(again);
+    return async_log_write(log, line, len);
+}
+
+// Block until everything logged before this call has been written
+static inline void async_log_flush(async_log_t *log) {
+    // Two completed passes guarantee one pass started after this call
+    uint32_t start = __atomic_load_n(&log->flushed, __ATOMIC_ACQUIRE);
+    async_log_wake_flusher(log);
+    for (;;) {
+        uint32_t now = __atomic_load_n(&log->flushed, __ATOMIC_ACQUIRE);
+        if (now - start >= 2) {
+            return;
+        }
+        async_log_wake_flusher(log);
+        futex_wait_timeout(&log->flushed, now, ASYNC_LOG_FLUSH_INTERVAL_NS);
+    }
+}
+
+// Write everything still queued, stop the flusher and free all rings
+static inline void async_log_destroy(async_log_t *log) {
+    __atomic_store_n(&log->stop, true, __ATOMIC_RELEASE);
+    async_log_wake_flusher(log);
+    pthread_join(log->flusher, NULL);
+
+    async_log_ring_t *r = log->rings;
+    while (r != NULL) {
+        async_log_ring_t *next = r->next;
+        free(r->buf);
+        free(r);
+        r = next;
+    }
+    log->rings = NULL;
+    pthread_mutex_destroy(&log->register_lock);
+}
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,269 @@
+/**
+ * barrier.h - Phase barriers and a countdown latch that spin, then sleep
+ *
+ * An iterative parallel job (one step of a simulation, one pass over a
+ * matrix) has to stop every thread at the end of a phase until all of them
+ * are done. pthread_join only works once per thread, and polling a counter
+ * with usleep adds up to a whole sleep interval to every phase. This
+ * header provides:
+ *
+ * 1. barrier_t              - centralized sense-reversing barrier: one
+ *                             shared counter, and a phase number whose
+ *                             change releases everybody. Cheapest up to a
+ *                             few dozen threads.
+ * 2. dissemination_barrier_t - log2(n) rounds in which thread i signals
+ *                             thread i + 2^r and waits for thread i - 2^r.
+ *                             Nothing is shared by all threads, so it
+ *                             scales to high core counts.
+ * 3. latch_t                - one-shot countdown: count_down() from any
+ *                             thread, wait() until the count reaches zero.
+ *
+ *     barrier_t b;
+ *     barrier_init(&b, threads);
+ *     for (int phase = 0; phase < phases; phase++) {
+ *         compute(phase);
+ *         if (barrier_wait(&b)) {  // true for exactly one thread per phase
+ *             swap_buffers();
+ *         }
+ *         barrier_wait(&b);
+ *     }
+ *
+ *     dissemination_barrier_wait(&db, id);   // id: 0 .. threads - 1
+ *
+ *     latch_t ready;
+ *     latch_init(&ready, workers);
+ *     latch_count_down(&ready, 1);            // in each worker
+ *     latch_wait(&ready);                     // in main
+ *
+ * A waiting thread polls for BARRIER_SPIN_LIMIT rounds, which covers the
+ * common case of threads arriving close together, and then sleeps on a
+ * futex until the phase changes. When there are more threads than online
+ * CPUs the thread being waited for may not be running at all, so waiters
+ * then skip the polling and sleep straight away. The thread that completes
+ * a phase only makes the wake syscall when somebody is asleep. Writes made before a
+ * wait are visible to every thread after it returns.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see futex.h).
+ */
+
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "futex.h"
+
+// Polls before a waiter sleeps on the futex
+#define BARRIER_SPIN_LIMIT 1024
+
+// Rounds of the dissemination barrier: enough for 65536 threads
+#define BARRIER_MAX_ROUNDS 16
+
+// Polls a waiter should make among `threads` participants: none if they
+// cannot all be running at once
+static inline uint32_t barrier_spin_limit(uint32_t threads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 && threads > (unsigned long)cpus ? 0 : BARRIER_SPIN_LIMIT;
+}
+
+// One step of a wait loop whose condition on *word just failed with the
+// value `seen`: pause while under `limit` polls, otherwise sleep until
+// *word changes. The waiter counts itself in *sleepers (seq_cst) before
+// sleeping, and futex_wait re-checks the word, so a waker that changes the
+// word and then finds *sleepers at zero cannot miss anyone.
+static inline void barrier_wait_step(uint32_t *word, uint32_t seen, uint32_t *sleepers, uint32_t limit,
+                                     uint32_t *spins) {
+    if (*spins < limit) {
+        ++*spins;
+        cpu_relax();
+        return;
+    }
+    __atomic_fetch_add(sleepers, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(word, __ATOMIC_SEQ_CST) == seen) {
+        futex_wait(word, seen);
+    }
+    __atomic_fetch_sub(sleepers, 1, __ATOMIC_RELAXED);
+}
+
+// Wake everyone sleeping on *word. Call after a seq_cst update of *word.
+static inline void barrier_wake(uint32_t *word, uint32_t *sleepers, int count) {
+    if (__atomic_load_n(sleepers, __ATOMIC_SEQ_CST) != 0) {
+        futex_wake(word, count);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Centralized sense-reversing barrier
+// ---------------------------------------------------------------------------
+
+// The classic version flips a shared sense flag each phase and gives every
+// thread a private copy to compare with. Here the flag is the low bit of a
+// phase counter: a thread notes the phase on arrival and waits for it to
+// move on, so no per-thread state is needed and a fast thread that has
+// already entered the next phase cannot confuse a slow one.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) uint32_t remaining;  // Threads yet to arrive this phase
+    uint32_t count;
+    uint32_t spin_limit;
+    _Alignas(CACHE_LINE_SIZE) uint32_t phase;      // Futex word: bumped as each phase ends
+    uint32_t sleepers;
+} barrier_t;
+
+// Returns 0 on success, -1 if count is 0
+static inline int barrier_init(barrier_t *b, uint32_t count) {
+    if (count == 0) {
+        return -1;
+    }
+    b->remaining = count;
+    b->count = count;
+    b->spin_limit = barrier_spin_limit(count);
+    b->phase = 0;
+    b->sleepers = 0;
+    return 0;
+}
+
+// Wait until all `count` threads have called barrier_wait for this phase.
+// Returns true in exactly one of them (the last to arrive), like
+// PTHREAD_BARRIER_SERIAL_THREAD.
+static inline bool barrier_wait(barrier_t *b) {
+    // The phase cannot move on before this thread has arrived
+    uint32_t phase = __atomic_load_n(&b->phase, __ATOMIC_ACQUIRE);
+    if (__atomic_sub_fetch(&b->remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+        // Last one in: reset for the next phase, then release the others.
+        // Nobody touches `remaining` again until they see the new phase.
+        __atomic_store_n(&b->remaining, b->count, __ATOMIC_RELAXED);
+        __atomic_store_n(&b->phase, phase + 1, __ATOMIC_SEQ_CST);
+        barrier_wake(&b->phase, &b->sleepers, INT_MAX);
+        return true;
+    }
+
+    uint32_t spins = 0;
+    uint32_t seen;
+    while ((seen = __atomic_load_n(&b->phase, __ATOMIC_ACQUIRE)) == phase) {
+        barrier_wait_step(&b->phase, seen, &b->sleepers, b->spin_limit, &spins);
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Dissemination barrier
+// ---------------------------------------------------------------------------
+
+// Per-thread state. flags[r] counts the signals received in round r, so
+// the barrier is reusable without resetting anything: in its k-th episode
+// a thread waits for flags[r] to reach k.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) uint32_t flags[BARRIER_MAX_ROUNDS];
+    _Alignas(CACHE_LINE_SIZE) uint32_t sleepers;  // 1 while the owner sleeps on a flag
+    uint32_t episode;                             // Written only by the owner
+} dissemination_slot_t;
+
+typedef struct {
+    dissemination_slot_t *slots;
+    uint32_t threads;
+    uint32_t rounds;   // ceil(log2(threads))
+    uint32_t spin_limit;
+} dissemination_barrier_t;
+
+// Returns 0 on success, -1 if threads is 0, too large, or out of memory
+static inline int dissemination_barrier_init(dissemination_barrier_t *b, uint32_t threads) {
+    b->slots = NULL;
+    b->threads = threads;
+    b->rounds = 0;
+    b->spin_limit = barrier_spin_limit(threads);
+    while (b->rounds < BARRIER_MAX_ROUNDS && (1u << b->rounds) < threads) {
+        b->rounds++;
+    }
+    if (threads == 0 || (1u << b->rounds) < threads) {
+        return -1;
+    }
+    b->slots = (dissemination_slot_t *)aligned_alloc(CACHE_LINE_SIZE, threads * sizeof(dissemination_slot_t));
+    if (b->slots == NULL) {
+        return -1;
+    }
+    memset(b->slots, 0, threads * sizeof(dissemination_slot_t));
+    return 0;
+}
+
+static inline void dissemination_barrier_destroy(dissemination_barrier_t *b) {
+    free(b->slots);
+    b->slots = NULL;
+}
+
+// Wait until all threads have arrived. `id` is this thread's index in
+// [0, threads); every thread must use its own. After round r a thread
+// knows that the 2^(r+1) threads before it have arrived, so after the
+// last round it knows all of them have.
+static inline void dissemination_barrier_wait(dissemination_barrier_t *b, uint32_t id) {
+    dissemination_slot_t *self = &b->slots[id];
+    uint32_t target = ++self->episode;
+
+    for (uint32_t r = 0; r < b->rounds; r++) {
+        dissemination_slot_t *partner = &b->slots[(id + (1u << r)) % b->threads];
+        __atomic_fetch_add(&partner->flags[r], 1, __ATOMIC_SEQ_CST);
+        barrier_wake(&partner->flags[r], &partner->sleepers, 1);
+
+        // A partner may already be one episode ahead, so compare by
+        // distance rather than equality (this also survives wrap-around)
+        uint32_t spins = 0;
+        uint32_t seen;
+        while ((int32_t)((seen = __atomic_load_n(&self->flags[r], __ATOMIC_ACQUIRE)) - target) < 0) {
+            barrier_wait_step(&self->flags[r], seen, &self->sleepers, b->spin_limit, &spins);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Countdown latch
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) uint32_t count;  // Futex word
+    uint32_t sleepers;
+    uint32_t spin_limit;
+} latch_t;
+
+// Usually count is the number of threads taking part, which also decides
+// whether waiters spin
+static inline void latch_init(latch_t *l, uint32_t count) {
+    l->count = count;
+    l->sleepers = 0;
+    l->spin_limit = barrier_spin_limit(count);
+}
+
+// Subtract n (at most the current count). Writes made before the call are
+// visible to the waiters once the count reaches zero.
+static inline void latch_count_down(latch_t *l, uint32_t n) {
+    if (__atomic_sub_fetch(&l->count, n, __ATOMIC_SEQ_CST) == 0) {
+        barrier_wake(&l->count, &l->sleepers, INT_MAX);
+    }
+}
+
+// True once the count has reached zero
+static inline bool latch_try_wait(latch_t *l) {
+    return __atomic_load_n(&l->count, __ATOMIC_ACQUIRE) == 0;
+}
+
+// Wait for the count to reach zero
+static inline void latch_wait(latch_t *l) {
+    uint32_t spins = 0;
+    uint32_t seen;
+    while ((seen = __atomic_load_n(&l->count, __ATOMIC_ACQUIRE)) != 0) {
+        barrier_wait_step(&l->count, seen, &l->sleepers, l->spin_limit, &spins);
+    }
+}
+
+// Count down by one, then wait for the others
+static inline void latch_arrive_and_wait(latch_t *l) {
+    latch_count_down(l, 1);
+    latch_wait(l);
+}
+
+#endif // BARRIER_H
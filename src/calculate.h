@@ -0,0 +1,40 @@
+/**
+ * calculate.h - The calculator operations as inline functions
+ *
+ * calculate(operation, a, b) in pointer_examples.c always goes through a
+ * function pointer. That is the right tool when the operation is only
+ * known at run time. When the call site names the operation,
+ * `calculate(add, 10, 5)`, the pointer just hides a single instruction
+ * from the compiler. This header generates one static inline function per
+ * operation from a single list:
+ *
+ *     CALCULATE(add, 10, 5)          // calculate_add(10, 5): inlines to one add
+ *     calculate_divide(x, y)         // the same functions, called by name
+ *     calculate(op_ptr, 10, 5)       // runtime pointer path, unchanged
+ *
+ * pointer_examples.c defines add(), subtract() and the rest on top of
+ * these, so both paths share one definition of every operation.
+ */
+
+#ifndef CALCULATE_H
+#define CALCULATE_H
+
+// X-macro list of the operations: X(name, expression over a and b)
+#define CALCULATE_OPERATIONS(X) \
+    X(add, a + b) \
+    X(subtract, a - b) \
+    X(multiply, a * b) \
+    X(divide, b != 0 ? a / b : 0)
+
+#define CALCULATE_DEFINE_INLINE(name, expr) \
+    static inline int calculate_##name(int a, int b) { return expr; }
+
+CALCULATE_OPERATIONS(CALCULATE_DEFINE_INLINE)
+
+#undef CALCULATE_DEFINE_INLINE
+
+// Compile-time dispatch: `op` must be one of the names in the list above.
+// A misspelt name is a compile error rather than a wrong call.
+#define CALCULATE(op, a, b) calculate_##op((a), (b))
+
+#endif // CALCULATE_H
@@ -0,0 +1,151 @@
+/**
+ * cohort_lock.h - NUMA-aware cohort lock built from ticket locks
+ *
+ * Handing a flat lock from a thread on one socket to a thread on another
+ * moves the lock's cache line, and the data it protects, across the
+ * interconnect. A cohort lock groups the waiters by NUMA node:
+ *
+ * 1. Each node has its own local ticket lock; a thread first takes the
+ *    local lock of the node it is running on.
+ * 2. The first thread of a cohort then takes the global ticket lock.
+ * 3. On release, if another thread on the same node is waiting, the holder
+ *    passes the global lock along with the local one. Only the local
+ *    lock's line moves, and it stays within the node.
+ * 4. After COHORT_LOCK_MAX_HANDOFFS consecutive local handoffs the global
+ *    lock is released anyway, so other nodes cannot starve.
+ *
+ * The API matches the locks in simple_lock.h:
+ *     cohort_lock_t lock;
+ *     cohort_lock_init(&lock);
+ *     cohort_lock_acquire(&lock);
+ *     ... critical section ...
+ *     cohort_lock_release(&lock);
+ *
+ * The global lock must be releasable by a different thread than the one
+ * that acquired it, which a ticket lock is. A thread's node is looked up
+ * from sched_getcpu() on every acquire, so migration is harmless. It only
+ * costs locality and never correctness, because release uses whichever
+ * node the holder acquired on. On a machine with one node it behaves like a
+ * ticket lock with one extra uncontended acquire.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see simple_lock.h and affinity.h).
+ */
+
+#ifndef COHORT_LOCK_H
+#define COHORT_LOCK_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "simple_lock.h"
+#include "affinity.h"
+
+// Nodes with their own local lock; higher node numbers share one
+#define COHORT_LOCK_MAX_NODES 8
+
+// Local handoffs before the global lock has to be given up. Larger values
+// keep the lock on one node longer (better throughput, worse fairness).
+#define COHORT_LOCK_MAX_HANDOFFS 64
+
+// CPUs covered by the CPU-to-node table
+#define COHORT_LOCK_MAX_CPUS 1024
+
+typedef struct {
+    ticket_lock_t lock;
+    // Only touched by the holder of `lock`
+    bool global_passed;     // The global lock came with the local one
+    unsigned int handoffs;  // Consecutive local handoffs so far
+} cohort_node_t;
+
+typedef struct {
+    ticket_lock_t global;
+    cohort_node_t nodes[COHORT_LOCK_MAX_NODES];
+    int num_nodes;
+    int holder_node;        // Node the current holder acquired on
+} cohort_lock_t;
+
+// CPU -> node, filled in once per process from sysfs
+static unsigned char cohort_cpu_node[COHORT_LOCK_MAX_CPUS];
+static int cohort_num_nodes = 1;
+static pthread_once_t cohort_topology_once = PTHREAD_ONCE_INIT;
+
+static inline void cohort_load_topology(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    int max_node = 0;
+    for (int cpu = 0; cpu < cpus && cpu < COHORT_LOCK_MAX_CPUS; cpu++) {
+        int node = affinity_cpu_node(cpu);
+        if (node < 0) {
+            node = 0;
+        }
+        cohort_cpu_node[cpu] = (unsigned char)(node % COHORT_LOCK_MAX_NODES);
+        if (node > max_node) {
+            max_node = node;
+        }
+    }
+    cohort_num_nodes = max_node + 1 < COHORT_LOCK_MAX_NODES ? max_node + 1 : COHORT_LOCK_MAX_NODES;
+}
+
+// Node of the CPU the calling thread is on right now
+static inline int cohort_current_node(const cohort_lock_t *lock) {
+    int cpu = sched_getcpu();
+    if (lock->num_nodes == 1 || cpu < 0 || cpu >= COHORT_LOCK_MAX_CPUS) {
+        return 0;
+    }
+    return cohort_cpu_node[cpu];
+}
+
+// Initialize the lock
+static inline void cohort_lock_init(cohort_lock_t *lock) {
+    pthread_once(&cohort_topology_once, cohort_load_topology);
+    ticket_lock_init(&lock->global);
+    for (int i = 0; i < COHORT_LOCK_MAX_NODES; i++) {
+        ticket_lock_init(&lock->nodes[i].lock);
+        lock->nodes[i].global_passed = false;
+        lock->nodes[i].handoffs = 0;
+    }
+    lock->num_nodes = cohort_num_nodes;
+    lock->holder_node = 0;
+}
+
+// Take the local lock of our node, then the global lock unless the
+// previous local holder passed it to us
+static inline void cohort_lock_acquire(cohort_lock_t *lock) {
+    int node = cohort_current_node(lock);
+    cohort_node_t *local = &lock->nodes[node];
+
+    ticket_lock_acquire(&local->lock);
+    if (local->global_passed) {
+        local->global_passed = false;
+    } else {
+        ticket_lock_acquire(&lock->global);
+        local->handoffs = 0;
+    }
+    lock->holder_node = node;
+}
+
+// True when another thread holds a ticket for this local lock. Called by
+// the holder, so now_serving cannot change underneath it.
+static inline bool cohort_node_has_waiters(cohort_node_t *local) {
+    unsigned int next = __atomic_load_n(&local->lock.next_ticket, __ATOMIC_RELAXED);
+    return next - local->lock.now_serving > 1;
+}
+
+// Pass the lock within our node if someone there is waiting and the handoff
+// budget allows it; otherwise release the global lock too
+static inline void cohort_lock_release(cohort_lock_t *lock) {
+    cohort_node_t *local = &lock->nodes[lock->holder_node];
+
+    if (local->handoffs < COHORT_LOCK_MAX_HANDOFFS && cohort_node_has_waiters(local)) {
+        local->handoffs++;
+        local->global_passed = true;
+    } else {
+        ticket_lock_release(&lock->global);
+    }
+    ticket_lock_release(&local->lock);
+}
+
+#endif // COHORT_LOCK_H
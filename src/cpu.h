@@ -0,0 +1,46 @@
+/**
+ * cpu.h - Small CPU helpers shared by the synchronization examples
+ *
+ * This header provides:
+ * 1. CACHE_LINE_SIZE, used to keep independently written data apart
+ * 2. cpu_relax(), the "pause" hint used inside spin-wait loops
+ * 3. spin_wait(), a spin step that yields the CPU once a wait runs long
+ */
+
+#ifndef CPU_H
+#define CPU_H
+
+#include <sched.h> // For sched_yield
+
+// Size of a cache line on the x86-64 and ARM64 machines we target
+#define CACHE_LINE_SIZE 64
+
+// Tell the CPU we are busy-waiting. On x86 this is the PAUSE instruction,
+// which saves power and avoids a memory-order mis-speculation penalty when
+// the spin finally ends. On ARM the equivalent hint is YIELD.
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// Pause iterations before a waiter gives its time slice away. Spinning only
+// pays off while the lock holder is running; when there are more threads
+// than cores the holder may be preempted, and yielding lets it finish.
+#define SPIN_YIELD_THRESHOLD 1024
+
+// One iteration of a spin-wait loop. `spins` is the caller's loop counter.
+static inline void spin_wait(unsigned int *spins) {
+    if (++*spins < SPIN_YIELD_THRESHOLD) {
+        cpu_relax();
+    } else {
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+#endif // CPU_H
@@ -0,0 +1,273 @@
+/**
+ * expr_vm.h - Register bytecode interpreter for chains of int arithmetic
+ *
+ * The operations[] table in function_pointer_examples applies one
+ * operation per indirect call. This header runs whole formulas instead.
+ * A formula is a short program over EXPR_VM_REGS int registers:
+ *
+ *     expr_program_t p;
+ *     expr_program_init(&p);
+ *     expr_emit_imm(&p, 2, 3);                  // r2 = 3
+ *     expr_emit(&p, EXPR_OP_ADD, 2, 0, 2);      // r2 = r0 + r2
+ *     expr_emit(&p, EXPR_OP_MUL, 2, 2, 1);      // r2 = r2 * r1
+ *     expr_emit_halt(&p, 2);                    // result is r2
+ *
+ *     int regs[EXPR_VM_REGS] = {x, y};          // inputs in r0, r1
+ *     int result = expr_vm_run(&p, regs);       // (x + 3) * y
+ *
+ * This header provides:
+ * 1. A compact encoding: one 32-bit word per instruction (opcode, dst,
+ *    a, b), plus one extra word for the IMM constant
+ * 2. expr_vm_run_threaded() - computed-goto dispatch (GCC/Clang). Each
+ *    handler jumps straight to the next one, so the CPU predicts every
+ *    dispatch site separately.
+ * 3. expr_vm_run_switch() - the portable switch loop, always available
+ * 4. expr_program_fold() - constant folding, so work on constants is done
+ *    once at build time instead of on every run
+ *
+ * All arithmetic wraps on overflow, and division by zero gives 0 like
+ * divide() in pointer_examples.c. Programs must end with expr_emit_halt().
+ */
+
+#ifndef EXPR_VM_H
+#define EXPR_VM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Computed goto is a GNU extension; define EXPR_VM_NO_COMPUTED_GOTO to
+// force the switch loop
+#if defined(__GNUC__) && !defined(EXPR_VM_NO_COMPUTED_GOTO)
+#define EXPR_VM_COMPUTED_GOTO 1
+#endif
+
+#define EXPR_VM_REGS 16
+
+typedef enum {
+    EXPR_OP_ADD,   // dst = a + b   (the first four match operations[])
+    EXPR_OP_SUB,   // dst = a - b
+    EXPR_OP_MUL,   // dst = a * b
+    EXPR_OP_DIV,   // dst = b != 0 ? a / b : 0
+    EXPR_OP_MOV,   // dst = a
+    EXPR_OP_IMM,   // dst = the next code word
+    EXPR_OP_HALT,  // return a
+    EXPR_OP_COUNT
+} expr_opcode_t;
+
+typedef struct {
+    uint32_t *code;
+    size_t len;    // Words in use
+    size_t cap;    // Words allocated
+} expr_program_t;
+
+// Instruction word: opcode in the low byte, then dst, a and b
+#define EXPR_ENCODE(op, dst, a, b) \
+    ((uint32_t)(op) | (uint32_t)(dst) << 8 | (uint32_t)(a) << 16 | (uint32_t)(b) << 24)
+#define EXPR_OPCODE(w) ((w) & 0xff)
+#define EXPR_DST(w) (((w) >> 8) & 0xff)
+#define EXPR_A(w) (((w) >> 16) & 0xff)
+#define EXPR_B(w) ((w) >> 24)
+
+// The arithmetic shared by the interpreters and the folder. INT_MIN / -1
+// wraps to INT_MIN instead of trapping.
+static inline int expr_apply(expr_opcode_t op, int a, int b) {
+    switch (op) {
+    case EXPR_OP_ADD: return (int)((unsigned)a + (unsigned)b);
+    case EXPR_OP_SUB: return (int)((unsigned)a - (unsigned)b);
+    case EXPR_OP_MUL: return (int)((unsigned)a * (unsigned)b);
+    case EXPR_OP_DIV: return b == 0 ? 0 : b == -1 ? (int)(0u - (unsigned)a) : a / b;
+    default: return 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Building programs
+// ---------------------------------------------------------------------------
+
+static inline void expr_program_init(expr_program_t *p) {
+    p->code = NULL;
+    p->len = 0;
+    p->cap = 0;
+}
+
+static inline void expr_program_free(expr_program_t *p) {
+    free(p->code);
+    expr_program_init(p);
+}
+
+// Drop all instructions but keep the buffer
+static inline void expr_program_clear(expr_program_t *p) {
+    p->len = 0;
+}
+
+static inline int expr_program_push(expr_program_t *p, uint32_t word) {
+    if (p->len == p->cap) {
+        size_t cap = p->cap > 0 ? p->cap * 2 : 16;
+        uint32_t *code = (uint32_t *)realloc(p->code, cap * sizeof(uint32_t));
+        if (code == NULL) {
+            return -1;
+        }
+        p->code = code;
+        p->cap = cap;
+    }
+    p->code[p->len++] = word;
+    return 0;
+}
+
+// Append dst = a <op> b (or dst = a for EXPR_OP_MOV). Returns -1 on a bad
+// opcode or register, or when out of memory.
+static inline int expr_emit(expr_program_t *p, expr_opcode_t op, int dst, int a, int b) {
+    if (op > EXPR_OP_MOV || dst < 0 || dst >= EXPR_VM_REGS ||
+        a < 0 || a >= EXPR_VM_REGS || b < 0 || b >= EXPR_VM_REGS) {
+        return -1;
+    }
+    return expr_program_push(p, EXPR_ENCODE(op, dst, a, b));
+}
+
+// Append dst = value
+static inline int expr_emit_imm(expr_program_t *p, int dst, int value) {
+    if (dst < 0 || dst >= EXPR_VM_REGS) {
+        return -1;
+    }
+    if (expr_program_push(p, EXPR_ENCODE(EXPR_OP_IMM, dst, 0, 0)) != 0) {
+        return -1;
+    }
+    return expr_program_push(p, (uint32_t)value);
+}
+
+// Append the final instruction: the program returns register src
+static inline int expr_emit_halt(expr_program_t *p, int src) {
+    if (src < 0 || src >= EXPR_VM_REGS) {
+        return -1;
+    }
+    return expr_program_push(p, EXPR_ENCODE(EXPR_OP_HALT, 0, src, 0));
+}
+
+// ---------------------------------------------------------------------------
+// Interpreters. regs holds EXPR_VM_REGS ints: the inputs on entry and
+// whatever the program left there on return.
+// ---------------------------------------------------------------------------
+
+static inline int expr_vm_run_switch(const expr_program_t *p, int *regs) {
+    const uint32_t *pc = p->code;
+    for (;;) {
+        uint32_t w = *pc++;
+        switch (EXPR_OPCODE(w)) {
+        case EXPR_OP_ADD: regs[EXPR_DST(w)] = expr_apply(EXPR_OP_ADD, regs[EXPR_A(w)], regs[EXPR_B(w)]); break;
+        case EXPR_OP_SUB: regs[EXPR_DST(w)] = expr_apply(EXPR_OP_SUB, regs[EXPR_A(w)], regs[EXPR_B(w)]); break;
+        case EXPR_OP_MUL: regs[EXPR_DST(w)] = expr_apply(EXPR_OP_MUL, regs[EXPR_A(w)], regs[EXPR_B(w)]); break;
+        case EXPR_OP_DIV: regs[EXPR_DST(w)] = expr_apply(EXPR_OP_DIV, regs[EXPR_A(w)], regs[EXPR_B(w)]); break;
+        case EXPR_OP_MOV: regs[EXPR_DST(w)] = regs[EXPR_A(w)]; break;
+        case EXPR_OP_IMM: regs[EXPR_DST(w)] = (int)*pc++; break;
+        default: return regs[EXPR_A(w)]; // EXPR_OP_HALT
+        }
+    }
+}
+
+#ifdef EXPR_VM_COMPUTED_GOTO
+
+// Every handler ends in its own indirect jump instead of looping back to
+// one shared switch jump
+#define EXPR_VM_DISPATCH() do { w = *pc++; goto *labels[EXPR_OPCODE(w)]; } while (0)
+
+static inline int expr_vm_run_threaded(const expr_program_t *p, int *regs) {
+    static const void *const labels[EXPR_OP_COUNT] = {
+        &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_mov, &&op_imm, &&op_halt,
+    };
+    const uint32_t *pc = p->code;
+    uint32_t w;
+
+    EXPR_VM_DISPATCH();
+op_add:
+    regs[EXPR_DST(w)] = expr_apply(EXPR_OP_ADD, regs[EXPR_A(w)], regs[EXPR_B(w)]);
+    EXPR_VM_DISPATCH();
+op_sub:
+    regs[EXPR_DST(w)] = expr_apply(EXPR_OP_SUB, regs[EXPR_A(w)], regs[EXPR_B(w)]);
+    EXPR_VM_DISPATCH();
+op_mul:
+    regs[EXPR_DST(w)] = expr_apply(EXPR_OP_MUL, regs[EXPR_A(w)], regs[EXPR_B(w)]);
+    EXPR_VM_DISPATCH();
+op_div:
+    regs[EXPR_DST(w)] = expr_apply(EXPR_OP_DIV, regs[EXPR_A(w)], regs[EXPR_B(w)]);
+    EXPR_VM_DISPATCH();
+op_mov:
+    regs[EXPR_DST(w)] = regs[EXPR_A(w)];
+    EXPR_VM_DISPATCH();
+op_imm:
+    regs[EXPR_DST(w)] = (int)*pc++;
+    EXPR_VM_DISPATCH();
+op_halt:
+    return regs[EXPR_A(w)];
+}
+
+#undef EXPR_VM_DISPATCH
+
+#endif // EXPR_VM_COMPUTED_GOTO
+
+// The fastest interpreter this compiler supports
+static inline int expr_vm_run(const expr_program_t *p, int *regs) {
+#ifdef EXPR_VM_COMPUTED_GOTO
+    return expr_vm_run_threaded(p, regs);
+#else
+    return expr_vm_run_switch(p, regs);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Constant folding
+// ---------------------------------------------------------------------------
+
+// Write a folded copy of `in` to `out` (which must be initialized; its old
+// contents are replaced). Registers holding known constants are tracked
+// through the program. Operations on them are computed here, and an IMM is
+// only emitted when an instruction that still runs needs the value. The
+// folded program returns the same result, but registers that no remaining
+// instruction reads may end up with different values. Returns -1 on OOM.
+static inline int expr_program_fold(expr_program_t *out, const expr_program_t *in) {
+    bool known[EXPR_VM_REGS] = {false};     // Value is a compile-time constant
+    bool emitted[EXPR_VM_REGS] = {false};   // ...and already loaded by an IMM
+    int value[EXPR_VM_REGS] = {0};
+    int rc = 0;
+
+    expr_program_clear(out);
+    for (size_t i = 0; i < in->len && rc == 0; i++) {
+        uint32_t w = in->code[i];
+        expr_opcode_t op = (expr_opcode_t)EXPR_OPCODE(w);
+        int dst = (int)EXPR_DST(w), a = (int)EXPR_A(w), b = (int)EXPR_B(w);
+
+        if (op == EXPR_OP_IMM) {
+            known[dst] = true;
+            emitted[dst] = false;
+            value[dst] = (int)in->code[++i];
+            continue;
+        }
+
+        // Which source registers does this instruction read?
+        bool reads_b = op <= EXPR_OP_DIV;
+        if (known[a] && (!reads_b || known[b]) && op != EXPR_OP_HALT) {
+            value[dst] = op == EXPR_OP_MOV ? value[a] : expr_apply(op, value[a], value[b]);
+            known[dst] = true;
+            emitted[dst] = false;
+            continue;
+        }
+
+        // The instruction stays: load any constant operands it still needs
+        if (known[a] && !emitted[a]) {
+            rc |= expr_emit_imm(out, a, value[a]);
+            emitted[a] = true;
+        }
+        if (reads_b && known[b] && !emitted[b]) {
+            rc |= expr_emit_imm(out, b, value[b]);
+            emitted[b] = true;
+        }
+        rc |= expr_program_push(out, w);
+        if (op == EXPR_OP_HALT) {
+            break;
+        }
+        known[dst] = false;
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+#endif // EXPR_VM_H
@@ -0,0 +1,72 @@
+/**
+ * futex.h - Minimal wrappers around the Linux futex system call
+ *
+ * A futex ("fast userspace mutex") lets a thread sleep in the kernel until
+ * a 32-bit word changes, without the kernel knowing anything about the lock
+ * built on top of it:
+ *
+ *     futex_wait(&word, seen)  sleeps only while word still equals `seen`
+ *     futex_wake(&word, n)     wakes up to n threads sleeping on word
+ *     futex_wait_timeout(&word, seen, ns)  as futex_wait, for at most ns
+ *
+ * The "compare then sleep" step is atomic in the kernel, so a wake that
+ * happens between our last check and the call to futex_wait is never lost.
+ *
+ * On systems without futexes (e.g. macOS) futex_wait degrades to a short
+ * sleep and futex_wake does nothing, which is correct as long as callers
+ * re-check their condition in a loop (they must anyway).
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include so that syscall() and usleep() are declared.
+ */
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Sleep while *addr == expected. Returns early on a wake, a signal, or if
+// the value already differs.
+static inline void futex_wait(uint32_t *addr, uint32_t expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+// Like futex_wait, but also returns after `timeout_ns` nanoseconds
+static inline void futex_wait_timeout(uint32_t *addr, uint32_t expected, uint64_t timeout_ns) {
+    struct timespec ts = {(time_t)(timeout_ns / 1000000000u), (long)(timeout_ns % 1000000000u)};
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, &ts, NULL, 0);
+}
+
+// Wake at most `count` threads sleeping on addr
+static inline void futex_wake(uint32_t *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+#else // !__linux__
+#include <unistd.h>
+
+static inline void futex_wait(uint32_t *addr, uint32_t expected) {
+    if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) == expected) {
+        usleep(50);
+    }
+}
+
+static inline void futex_wait_timeout(uint32_t *addr, uint32_t expected, uint64_t timeout_ns) {
+    if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) == expected) {
+        usleep(timeout_ns < 50000 ? (useconds_t)(timeout_ns / 1000) : 50);
+    }
+}
+
+static inline void futex_wake(uint32_t *addr, int count) {
+    (void)addr;
+    (void)count;
+}
+#endif // __linux__
+
+#endif // FUTEX_H
@@ -0,0 +1,441 @@
+/**
+ * hash_map.h - Concurrent open-addressing hash map from int keys to void*
+ *
+ * simple_threading.c guards all shared state with one global lock. This
+ * map lets many threads share a table of `void*` values (the same kind of
+ * pointer as in void_pointer_examples) without any global lock:
+ *
+ *     hash_map_t map;
+ *     hash_map_init(&map, 1024, 64);          // initial slots, lock stripes
+ *     hash_map_put(&map, 42, ptr);            // insert or replace
+ *     void *v;
+ *     if (hash_map_get(&map, 42, &v)) { ... } // never takes a lock
+ *     hash_map_remove(&map, 42, NULL);
+ *     hash_map_destroy(&map);
+ *
+ * This header provides:
+ * 1. Striped writers - every key maps to one of a fixed set of
+ *    simple_lock_stripes_t locks, so writers of unrelated keys rarely meet.
+ * 2. Optimistic readers - each stripe also has a seqlock_t that its
+ *    writers make odd while they change the stripe's keys. A reader probes
+ *    the table without locking and retries only if the counter moved, so
+ *    reads never write to shared memory.
+ * 3. Incremental resizing - when a table is 3/4 full a larger one is
+ *    attached to it, and every later write moves HASH_MAP_MIGRATE_CHUNK
+ *    slots over. No single insert pays for a full rehash. Readers look in
+ *    the old table and then the new one until the move is complete.
+ *
+ * Slots are claimed with a compare-and-swap, because writers holding
+ * different stripes may probe into the same empty slot. Old tables stay
+ * allocated until hash_map_destroy, since a reader may still be probing
+ * them; together they are smaller than the current table.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see simple_lock.h).
+ */
+
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "simple_lock.h"
+#include "sharded_counter.h"
+#include "seqlock.h"
+
+// Slots moved to the new table by every write during a resize
+#define HASH_MAP_MIGRATE_CHUNK 64
+
+// Smallest table
+#define HASH_MAP_MIN_CAPACITY 16
+
+// Slot tags. A full slot stores HASH_MAP_FULL | (uint32_t)key.
+#define HASH_MAP_EMPTY 0ull
+#define HASH_MAP_TOMBSTONE 1ull  // Removed; probing continues past it
+#define HASH_MAP_BUSY 2ull       // Claimed by a writer that is filling it in
+#define HASH_MAP_MOVED 3ull      // Copied to the next table; probing continues past it
+#define HASH_MAP_CLOSED 4ull     // Was empty when the resize passed; ends a probe like EMPTY
+#define HASH_MAP_FULL (1ull << 32)
+
+typedef struct {
+    uint64_t tag;
+    void *value;
+} hash_map_slot_t;
+
+typedef struct hash_map_table {
+    hash_map_slot_t *slots;
+    size_t mask;                        // Capacity - 1 (a power of two)
+    _Alignas(CACHE_LINE_SIZE) size_t used;  // Slots that are no longer EMPTY
+    _Alignas(CACHE_LINE_SIZE) size_t migrate_next;  // First slot no helper has claimed
+    size_t migrate_done;                // Slots moved so far
+    struct hash_map_table *next;        // Table being resized into, NULL if none
+} hash_map_table_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) hash_map_table_t *table;  // Current table
+    hash_map_table_t *first;            // Oldest table; each links to its successor
+    simple_lock_stripes_t locks;
+    seqlock_t *seqs;                    // One per lock stripe, written under it
+    sharded_counter_t count;            // Keys in the map
+} hash_map_t;
+
+// Insert outcomes of hash_map_table_insert
+typedef enum {
+    HASH_MAP_INSERTED,
+    HASH_MAP_UPDATED,
+    HASH_MAP_RESIZING,   // The table is being resized: use its successor
+    HASH_MAP_NO_ROOM
+} hash_map_insert_t;
+
+// Scrambles the key so that nearby keys do not form long probe runs
+static inline uint32_t hash_map_hash(int key) {
+    uint32_t h = (uint32_t)key;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline uint64_t hash_map_tag(int key) {
+    return HASH_MAP_FULL | (uint32_t)key;
+}
+
+static inline hash_map_table_t *hash_map_table_new(size_t capacity) {
+    hash_map_table_t *t = (hash_map_table_t *)aligned_alloc(CACHE_LINE_SIZE, sizeof(hash_map_table_t));
+    if (t == NULL) {
+        return NULL;
+    }
+    t->slots = (hash_map_slot_t *)calloc(capacity, sizeof(hash_map_slot_t));
+    if (t->slots == NULL) {
+        free(t);
+        return NULL;
+    }
+    t->mask = capacity - 1;
+    t->used = 0;
+    t->migrate_next = 0;
+    t->migrate_done = 0;
+    t->next = NULL;
+    return t;
+}
+
+// Set up a map with room for about `capacity` keys before the first resize
+// and `stripes` writer locks. Returns 0 on success, -1 when out of memory.
+static inline int hash_map_init(hash_map_t *m, size_t capacity, size_t stripes) {
+    size_t n = HASH_MAP_MIN_CAPACITY;
+    while (n < capacity) {
+        n <<= 1;
+    }
+
+    m->table = hash_map_table_new(n);
+    if (m->table == NULL) {
+        return -1;
+    }
+    m->first = m->table;
+    if (simple_lock_stripes_init(&m->locks, stripes, SIMPLE_LOCK_ADAPTIVE) != 0) {
+        free(m->table->slots);
+        free(m->table);
+        return -1;
+    }
+    size_t count = simple_lock_stripes_count(&m->locks);
+    m->seqs = (seqlock_t *)aligned_alloc(CACHE_LINE_SIZE, count * sizeof(seqlock_t));
+    if (m->seqs == NULL || sharded_counter_init(&m->count, SHARDED_COUNTER_PER_THREAD, 0) != 0) {
+        free(m->seqs);
+        simple_lock_stripes_destroy(&m->locks);
+        free(m->table->slots);
+        free(m->table);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        seqlock_init(&m->seqs[i]);
+    }
+    return 0;
+}
+
+// No other thread may use the map any more
+static inline void hash_map_destroy(hash_map_t *m) {
+    hash_map_table_t *t = m->first;
+    while (t != NULL) {
+        hash_map_table_t *next = t->next;
+        free(t->slots);
+        free(t);
+        t = next;
+    }
+    m->table = NULL;
+    m->first = NULL;
+    free(m->seqs);
+    simple_lock_stripes_destroy(&m->locks);
+    sharded_counter_destroy(&m->count);
+}
+
+// Number of keys. Exact when no writer is running.
+static inline size_t hash_map_size(const hash_map_t *m) {
+    int64_t n = sharded_counter_read(&m->count);
+    return n > 0 ? (size_t)n : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Writer side: stripe lock plus its sequence counter
+// ---------------------------------------------------------------------------
+
+// The stripe lock already serializes the writers, so the seqlock only has
+// to tell readers of the stripe to retry
+static inline seqlock_t *hash_map_lock(hash_map_t *m, int key) {
+    size_t stripe = simple_lock_stripe_index(&m->locks, (uint32_t)key);
+    simple_lock_acquire(&m->locks.stripes[stripe].lock);
+    seqlock_write_begin(&m->seqs[stripe]);
+    return &m->seqs[stripe];
+}
+
+static inline void hash_map_unlock(hash_map_t *m, int key, seqlock_t *seq) {
+    seqlock_write_end(seq);
+    simple_lock_release(simple_lock_stripe_for(&m->locks, (uint32_t)key));
+}
+
+// Slot holding `tag` in `t`, or NULL. Lock-free; the caller validates.
+static inline hash_map_slot_t *hash_map_table_find(hash_map_table_t *t, uint32_t hash, uint64_t tag) {
+    size_t i = hash & t->mask;
+    for (size_t n = 0; n <= t->mask; n++, i = (i + 1) & t->mask) {
+        uint64_t s = __atomic_load_n(&t->slots[i].tag, __ATOMIC_ACQUIRE);
+        if (s == tag) {
+            return &t->slots[i];
+        }
+        if (s == HASH_MAP_EMPTY || s == HASH_MAP_CLOSED) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// Insert or update `tag` in `t`. The caller holds the key's stripe, so no
+// other thread changes this key, but writers of other stripes may claim
+// empty slots at the same time.
+static inline hash_map_insert_t hash_map_table_insert(hash_map_table_t *t, uint32_t hash,
+                                                      uint64_t tag, void *value) {
+    while (true) {
+        hash_map_slot_t *reuse = NULL;
+        hash_map_slot_t *target = NULL;
+        size_t i = hash & t->mask;
+        for (size_t n = 0; n <= t->mask; n++, i = (i + 1) & t->mask) {
+            hash_map_slot_t *slot = &t->slots[i];
+            uint64_t s = __atomic_load_n(&slot->tag, __ATOMIC_ACQUIRE);
+            if (s == tag) {
+                __atomic_store_n(&slot->value, value, __ATOMIC_RELEASE);
+                return HASH_MAP_UPDATED;
+            }
+            if (s == HASH_MAP_MOVED || s == HASH_MAP_CLOSED) {
+                return HASH_MAP_RESIZING;
+            }
+            if (s == HASH_MAP_TOMBSTONE && reuse == NULL) {
+                reuse = slot;
+            } else if (s == HASH_MAP_EMPTY) {
+                target = slot;
+                break;   // The key is not further along
+            }
+        }
+
+        // Prefer the first tombstone, after making sure the key is absent
+        uint64_t expected = reuse != NULL ? HASH_MAP_TOMBSTONE : HASH_MAP_EMPTY;
+        hash_map_slot_t *slot = reuse != NULL ? reuse : target;
+        if (slot == NULL) {
+            return HASH_MAP_NO_ROOM;
+        }
+        if (!__atomic_compare_exchange_n(&slot->tag, &expected, HASH_MAP_BUSY, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;   // Another stripe's writer or the resize took it: probe again
+        }
+        __atomic_store_n(&slot->value, value, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->tag, tag, __ATOMIC_RELEASE);
+        if (reuse == NULL) {
+            __atomic_fetch_add(&t->used, 1, __ATOMIC_RELAXED);
+        }
+        return HASH_MAP_INSERTED;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Incremental resizing
+// ---------------------------------------------------------------------------
+
+// Attach a successor to the full table `t`. Doubles the capacity unless
+// most used slots are tombstones, in which case it only cleans them out.
+static inline void hash_map_start_resize(hash_map_t *m, hash_map_table_t *t) {
+    size_t capacity = t->mask + 1;
+    if (hash_map_size(m) >= capacity / 4) {
+        capacity *= 2;
+    }
+    hash_map_table_t *next = hash_map_table_new(capacity);
+    if (next == NULL) {
+        return;   // Keep going in the old table; the next insert tries again
+    }
+    hash_map_table_t *expected = NULL;
+    if (!__atomic_compare_exchange_n(&t->next, &expected, next, false,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        free(next->slots);   // Another writer started it first
+        free(next);
+    }
+}
+
+// Move one slot of `t` into `next`. Unused slots are closed as well, so
+// that new keys can no longer land behind the resize. An empty slot
+// becomes CLOSED rather than MOVED, so probes in the old table still end
+// where they did before and lookups stay short during the resize.
+static inline void hash_map_migrate_slot(hash_map_t *m, hash_map_table_t *next, hash_map_slot_t *slot) {
+    while (true) {
+        uint64_t s = __atomic_load_n(&slot->tag, __ATOMIC_ACQUIRE);
+        if (s == HASH_MAP_MOVED || s == HASH_MAP_CLOSED) {
+            return;
+        }
+        if (s == HASH_MAP_EMPTY || s == HASH_MAP_TOMBSTONE) {
+            uint64_t closed = s == HASH_MAP_EMPTY ? HASH_MAP_CLOSED : HASH_MAP_MOVED;
+            if (__atomic_compare_exchange_n(&slot->tag, &s, closed, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                return;
+            }
+            continue;
+        }
+        if (s == HASH_MAP_BUSY) {
+            cpu_relax();   // A writer is filling it in and holds its stripe
+            continue;
+        }
+
+        int key = (int)(uint32_t)s;
+        seqlock_t *seq = hash_map_lock(m, key);
+        if (__atomic_load_n(&slot->tag, __ATOMIC_ACQUIRE) == s) {
+            void *value = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+            hash_map_table_insert(next, hash_map_hash(key), s, value);
+            __atomic_store_n(&slot->tag, HASH_MAP_MOVED, __ATOMIC_RELEASE);
+        }
+        hash_map_unlock(m, key, seq);
+    }
+}
+
+// Move the next chunk of the table being resized, if there is one. The
+// helper that moves the last chunk makes the new table current.
+static inline void hash_map_help_resize(hash_map_t *m) {
+    hash_map_table_t *t = __atomic_load_n(&m->table, __ATOMIC_ACQUIRE);
+    hash_map_table_t *next = __atomic_load_n(&t->next, __ATOMIC_ACQUIRE);
+    if (next == NULL) {
+        return;
+    }
+    size_t capacity = t->mask + 1;
+    size_t start = __atomic_fetch_add(&t->migrate_next, HASH_MAP_MIGRATE_CHUNK, __ATOMIC_RELAXED);
+    if (start >= capacity) {
+        return;   // Every chunk is taken; their helpers finish the job
+    }
+    size_t end = start + HASH_MAP_MIGRATE_CHUNK < capacity ? start + HASH_MAP_MIGRATE_CHUNK : capacity;
+    for (size_t i = start; i < end; i++) {
+        hash_map_migrate_slot(m, next, &t->slots[i]);
+    }
+    if (__atomic_add_fetch(&t->migrate_done, end - start, __ATOMIC_ACQ_REL) == capacity) {
+        __atomic_store_n(&m->table, next, __ATOMIC_RELEASE);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Operations
+// ---------------------------------------------------------------------------
+
+// Look up `key`. Returns true and stores the value in *value if present.
+// Readers never lock and never write shared memory.
+static inline bool hash_map_get(hash_map_t *m, int key, void **value) {
+    uint32_t hash = hash_map_hash(key);
+    uint64_t tag = hash_map_tag(key);
+    const seqlock_t *seq = &m->seqs[simple_lock_stripe_index(&m->locks, (uint32_t)key)];
+
+    while (true) {
+        uint32_t start = seqlock_read_begin(seq);
+
+        // A key being resized lives in the old table until it is moved,
+        // so search the whole chain from the current table on
+        hash_map_slot_t *slot = NULL;
+        hash_map_table_t *t = __atomic_load_n(&m->table, __ATOMIC_ACQUIRE);
+        while (t != NULL && (slot = hash_map_table_find(t, hash, tag)) == NULL) {
+            t = __atomic_load_n(&t->next, __ATOMIC_ACQUIRE);
+        }
+        void *v = slot != NULL ? __atomic_load_n(&slot->value, __ATOMIC_RELAXED) : NULL;
+
+        if (!seqlock_read_retry(seq, start)) {
+            if (slot != NULL && value != NULL) {
+                *value = v;
+            }
+            return slot != NULL;
+        }
+    }
+}
+
+// Insert `key` or replace its value. Returns 0, or -1 when out of memory.
+static inline int hash_map_put(hash_map_t *m, int key, void *value) {
+    uint32_t hash = hash_map_hash(key);
+    uint64_t tag = hash_map_tag(key);
+    bool existed = false;
+    hash_map_insert_t rc;
+
+    seqlock_t *seq = hash_map_lock(m, key);
+    hash_map_table_t *t = __atomic_load_n(&m->table, __ATOMIC_ACQUIRE);
+    while (true) {
+        hash_map_table_t *next = __atomic_load_n(&t->next, __ATOMIC_ACQUIRE);
+        if (next != NULL) {
+            // Being resized: the key goes into the new table only
+            hash_map_slot_t *slot = hash_map_table_find(t, hash, tag);
+            if (slot != NULL) {
+                __atomic_store_n(&slot->tag, HASH_MAP_MOVED, __ATOMIC_RELEASE);
+                existed = true;
+            }
+            t = next;
+            continue;
+        }
+        rc = hash_map_table_insert(t, hash, tag, value);
+        if (rc != HASH_MAP_RESIZING) {
+            break;
+        }
+    }
+    hash_map_unlock(m, key, seq);
+
+    if (rc == HASH_MAP_NO_ROOM) {
+        return -1;
+    }
+    if (rc == HASH_MAP_INSERTED && !existed) {
+        sharded_counter_inc(&m->count);
+    }
+    size_t used = __atomic_load_n(&t->used, __ATOMIC_RELAXED);
+    if (used > (t->mask + 1) / 4 * 3 && __atomic_load_n(&t->next, __ATOMIC_RELAXED) == NULL &&
+        t == __atomic_load_n(&m->table, __ATOMIC_ACQUIRE)) {
+        hash_map_start_resize(m, t);
+    }
+    hash_map_help_resize(m);
+    return 0;
+}
+
+// Remove `key`. Returns true (and the old value in *value) if it was there.
+static inline bool hash_map_remove(hash_map_t *m, int key, void **value) {
+    uint32_t hash = hash_map_hash(key);
+    uint64_t tag = hash_map_tag(key);
+    bool found = false;
+
+    seqlock_t *seq = hash_map_lock(m, key);
+    for (hash_map_table_t *t = __atomic_load_n(&m->table, __ATOMIC_ACQUIRE); t != NULL;
+         t = __atomic_load_n(&t->next, __ATOMIC_ACQUIRE)) {
+        hash_map_slot_t *slot = hash_map_table_find(t, hash, tag);
+        if (slot != NULL) {
+            if (value != NULL) {
+                *value = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+            }
+            __atomic_store_n(&slot->tag, HASH_MAP_TOMBSTONE, __ATOMIC_RELEASE);
+            found = true;
+        }
+    }
+    hash_map_unlock(m, key, seq);
+
+    if (found) {
+        sharded_counter_dec(&m->count);
+    }
+    hash_map_help_resize(m);
+    return found;
+}
+
+#endif // HASH_MAP_H
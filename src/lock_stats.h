@@ -0,0 +1,265 @@
+/**
+ * lock_stats.h - Contention, wait-time and hold-time statistics for a lock
+ *
+ * This header provides:
+ * 1. lock_stats_hist_t - a log-linear histogram of tick counts
+ * 2. lock_stats_t      - per-lock counters (acquisitions, contended
+ *                        acquisitions, spins, futex parks) plus wait-time
+ *                        and hold-time histograms
+ * 3. lock_stats_probe_t - what one acquisition has seen so far
+ * 4. lock_stats_register / lock_stats_dump - a list of named locks that is
+ *                        printed to stderr when the program exits
+ *
+ * simple_lock.h uses it when SIMPLE_LOCK_STATS is defined (make LOCK_STATS=1):
+ *
+ *     simple_lock_init(&lock);
+ *     SIMPLE_LOCK_STATS_REGISTER(&lock, "lock");   // dumped at exit
+ *
+ * Every update happens while the lock is held: wait time and spins are
+ * recorded right after acquiring, hold time right before releasing. The
+ * lock itself therefore serializes the counters, and they are plain
+ * integers with no atomic operations of their own.
+ *
+ * Times are read with rdtsc on x86 and CLOCK_MONOTONIC elsewhere. Dumps
+ * convert ticks to nanoseconds with a rate measured at dump time.
+ */
+
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// ---------------------------------------------------------------------------
+// Timestamps
+// ---------------------------------------------------------------------------
+
+static inline uint64_t lock_stats_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// A timestamp in ticks: TSC cycles on x86, nanoseconds elsewhere
+static inline uint64_t lock_stats_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return lock_stats_monotonic_ns();
+#endif
+}
+
+// Ticks per nanosecond, measured against CLOCK_MONOTONIC over ~10ms
+static inline double lock_stats_ticks_per_ns(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t ns0 = lock_stats_monotonic_ns();
+    uint64_t t0 = lock_stats_now();
+    uint64_t ns1;
+    do {
+        ns1 = lock_stats_monotonic_ns();
+    } while (ns1 - ns0 < 10 * 1000 * 1000);
+    return (double)(lock_stats_now() - t0) / (double)(ns1 - ns0);
+#else
+    return 1.0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Log-linear histogram
+// ---------------------------------------------------------------------------
+
+// Each power of two is split into 2^LOCK_STATS_SUB_BITS equal buckets, so
+// a bucket is never wider than a quarter of its lower bound. That keeps
+// percentiles within ~25% from a few cycles up to minutes, in 2KB.
+#define LOCK_STATS_SUB_BITS 2
+#define LOCK_STATS_SUB_BUCKETS (1u << LOCK_STATS_SUB_BITS)
+#define LOCK_STATS_BUCKETS ((64 - LOCK_STATS_SUB_BITS + 1) * LOCK_STATS_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[LOCK_STATS_BUCKETS];
+    uint64_t total;    // Values recorded
+    uint64_t sum;      // Sum of all values, for the mean
+    uint64_t max;
+} lock_stats_hist_t;
+
+// Values below LOCK_STATS_SUB_BUCKETS get a bucket each. Above that, the
+// bucket is picked by the position of the highest set bit plus the next
+// LOCK_STATS_SUB_BITS bits below it.
+static inline unsigned int lock_stats_bucket(uint64_t value) {
+    if (value < LOCK_STATS_SUB_BUCKETS) {
+        return (unsigned int)value;
+    }
+    unsigned int msb = 63 - (unsigned int)__builtin_clzll(value);
+    unsigned int sub = (unsigned int)(value >> (msb - LOCK_STATS_SUB_BITS)) & (LOCK_STATS_SUB_BUCKETS - 1);
+    return (msb - LOCK_STATS_SUB_BITS + 1) * LOCK_STATS_SUB_BUCKETS + sub;
+}
+
+// Smallest value that lands in `bucket`
+static inline uint64_t lock_stats_bucket_floor(unsigned int bucket) {
+    if (bucket < LOCK_STATS_SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned int msb = bucket / LOCK_STATS_SUB_BUCKETS + LOCK_STATS_SUB_BITS - 1;
+    uint64_t sub = bucket % LOCK_STATS_SUB_BUCKETS;
+    return (LOCK_STATS_SUB_BUCKETS + sub) << (msb - LOCK_STATS_SUB_BITS);
+}
+
+static inline void lock_stats_hist_record(lock_stats_hist_t *h, uint64_t value) {
+    h->counts[lock_stats_bucket(value)]++;
+    h->total++;
+    h->sum += value;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+// Approximate q-th quantile (0 <= q <= 1): the middle of the bucket that
+// holds it, but never more than the largest value recorded
+static inline uint64_t lock_stats_hist_percentile(const lock_stats_hist_t *h, double q) {
+    uint64_t rank = (uint64_t)(q * (double)h->total);
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i + 1 < LOCK_STATS_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            uint64_t lo = lock_stats_bucket_floor(i);
+            uint64_t mid = lo + (lock_stats_bucket_floor(i + 1) - lo) / 2;
+            return mid < h->max ? mid : h->max;
+        }
+    }
+    return h->max;
+}
+
+// ---------------------------------------------------------------------------
+// Per-lock statistics
+// ---------------------------------------------------------------------------
+
+typedef struct lock_stats {
+    uint64_t acquisitions;
+    uint64_t contended;    // Acquisitions that did not succeed on the first try
+    uint64_t spins;        // Failed attempts, summed over all acquisitions
+    uint64_t parks;        // Times a waiter slept in the kernel
+    uint64_t acquired_at;  // When the current holder got the lock
+    lock_stats_hist_t wait;
+    lock_stats_hist_t hold;
+    const char *name;          // Set by lock_stats_register
+    struct lock_stats *next;   // Registry list
+} lock_stats_t;
+
+// State of one acquisition in progress, kept on the waiter's stack
+typedef struct {
+    uint64_t start;
+    uint64_t spins;
+    uint64_t parks;
+} lock_stats_probe_t;
+
+static inline void lock_stats_init(lock_stats_t *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+static inline void lock_stats_probe_start(lock_stats_probe_t *p) {
+    p->start = lock_stats_now();
+    p->spins = 0;
+    p->parks = 0;
+}
+
+// Call right after the lock was acquired
+static inline void lock_stats_acquired(lock_stats_t *s, const lock_stats_probe_t *p) {
+    uint64_t now = lock_stats_now();
+    s->acquisitions++;
+    s->contended += p->spins > 0 || p->parks > 0;
+    s->spins += p->spins;
+    s->parks += p->parks;
+    lock_stats_hist_record(&s->wait, now - p->start);
+    s->acquired_at = now;
+}
+
+// Call right before the lock is released
+static inline void lock_stats_released(lock_stats_t *s) {
+    lock_stats_hist_record(&s->hold, lock_stats_now() - s->acquired_at);
+}
+
+// ---------------------------------------------------------------------------
+// Dumping
+// ---------------------------------------------------------------------------
+
+static inline void lock_stats_dump_hist(FILE *out, const char *label, const lock_stats_hist_t *h,
+                                        double ticks_per_ns, bool buckets) {
+    if (h->total == 0) {
+        fprintf(out, "  %-5s no samples\n", label);
+        return;
+    }
+    fprintf(out, "  %-5s ns: mean %.0f  p50 %.0f  p90 %.0f  p99 %.0f  p999 %.0f  max %.0f\n", label,
+            (double)h->sum / (double)h->total / ticks_per_ns,
+            (double)lock_stats_hist_percentile(h, 0.50) / ticks_per_ns,
+            (double)lock_stats_hist_percentile(h, 0.90) / ticks_per_ns,
+            (double)lock_stats_hist_percentile(h, 0.99) / ticks_per_ns,
+            (double)lock_stats_hist_percentile(h, 0.999) / ticks_per_ns,
+            (double)h->max / ticks_per_ns);
+
+    // One line per non-empty bucket: [floor, next floor) and its share
+    for (unsigned int i = 0; buckets && i < LOCK_STATS_BUCKETS; i++) {
+        if (h->counts[i] == 0) {
+            continue;
+        }
+        double lo = (double)lock_stats_bucket_floor(i) / ticks_per_ns;
+        double hi = i + 1 < LOCK_STATS_BUCKETS ? (double)lock_stats_bucket_floor(i + 1) / ticks_per_ns
+                                               : (double)UINT64_MAX / ticks_per_ns;
+        fprintf(out, "        [%12.0f, %12.0f) %10llu %6.2f%%\n", lo, hi, (unsigned long long)h->counts[i],
+                100.0 * (double)h->counts[i] / (double)h->total);
+    }
+}
+
+// Print one lock's statistics, with every non-empty histogram bucket when
+// `buckets` is set. `ticks_per_ns` comes from lock_stats_ticks_per_ns();
+// pass 0 to have it measured here.
+static inline void lock_stats_dump(FILE *out, const lock_stats_t *s, double ticks_per_ns, bool buckets) {
+    if (ticks_per_ns <= 0) {
+        ticks_per_ns = lock_stats_ticks_per_ns();
+    }
+    fprintf(out, "lock %s: %llu acquisitions, %llu contended (%.1f%%), %llu spins, %llu parks\n",
+            s->name != NULL ? s->name : "(unnamed)", (unsigned long long)s->acquisitions,
+            (unsigned long long)s->contended,
+            s->acquisitions > 0 ? 100.0 * (double)s->contended / (double)s->acquisitions : 0.0,
+            (unsigned long long)s->spins, (unsigned long long)s->parks);
+    lock_stats_dump_hist(out, "wait", &s->wait, ticks_per_ns, buckets);
+    lock_stats_dump_hist(out, "hold", &s->hold, ticks_per_ns, buckets);
+}
+
+// Registered locks of this program (the registry is per translation unit,
+// which for these single-file examples is the whole program)
+static lock_stats_t *lock_stats_registry;
+
+static inline void lock_stats_dump_all(FILE *out) {
+    lock_stats_t *s = __atomic_load_n(&lock_stats_registry, __ATOMIC_ACQUIRE);
+    if (s == NULL) {
+        return;
+    }
+    double ticks_per_ns = lock_stats_ticks_per_ns();
+    for (; s != NULL; s = s->next) {
+        lock_stats_dump(out, s, ticks_per_ns, true);
+    }
+}
+
+static inline void lock_stats_dump_at_exit(void) {
+    lock_stats_dump_all(stderr);
+}
+
+// Name a lock's statistics and print them to stderr at exit. The lock must
+// stay alive until then, so register only global or leaked locks.
+static inline void lock_stats_register(lock_stats_t *s, const char *name) {
+    s->name = name;
+    lock_stats_t *head = __atomic_load_n(&lock_stats_registry, __ATOMIC_RELAXED);
+    do {
+        s->next = head;
+    } while (!__atomic_compare_exchange_n(&lock_stats_registry, &head, s, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    if (head == NULL) {
+        atexit(lock_stats_dump_at_exit);
+    }
+}
+
+#endif // LOCK_STATS_H
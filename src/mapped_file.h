@@ -0,0 +1,395 @@
+/**
+ * mapped_file.h - Zero-copy int array and matrix views of files via mmap
+ *
+ * Loading a file with read() into a malloc'd buffer copies it twice: the
+ * kernel first reads it into the page cache, then read() copies it into
+ * the buffer. Mapping the file lets the program read the page cache
+ * directly. Pages are faulted in the first time they are touched, and the
+ * kernel can evict them again under memory pressure. This header provides:
+ *
+ * 1. mapped_file_t   - a whole file mapped read-only (or read-write), seen
+ *                      as an int array with mapped_file_ints().
+ * 2. Matrix files    - a 64-byte header followed by rows in matrix_t's own
+ *                      padded layout, so mapped_file_matrix() fills in a
+ *                      matrix_t that points straight into the mapping.
+ * 3. mapped_chunks_t - streams a file through a window of fixed size, for
+ *                      files bigger than RAM or than the address space the
+ *                      program wants to give them.
+ *
+ *     mapped_file_t f;
+ *     if (mapped_file_open(&f, "data.bin", MAPPED_FILE_SEQUENTIAL) != 0) { perror("open"); }
+ *     size_t n;
+ *     const int *a = mapped_file_ints(&f, &n);
+ *     long long sum = array_sum(a, n);
+ *     mapped_file_close(&f);
+ *
+ *     mapped_chunks_t c;
+ *     mapped_chunks_open(&c, "huge.bin", 64u << 20, MAPPED_FILE_DROP_BEHIND);
+ *     while (mapped_chunks_next(&c) > 0) {
+ *         size_t n;
+ *         const int *a = mapped_chunks_ints(&c, &n);
+ *         ...
+ *     }
+ *     mapped_chunks_close(&c);
+ *
+ * The access flags become madvise() hints. SEQUENTIAL asks for aggressive
+ * readahead, RANDOM turns readahead off, and WILLNEED starts reading the
+ * whole range now. HUGE_PAGES places the mapping on a 2MB boundary and
+ * asks for transparent huge pages. That only takes effect on file systems
+ * that can back the page cache with huge pages (tmpfs with huge=advise,
+ * hugetlbfs, some newer file systems), and is a no-op elsewhere.
+ *
+ * Files are raw native-endian ints (or matrix files as above). All functions
+ * return 0 (or a count) on success and -1 with errno set on failure.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see futex.h).
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "matrix.h"
+
+typedef enum {
+    MAPPED_FILE_READ        = 0,       // Read-only (default)
+    MAPPED_FILE_WRITE       = 1 << 0,  // Shared read-write: stores go to the file
+    MAPPED_FILE_SEQUENTIAL  = 1 << 1,  // MADV_SEQUENTIAL: read ahead aggressively
+    MAPPED_FILE_RANDOM      = 1 << 2,  // MADV_RANDOM: no readahead
+    MAPPED_FILE_WILLNEED    = 1 << 3,  // MADV_WILLNEED: start reading everything now
+    MAPPED_FILE_POPULATE    = 1 << 4,  // MAP_POPULATE: fault everything in before returning
+    MAPPED_FILE_HUGE_PAGES  = 1 << 5,  // 2MB-aligned mapping plus MADV_HUGEPAGE
+    MAPPED_FILE_DROP_BEHIND = 1 << 6,  // Chunks only: evict each chunk from the page cache after use
+} mapped_file_flags_t;
+
+#define MAPPED_FILE_HUGE_PAGE_SIZE (2u << 20)
+
+// Window size mapped_chunks_open uses when given 0
+#define MAPPED_CHUNK_DEFAULT_SIZE (64u << 20)
+
+typedef struct {
+    void *data;     // File contents, NULL for an empty file
+    size_t size;    // File size in bytes
+    int flags;
+} mapped_file_t;
+
+// ---------------------------------------------------------------------------
+// Mapping
+// ---------------------------------------------------------------------------
+
+// Turn the access flags into madvise hints. Hints that the kernel rejects
+// are ignored: the mapping works the same without them.
+static inline void mapped_file_advise_range(void *addr, size_t len, int flags) {
+    if (flags & MAPPED_FILE_SEQUENTIAL) {
+        madvise(addr, len, MADV_SEQUENTIAL);
+    }
+    if (flags & MAPPED_FILE_RANDOM) {
+        madvise(addr, len, MADV_RANDOM);
+    }
+    if (flags & MAPPED_FILE_WILLNEED) {
+        madvise(addr, len, MADV_WILLNEED);
+    }
+    if (flags & MAPPED_FILE_HUGE_PAGES) {
+        madvise(addr, len, MADV_HUGEPAGE);
+    }
+}
+
+// Map len bytes of fd at offset. A huge page can only back a 2MB-aligned
+// virtual range, so with MAPPED_FILE_HUGE_PAGES we reserve 2MB more
+// address space than needed, map the file over its first 2MB boundary
+// and hand back the unused ends. Returns NULL on failure.
+static inline void *mapped_file_map(int fd, off_t offset, size_t len, int flags) {
+    int prot = PROT_READ | (flags & MAPPED_FILE_WRITE ? PROT_WRITE : 0);
+    int map_flags = MAP_SHARED | (flags & MAPPED_FILE_POPULATE ? MAP_POPULATE : 0);
+    void *addr;
+
+    if (flags & MAPPED_FILE_HUGE_PAGES) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t mapped = (len + page - 1) / page * page;
+        size_t span = mapped + MAPPED_FILE_HUGE_PAGE_SIZE;
+        char *reserve = (char *)mmap(NULL, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reserve == MAP_FAILED) {
+            return NULL;
+        }
+        char *aligned = (char *)(((uintptr_t)reserve + MAPPED_FILE_HUGE_PAGE_SIZE - 1) &
+                                 ~(uintptr_t)(MAPPED_FILE_HUGE_PAGE_SIZE - 1));
+        addr = mmap(aligned, len, prot, map_flags | MAP_FIXED, fd, offset);
+        if (addr == MAP_FAILED) {
+            int saved = errno;
+            munmap(reserve, span);
+            errno = saved;
+            return NULL;
+        }
+        if (aligned > reserve) {
+            munmap(reserve, (size_t)(aligned - reserve));
+        }
+        if (aligned + mapped < reserve + span) {
+            munmap(aligned + mapped, (size_t)(reserve + span - (aligned + mapped)));
+        }
+    } else {
+        addr = mmap(NULL, len, prot, map_flags, fd, offset);
+        if (addr == MAP_FAILED) {
+            return NULL;
+        }
+    }
+    mapped_file_advise_range(addr, len, flags);
+    return addr;
+}
+
+// Map the whole file at `path`. An empty file gives data == NULL, size 0.
+static inline int mapped_file_open(mapped_file_t *f, const char *path, int flags) {
+    f->data = NULL;
+    f->size = 0;
+    f->flags = flags;
+
+    int fd = open(path, (flags & MAPPED_FILE_WRITE ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    f->size = (size_t)st.st_size;
+    if (f->size > 0) {
+        f->data = mapped_file_map(fd, 0, f->size, flags);
+    }
+    // The mapping keeps its own reference to the file
+    int saved = errno;
+    close(fd);
+    if (f->size > 0 && f->data == NULL) {
+        f->size = 0;
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+// Create (or truncate) `path` with `size` bytes and map it read-write.
+// The file starts out sparse and zero-filled; blocks are allocated as
+// pages are written.
+static inline int mapped_file_create(mapped_file_t *f, const char *path, size_t size, int flags) {
+    f->data = NULL;
+    f->size = 0;
+    f->flags = flags | MAPPED_FILE_WRITE;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    if (size > 0) {
+        f->data = mapped_file_map(fd, 0, size, f->flags);
+    }
+    int saved = errno;
+    close(fd);
+    if (size > 0 && f->data == NULL) {
+        errno = saved;
+        return -1;
+    }
+    f->size = size;
+    return 0;
+}
+
+// Change the access hints of an open mapping, e.g. from SEQUENTIAL while
+// loading to RANDOM while probing
+static inline void mapped_file_advise(mapped_file_t *f, int flags) {
+    if (f->data != NULL) {
+        mapped_file_advise_range(f->data, f->size, flags);
+    }
+}
+
+// Write dirty pages of a writable mapping back to the file and wait
+static inline int mapped_file_sync(mapped_file_t *f) {
+    return f->data != NULL ? msync(f->data, f->size, MS_SYNC) : 0;
+}
+
+static inline void mapped_file_close(mapped_file_t *f) {
+    if (f->data != NULL) {
+        munmap(f->data, f->size);
+    }
+    f->data = NULL;
+    f->size = 0;
+}
+
+// The file as an int array. Trailing bytes that do not make up a whole int
+// are not included in *count.
+static inline int *mapped_file_ints(const mapped_file_t *f, size_t *count) {
+    *count = f->size / sizeof(int);
+    return (int *)f->data;
+}
+
+// ---------------------------------------------------------------------------
+// Matrix files
+// ---------------------------------------------------------------------------
+
+#define MAPPED_MATRIX_MAGIC 0x5854414Du  // "MATX" in a little-endian file
+
+// The header takes one whole cache line, so row 0 is as aligned in the
+// mapping as it is in a matrix_init allocation
+typedef struct {
+    uint32_t magic;
+    uint32_t header_size;   // MATRIX_ALIGNMENT
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t stride;        // Ints between rows, matrix_stride_for(cols)
+    uint8_t padding[MATRIX_ALIGNMENT - 32];
+} mapped_matrix_header_t;
+
+_Static_assert(sizeof(mapped_matrix_header_t) == MATRIX_ALIGNMENT, "matrix header must be one cache line");
+
+// Point m at the matrix stored in f. m->block stays NULL, so matrix_free
+// only clears the view; the data goes away with mapped_file_close.
+static inline int mapped_file_matrix(const mapped_file_t *f, matrix_t *m) {
+    memset(m, 0, sizeof(*m));
+    const mapped_matrix_header_t *h = (const mapped_matrix_header_t *)f->data;
+    if (f->size < sizeof(*h) || h->magic != MAPPED_MATRIX_MAGIC || h->header_size != sizeof(*h) ||
+        h->stride < h->cols || (h->stride != 0 && h->rows > (f->size - sizeof(*h)) / sizeof(int) / h->stride)) {
+        errno = EINVAL;
+        return -1;
+    }
+    m->data = (int *)((char *)f->data + sizeof(*h));
+    m->rows = (size_t)h->rows;
+    m->cols = (size_t)h->cols;
+    m->stride = (size_t)h->stride;
+    return 0;
+}
+
+// Create a zero-filled rows x cols matrix file at `path` and point m at it.
+// Everything written through m lands in the file.
+static inline int mapped_matrix_create(mapped_file_t *f, const char *path, size_t rows, size_t cols,
+                                       matrix_t *m, int flags) {
+    size_t stride = matrix_stride_for(cols);
+    if (stride != 0 && rows > (SIZE_MAX - sizeof(mapped_matrix_header_t)) / sizeof(int) / stride) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    if (mapped_file_create(f, path, sizeof(mapped_matrix_header_t) + rows * stride * sizeof(int), flags) != 0) {
+        return -1;
+    }
+    mapped_matrix_header_t *h = (mapped_matrix_header_t *)f->data;
+    h->magic = MAPPED_MATRIX_MAGIC;
+    h->header_size = sizeof(*h);
+    h->rows = rows;
+    h->cols = cols;
+    h->stride = stride;
+    return mapped_file_matrix(f, m);
+}
+
+// ---------------------------------------------------------------------------
+// Streaming chunks
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const void *data;   // Current chunk, NULL before the first and after the last
+    size_t size;        // Bytes in the current chunk
+    size_t offset;      // File offset of the current chunk
+    int fd;
+    int flags;
+    size_t file_size;
+    size_t chunk_size;  // A multiple of the page size (of 2MB with HUGE_PAGES)
+} mapped_chunks_t;
+
+// Open `path` for chunked reading. chunk_size 0 uses the default window; it
+// is rounded up to whole pages so chunk boundaries never split an int.
+static inline int mapped_chunks_open(mapped_chunks_t *c, const char *path, size_t chunk_size, int flags) {
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    c->flags = flags & ~MAPPED_FILE_WRITE;
+
+    size_t unit = flags & MAPPED_FILE_HUGE_PAGES ? MAPPED_FILE_HUGE_PAGE_SIZE : (size_t)sysconf(_SC_PAGESIZE);
+    if (chunk_size == 0) {
+        chunk_size = MAPPED_CHUNK_DEFAULT_SIZE;
+    }
+    c->chunk_size = (chunk_size + unit - 1) / unit * unit;
+
+    c->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (c->fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(c->fd, &st) != 0) {
+        int saved = errno;
+        close(c->fd);
+        c->fd = -1;
+        errno = saved;
+        return -1;
+    }
+    c->file_size = (size_t)st.st_size;
+    // Let the kernel read ahead of the first chunk
+    posix_fadvise(c->fd, 0, (off_t)c->chunk_size, POSIX_FADV_WILLNEED);
+    return 0;
+}
+
+// Unmap the current chunk, if any, and drop it from the page cache when
+// asked to
+static inline void mapped_chunks_release(mapped_chunks_t *c) {
+    if (c->data == NULL) {
+        return;
+    }
+    munmap((void *)c->data, c->size);
+    if (c->flags & MAPPED_FILE_DROP_BEHIND) {
+        posix_fadvise(c->fd, (off_t)c->offset, (off_t)c->size, POSIX_FADV_DONTNEED);
+    }
+    c->offset += c->size;
+    c->data = NULL;
+    c->size = 0;
+}
+
+// Move to the next chunk. Returns 1 when c->data holds a chunk, 0 at the
+// end of the file and -1 on error. While the caller works on one chunk,
+// the kernel is already reading the next.
+static inline int mapped_chunks_next(mapped_chunks_t *c) {
+    mapped_chunks_release(c);
+    if (c->offset >= c->file_size) {
+        return 0;
+    }
+    size_t len = c->file_size - c->offset;
+    if (len > c->chunk_size) {
+        len = c->chunk_size;
+    }
+    void *addr = mapped_file_map(c->fd, (off_t)c->offset, len, c->flags);
+    if (addr == NULL) {
+        return -1;
+    }
+    c->data = addr;
+    c->size = len;
+    if (c->offset + len < c->file_size) {
+        posix_fadvise(c->fd, (off_t)(c->offset + len), (off_t)c->chunk_size, POSIX_FADV_WILLNEED);
+    }
+    return 1;
+}
+
+// The current chunk as an int array
+static inline const int *mapped_chunks_ints(const mapped_chunks_t *c, size_t *count) {
+    *count = c->size / sizeof(int);
+    return (const int *)c->data;
+}
+
+static inline void mapped_chunks_close(mapped_chunks_t *c) {
+    mapped_chunks_release(c);
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    c->fd = -1;
+}
+
+#endif // MAPPED_FILE_H
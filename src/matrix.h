@@ -0,0 +1,136 @@
+/**
+ * matrix.h - Contiguous 2D int matrix in a single aligned allocation
+ *
+ * The classic `int **matrix` (one malloc for the row pointers plus one per
+ * row) costs rows + 1 allocations, scatters rows across the heap and adds
+ * a pointer load to every access. matrix_t stores all rows back to back in
+ * one 64-byte-aligned buffer:
+ *
+ *     matrix_t m;
+ *     matrix_init(&m, rows, cols);        // one allocation, zero-filled
+ *     matrix_row(&m, i)[j] = 42;          // row view: reads like matrix[i][j]
+ *     MATRIX_VIEW(grid, &m);              // or a real 2D array view:
+ *     grid[i][j] = 42;                    //   exactly the int** syntax
+ *     matrix_free(&m);                    // one free
+ *
+ * Element (i, j) lives at data[i * stride + j]. The stride is cols rounded
+ * up to a whole number of cache lines, so every row starts on its own line
+ * (good for the SIMD kernels) at the cost of a few padding ints per row.
+ * Rows that would be an exact multiple of 4KB get one more line of padding
+ * so that columns do not all fall into the same cache set.
+ */
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Alignment of the buffer and of every row: one cache line
+#define MATRIX_ALIGNMENT 64
+
+typedef struct {
+    int *data;       // rows * stride ints, MATRIX_ALIGNMENT-aligned
+    size_t rows;
+    size_t cols;
+    size_t stride;   // Distance between rows, in ints (>= cols)
+    void *block;     // Start of the allocation (data rounded up from here)
+} matrix_t;
+
+// Ints per row for a given column count: whole cache lines, plus one extra
+// line whenever a row would be a multiple of 4KB. With a power-of-two row
+// size every element of a column maps to the same cache set, so walking a
+// column evicts itself after a handful of rows.
+static inline size_t matrix_stride_for(size_t cols) {
+    const size_t ints_per_line = MATRIX_ALIGNMENT / sizeof(int);
+    size_t stride = (cols + ints_per_line - 1) / ints_per_line * ints_per_line;
+    if (stride > 0 && (stride * sizeof(int)) % 4096 == 0) {
+        stride += ints_per_line;
+    }
+    return stride;
+}
+
+// Allocate a zero-filled rows x cols matrix. Returns 0 on success, -1 on
+// failure (m is then left empty).
+static inline int matrix_init(matrix_t *m, size_t rows, size_t cols) {
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = matrix_stride_for(cols);
+
+    // calloc gets large blocks straight from fresh zeroed pages without
+    // touching them, so a big matrix costs one mmap rather than a memset.
+    // The extra line leaves room to round data up to the alignment.
+    size_t bytes = rows * m->stride * sizeof(int);
+    m->block = bytes > 0 ? calloc(1, bytes + MATRIX_ALIGNMENT) : NULL;
+    if (m->block == NULL) {
+        m->data = NULL;
+        m->rows = m->cols = m->stride = 0;
+        return -1;
+    }
+    uintptr_t addr = ((uintptr_t)m->block + MATRIX_ALIGNMENT - 1) & ~(uintptr_t)(MATRIX_ALIGNMENT - 1);
+    m->data = (int *)addr;
+    return 0;
+}
+
+static inline void matrix_free(matrix_t *m) {
+    free(m->block);
+    m->block = NULL;
+    m->data = NULL;
+    m->rows = m->cols = m->stride = 0;
+}
+
+// Row i as a plain int array: matrix_row(m, i)[j] is element (i, j)
+static inline int *matrix_row(const matrix_t *m, size_t i) {
+    return m->data + i * m->stride;
+}
+
+// Element access without the row view
+static inline int *matrix_at(const matrix_t *m, size_t i, size_t j) {
+    return m->data + i * m->stride + j;
+}
+
+// Declare `name` as a pointer to rows of `stride` ints (a C99 variably
+// modified type), so name[i][j] compiles to data[i * stride + j] with no
+// row-pointer table at all.
+#define MATRIX_VIEW(name, m) \
+    int (*name)[(m)->stride] = (int (*)[(m)->stride])(m)->data
+
+// Visit every element, moving along rows (the memory order: sequential,
+// prefetch-friendly). Use as: MATRIX_FOR_EACH_ROW_MAJOR(&m, i, j) { ... }
+#define MATRIX_FOR_EACH_ROW_MAJOR(m, i, j) \
+    for (size_t i = 0; i < (m)->rows; i++) \
+        for (size_t j = 0; j < (m)->cols; j++)
+
+// Visit every element, moving down columns. Each step jumps `stride` ints,
+// so use this only when the algorithm needs column order.
+#define MATRIX_FOR_EACH_COL_MAJOR(m, i, j) \
+    for (size_t j = 0; j < (m)->cols; j++) \
+        for (size_t i = 0; i < (m)->rows; i++)
+
+// Sum of all elements in row-major order
+static inline long long matrix_sum_row_major(const matrix_t *m) {
+    long long sum = 0;
+    for (size_t i = 0; i < m->rows; i++) {
+        const int *row = matrix_row(m, i);
+        for (size_t j = 0; j < m->cols; j++) {
+            sum += row[j];
+        }
+    }
+    return sum;
+}
+
+// Sum of all elements in column-major order
+static inline long long matrix_sum_col_major(const matrix_t *m) {
+    long long sum = 0;
+    for (size_t j = 0; j < m->cols; j++) {
+        const int *p = m->data + j;
+        for (size_t i = 0; i < m->rows; i++) {
+            sum += p[i * m->stride];
+        }
+    }
+    return sum;
+}
+
+#endif // MATRIX_H
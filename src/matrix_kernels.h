@@ -0,0 +1,467 @@
+/**
+ * matrix_kernels.h - Cache-blocked transpose and multiply for matrix_t
+ *
+ * The textbook kernels walk one operand down its columns: a transpose
+ * reads along rows but writes down columns, and the i-j-k multiply reads
+ * b[k][j] with a stride of a whole row on every step. Once a matrix is
+ * larger than the cache, nearly every one of those accesses is a miss.
+ * This header provides:
+ *
+ * 1. naive     - the textbook loops, kept as the baseline
+ * 2. tiled     - the same work in blocks that fit in L1/L2. With AVX2 the
+ *                transpose moves 8x8 blocks through registers and the
+ *                multiply keeps a 4x16 block of c in registers; otherwise
+ *                the multiply runs in i-k-j order on array_kernels'
+ *                scale_add
+ * 3. recursive - cache-oblivious versions that halve the largest dimension
+ *                until the block fits, with no block size to tune
+ * 4. parallel  - the tiled kernels split into row bands across a
+ *                thread_pool_t with parallel_for (see parallel.h)
+ *
+ *     matrix_t a, b, c, at;
+ *     matrix_init(&a, n, k); matrix_init(&b, k, m);
+ *     matrix_init(&c, n, m); matrix_init(&at, k, n);
+ *     matrix_multiply_tiled(&c, &a, &b);            // c = a * b
+ *     matrix_transpose_parallel(&pool, &at, &a);    // at = a^T
+ *
+ * The destination must already have the result's shape and must not be
+ * one of the inputs; the kernels return -1 otherwise. Multiplication wraps
+ * on overflow like unsigned arithmetic, so every kernel gives the same
+ * result bit for bit.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see thread_pool.h).
+ */
+
+#ifndef MATRIX_KERNELS_H
+#define MATRIX_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "matrix.h"
+#include "array_kernels.h"
+#include "parallel.h"
+
+// Transpose tile edge, in ints. Source and destination tiles take 4KB
+// each, so both stay in L1 while the tile is written out.
+#define MATRIX_TRANSPOSE_BLOCK 32
+
+// Multiply blocking: a band of MATRIX_MULTIPLY_BLOCK_COLS columns of one
+// row of c (1KB) stays in L1 while MATRIX_MULTIPLY_BLOCK_DEPTH rows of b
+// are added into it; that block of b (128KB) stays in L2 for every row.
+#define MATRIX_MULTIPLY_BLOCK_COLS 256
+#define MATRIX_MULTIPLY_BLOCK_DEPTH 128
+
+// The recursive kernels stop splitting below these sizes, where the work
+// in a block outweighs the cost of the calls
+#define MATRIX_TRANSPOSE_LEAF 16
+#define MATRIX_MULTIPLY_LEAF 64
+
+// Parallel row bands are rounded up to a multiple of this many rows, so
+// that each band still covers whole tiles
+#define MATRIX_PARALLEL_MIN_ROWS 16
+
+// ---------------------------------------------------------------------------
+// Shape checks
+// ---------------------------------------------------------------------------
+
+static inline bool matrix_transpose_shape_ok(const matrix_t *dst, const matrix_t *src) {
+    return dst != src && (dst->data == NULL || dst->data != src->data) &&
+           dst->rows == src->cols && dst->cols == src->rows;
+}
+
+static inline bool matrix_multiply_shape_ok(const matrix_t *c, const matrix_t *a, const matrix_t *b) {
+    return c != a && c != b && (c->data == NULL || (c->data != a->data && c->data != b->data)) &&
+           a->cols == b->rows && c->rows == a->rows && c->cols == b->cols;
+}
+
+// Where the recursive kernels cut a side: the middle, rounded down to a
+// multiple of 16 so that the leaves stay whole 8x8 and 4x16 SIMD blocks
+static inline size_t matrix_split_point(size_t size) {
+    size_t half = size / 2;
+    return half > 16 ? half & ~(size_t)15 : half;
+}
+
+// ---------------------------------------------------------------------------
+// Transpose
+// ---------------------------------------------------------------------------
+
+// One block: dst[j][i] = src[i][j] for a rows x cols block of src
+static inline void matrix_transpose_block_scalar(int *dst, size_t ldd, const int *src, size_t lds,
+                                                 size_t rows, size_t cols) {
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            dst[j * ldd + i] = src[i * lds + j];
+        }
+    }
+}
+
+#ifdef ARRAY_KERNELS_X86
+// Transpose 8x8 ints in registers: interleave pairs of rows, then pairs
+// of pairs, then swap the 128-bit halves. Eight row loads and eight row
+// stores instead of 64 strided scalar stores.
+static inline ARRAY_AVX2 void matrix_transpose_8x8_avx2(int *dst, size_t ldd, const int *src, size_t lds) {
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)(src + 0 * lds));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(src + 1 * lds));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(src + 2 * lds));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(src + 3 * lds));
+    __m256i r4 = _mm256_loadu_si256((const __m256i *)(src + 4 * lds));
+    __m256i r5 = _mm256_loadu_si256((const __m256i *)(src + 5 * lds));
+    __m256i r6 = _mm256_loadu_si256((const __m256i *)(src + 6 * lds));
+    __m256i r7 = _mm256_loadu_si256((const __m256i *)(src + 7 * lds));
+
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    _mm256_storeu_si256((__m256i *)(dst + 0 * ldd), _mm256_permute2x128_si256(u0, u4, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 1 * ldd), _mm256_permute2x128_si256(u1, u5, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 2 * ldd), _mm256_permute2x128_si256(u2, u6, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 3 * ldd), _mm256_permute2x128_si256(u3, u7, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 4 * ldd), _mm256_permute2x128_si256(u0, u4, 0x31));
+    _mm256_storeu_si256((__m256i *)(dst + 5 * ldd), _mm256_permute2x128_si256(u1, u5, 0x31));
+    _mm256_storeu_si256((__m256i *)(dst + 6 * ldd), _mm256_permute2x128_si256(u2, u6, 0x31));
+    _mm256_storeu_si256((__m256i *)(dst + 7 * ldd), _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+
+// A block in 8x8 pieces, with scalar strips along the right and bottom
+static inline ARRAY_AVX2 void matrix_transpose_block_avx2(int *dst, size_t ldd, const int *src, size_t lds,
+                                                          size_t rows, size_t cols) {
+    size_t full_rows = rows & ~(size_t)7;
+    size_t full_cols = cols & ~(size_t)7;
+    for (size_t i = 0; i < full_rows; i += 8) {
+        for (size_t j = 0; j < full_cols; j += 8) {
+            matrix_transpose_8x8_avx2(dst + j * ldd + i, ldd, src + i * lds + j, lds);
+        }
+    }
+    matrix_transpose_block_scalar(dst + full_cols * ldd, ldd, src + full_cols, lds, rows, cols - full_cols);
+    matrix_transpose_block_scalar(dst + full_rows, ldd, src + full_rows * lds, lds, rows - full_rows, full_cols);
+}
+#endif
+
+typedef void (*matrix_transpose_block_fn)(int *dst, size_t ldd, const int *src, size_t lds,
+                                          size_t rows, size_t cols);
+
+// The best block transpose for this CPU, picked once like array_kernels()
+static inline matrix_transpose_block_fn matrix_transpose_block(void) {
+    static matrix_transpose_block_fn best = NULL;
+    matrix_transpose_block_fn fn = __atomic_load_n(&best, __ATOMIC_ACQUIRE);
+    if (fn == NULL) {
+        fn = matrix_transpose_block_scalar;
+#ifdef ARRAY_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            fn = matrix_transpose_block_avx2;
+        }
+#endif
+        __atomic_store_n(&best, fn, __ATOMIC_RELEASE);
+    }
+    return fn;
+}
+
+// Reads src along rows and writes dst down its columns, one element at a time
+static inline int matrix_transpose_naive(matrix_t *dst, const matrix_t *src) {
+    if (!matrix_transpose_shape_ok(dst, src)) {
+        return -1;
+    }
+    for (size_t i = 0; i < src->rows; i++) {
+        const int *row = matrix_row(src, i);
+        for (size_t j = 0; j < src->cols; j++) {
+            *matrix_at(dst, j, i) = row[j];
+        }
+    }
+    return 0;
+}
+
+// Write rows [begin, end) of dst (columns [begin, end) of src) tile by tile
+static inline void matrix_transpose_rows(matrix_t *dst, const matrix_t *src, size_t begin, size_t end) {
+    matrix_transpose_block_fn block = matrix_transpose_block();
+    for (size_t j = begin; j < end; j += MATRIX_TRANSPOSE_BLOCK) {
+        size_t cols = end - j < MATRIX_TRANSPOSE_BLOCK ? end - j : MATRIX_TRANSPOSE_BLOCK;
+        for (size_t i = 0; i < src->rows; i += MATRIX_TRANSPOSE_BLOCK) {
+            size_t rows = src->rows - i < MATRIX_TRANSPOSE_BLOCK ? src->rows - i : MATRIX_TRANSPOSE_BLOCK;
+            block(matrix_at(dst, j, i), dst->stride, matrix_at(src, i, j), src->stride, rows, cols);
+        }
+    }
+}
+
+static inline int matrix_transpose_tiled(matrix_t *dst, const matrix_t *src) {
+    if (!matrix_transpose_shape_ok(dst, src)) {
+        return -1;
+    }
+    matrix_transpose_rows(dst, src, 0, src->cols);
+    return 0;
+}
+
+static inline void matrix_transpose_split(matrix_transpose_block_fn block, int *dst, size_t ldd,
+                                          const int *src, size_t lds, size_t rows, size_t cols) {
+    if (rows <= MATRIX_TRANSPOSE_LEAF && cols <= MATRIX_TRANSPOSE_LEAF) {
+        block(dst, ldd, src, lds, rows, cols);
+    } else if (rows >= cols) {
+        size_t half = matrix_split_point(rows);
+        matrix_transpose_split(block, dst, ldd, src, lds, half, cols);
+        matrix_transpose_split(block, dst + half, ldd, src + half * lds, lds, rows - half, cols);
+    } else {
+        size_t half = matrix_split_point(cols);
+        matrix_transpose_split(block, dst, ldd, src, lds, rows, half);
+        matrix_transpose_split(block, dst + half * ldd, ldd, src + half, lds, rows, cols - half);
+    }
+}
+
+// Cache-oblivious: halve the longer side until the block is a leaf
+static inline int matrix_transpose_recursive(matrix_t *dst, const matrix_t *src) {
+    if (!matrix_transpose_shape_ok(dst, src)) {
+        return -1;
+    }
+    if (src->rows > 0 && src->cols > 0) {
+        matrix_transpose_split(matrix_transpose_block(), dst->data, dst->stride,
+                               src->data, src->stride, src->rows, src->cols);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Multiply
+// ---------------------------------------------------------------------------
+
+// The i-j-k triple loop: every step of the inner loop moves down a column of b
+static inline int matrix_multiply_naive(matrix_t *c, const matrix_t *a, const matrix_t *b) {
+    if (!matrix_multiply_shape_ok(c, a, b)) {
+        return -1;
+    }
+    for (size_t i = 0; i < a->rows; i++) {
+        const int *arow = matrix_row(a, i);
+        int *crow = matrix_row(c, i);
+        for (size_t j = 0; j < b->cols; j++) {
+            unsigned sum = 0;
+            for (size_t k = 0; k < a->cols; k++) {
+                sum += (unsigned)arow[k] * (unsigned)*matrix_at(b, k, j);
+            }
+            crow[j] = (int)sum;
+        }
+    }
+    return 0;
+}
+
+// One block: c[m x n] += a[m x p] * b[p x n], in i-k-j order. Each
+// scale_add adds a[i][k] times row k of b into row i of c: two sequential
+// reads and a sequential write, with whatever SIMD array_kernels() found.
+static inline void matrix_multiply_block_scale_add(int *c, size_t ldc, const int *a, size_t lda,
+                                                   const int *b, size_t ldb, size_t m, size_t p, size_t n) {
+    const array_kernels_t *kernels = array_kernels();
+    for (size_t i = 0; i < m; i++) {
+        for (size_t k = 0; k < p; k++) {
+            kernels->scale_add(c + i * ldc, b + k * ldb, a[i * lda + k], n);
+        }
+    }
+}
+
+#ifdef ARRAY_KERNELS_X86
+// The same block with four rows by sixteen columns of c held in eight
+// registers for the whole k loop. scale_add loads and stores its row of c
+// for every k; here each step only loads two vectors of b and multiplies
+// them by four broadcast elements of a. Leftover rows and columns go
+// through scale_add.
+static inline ARRAY_AVX2 void matrix_multiply_block_avx2(int *c, size_t ldc, const int *a, size_t lda,
+                                                         const int *b, size_t ldb, size_t m, size_t p, size_t n) {
+    size_t full_rows = m & ~(size_t)3;
+    size_t full_cols = n & ~(size_t)15;
+    for (size_t i = 0; i < full_rows; i += 4) {
+        const int *a0 = a + i * lda;
+        for (size_t j = 0; j < full_cols; j += 16) {
+            int *c0 = c + i * ldc + j;
+            __m256i c00 = _mm256_loadu_si256((const __m256i *)(c0));
+            __m256i c01 = _mm256_loadu_si256((const __m256i *)(c0 + 8));
+            __m256i c10 = _mm256_loadu_si256((const __m256i *)(c0 + ldc));
+            __m256i c11 = _mm256_loadu_si256((const __m256i *)(c0 + ldc + 8));
+            __m256i c20 = _mm256_loadu_si256((const __m256i *)(c0 + 2 * ldc));
+            __m256i c21 = _mm256_loadu_si256((const __m256i *)(c0 + 2 * ldc + 8));
+            __m256i c30 = _mm256_loadu_si256((const __m256i *)(c0 + 3 * ldc));
+            __m256i c31 = _mm256_loadu_si256((const __m256i *)(c0 + 3 * ldc + 8));
+            for (size_t k = 0; k < p; k++) {
+                const int *bk = b + k * ldb + j;
+                __m256i b0 = _mm256_loadu_si256((const __m256i *)bk);
+                __m256i b1 = _mm256_loadu_si256((const __m256i *)(bk + 8));
+                __m256i x = _mm256_set1_epi32(a0[k]);
+                c00 = _mm256_add_epi32(c00, _mm256_mullo_epi32(x, b0));
+                c01 = _mm256_add_epi32(c01, _mm256_mullo_epi32(x, b1));
+                x = _mm256_set1_epi32(a0[lda + k]);
+                c10 = _mm256_add_epi32(c10, _mm256_mullo_epi32(x, b0));
+                c11 = _mm256_add_epi32(c11, _mm256_mullo_epi32(x, b1));
+                x = _mm256_set1_epi32(a0[2 * lda + k]);
+                c20 = _mm256_add_epi32(c20, _mm256_mullo_epi32(x, b0));
+                c21 = _mm256_add_epi32(c21, _mm256_mullo_epi32(x, b1));
+                x = _mm256_set1_epi32(a0[3 * lda + k]);
+                c30 = _mm256_add_epi32(c30, _mm256_mullo_epi32(x, b0));
+                c31 = _mm256_add_epi32(c31, _mm256_mullo_epi32(x, b1));
+            }
+            _mm256_storeu_si256((__m256i *)(c0), c00);
+            _mm256_storeu_si256((__m256i *)(c0 + 8), c01);
+            _mm256_storeu_si256((__m256i *)(c0 + ldc), c10);
+            _mm256_storeu_si256((__m256i *)(c0 + ldc + 8), c11);
+            _mm256_storeu_si256((__m256i *)(c0 + 2 * ldc), c20);
+            _mm256_storeu_si256((__m256i *)(c0 + 2 * ldc + 8), c21);
+            _mm256_storeu_si256((__m256i *)(c0 + 3 * ldc), c30);
+            _mm256_storeu_si256((__m256i *)(c0 + 3 * ldc + 8), c31);
+        }
+    }
+    matrix_multiply_block_scale_add(c + full_cols, ldc, a, lda, b + full_cols, ldb, full_rows, p, n - full_cols);
+    matrix_multiply_block_scale_add(c + full_rows * ldc, ldc, a + full_rows * lda, lda, b, ldb,
+                                    m - full_rows, p, n);
+}
+#endif
+
+typedef void (*matrix_multiply_block_fn)(int *c, size_t ldc, const int *a, size_t lda,
+                                         const int *b, size_t ldb, size_t m, size_t p, size_t n);
+
+// The best block multiply for this CPU, picked once
+static inline matrix_multiply_block_fn matrix_multiply_block(void) {
+    static matrix_multiply_block_fn best = NULL;
+    matrix_multiply_block_fn fn = __atomic_load_n(&best, __ATOMIC_ACQUIRE);
+    if (fn == NULL) {
+        fn = matrix_multiply_block_scale_add;
+#ifdef ARRAY_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            fn = matrix_multiply_block_avx2;
+        }
+#endif
+        __atomic_store_n(&best, fn, __ATOMIC_RELEASE);
+    }
+    return fn;
+}
+
+// Compute rows [begin, end) of c block by block: MATRIX_MULTIPLY_BLOCK_DEPTH
+// rows by MATRIX_MULTIPLY_BLOCK_COLS columns of b stay in L2 while every
+// row of the band passes over them
+static inline void matrix_multiply_rows(matrix_multiply_block_fn block, matrix_t *c, const matrix_t *a,
+                                        const matrix_t *b, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        memset(matrix_row(c, i), 0, c->cols * sizeof(int));
+    }
+    for (size_t kk = 0; kk < a->cols; kk += MATRIX_MULTIPLY_BLOCK_DEPTH) {
+        size_t depth = a->cols - kk < MATRIX_MULTIPLY_BLOCK_DEPTH ? a->cols - kk : MATRIX_MULTIPLY_BLOCK_DEPTH;
+        for (size_t jj = 0; jj < b->cols; jj += MATRIX_MULTIPLY_BLOCK_COLS) {
+            size_t width = b->cols - jj < MATRIX_MULTIPLY_BLOCK_COLS ? b->cols - jj : MATRIX_MULTIPLY_BLOCK_COLS;
+            block(matrix_at(c, begin, jj), c->stride, matrix_at(a, begin, kk), a->stride,
+                  matrix_at(b, kk, jj), b->stride, end - begin, depth, width);
+        }
+    }
+}
+
+// Blocked multiply with a chosen block kernel (for comparing them)
+static inline int matrix_multiply_tiled_with(matrix_multiply_block_fn block, matrix_t *c,
+                                             const matrix_t *a, const matrix_t *b) {
+    if (!matrix_multiply_shape_ok(c, a, b)) {
+        return -1;
+    }
+    matrix_multiply_rows(block, c, a, b, 0, a->rows);
+    return 0;
+}
+
+static inline int matrix_multiply_tiled(matrix_t *c, const matrix_t *a, const matrix_t *b) {
+    return matrix_multiply_tiled_with(matrix_multiply_block(), c, a, b);
+}
+
+// c[m x n] += a[m x p] * b[p x n], halving the largest of the three sizes.
+// Splitting p gives two products that add into the same block of c.
+static inline void matrix_multiply_split(matrix_multiply_block_fn block, int *c, size_t ldc,
+                                         const int *a, size_t lda, const int *b, size_t ldb,
+                                         size_t m, size_t p, size_t n) {
+    if (m <= MATRIX_MULTIPLY_LEAF && p <= MATRIX_MULTIPLY_LEAF && n <= MATRIX_MULTIPLY_LEAF) {
+        block(c, ldc, a, lda, b, ldb, m, p, n);
+    } else if (m >= p && m >= n) {
+        size_t half = matrix_split_point(m);
+        matrix_multiply_split(block, c, ldc, a, lda, b, ldb, half, p, n);
+        matrix_multiply_split(block, c + half * ldc, ldc, a + half * lda, lda, b, ldb, m - half, p, n);
+    } else if (n >= p) {
+        size_t half = matrix_split_point(n);
+        matrix_multiply_split(block, c, ldc, a, lda, b, ldb, m, p, half);
+        matrix_multiply_split(block, c + half, ldc, a, lda, b + half, ldb, m, p, n - half);
+    } else {
+        size_t half = matrix_split_point(p);
+        matrix_multiply_split(block, c, ldc, a, lda, b, ldb, m, half, n);
+        matrix_multiply_split(block, c, ldc, a + half, lda, b + half * ldb, ldb, m, p - half, n);
+    }
+}
+
+// Cache-oblivious multiply
+static inline int matrix_multiply_recursive(matrix_t *c, const matrix_t *a, const matrix_t *b) {
+    if (!matrix_multiply_shape_ok(c, a, b)) {
+        return -1;
+    }
+    for (size_t i = 0; i < c->rows; i++) {
+        memset(matrix_row(c, i), 0, c->cols * sizeof(int));
+    }
+    if (a->rows > 0 && a->cols > 0 && b->cols > 0) {
+        matrix_multiply_split(matrix_multiply_block(), c->data, c->stride, a->data, a->stride,
+                              b->data, b->stride, a->rows, a->cols, b->cols);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Parallel versions
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    matrix_t *dst;
+    const matrix_t *a;
+    const matrix_t *b;   // NULL for a transpose
+    matrix_multiply_block_fn block;
+} matrix_bands_t;
+
+static inline void matrix_band(size_t begin, size_t end, void *ctx) {
+    matrix_bands_t *bands = (matrix_bands_t *)ctx;
+    if (bands->b == NULL) {
+        matrix_transpose_rows(bands->dst, bands->a, begin, end);
+    } else {
+        matrix_multiply_rows(bands->block, bands->dst, bands->a, bands->b, begin, end);
+    }
+}
+
+// Split the rows of dst into bands, about PARALLEL_CHUNKS_PER_THREAD per
+// thread and rounded to whole tiles, and run them with parallel_for
+static inline int matrix_run_bands(thread_pool_t *pool, matrix_t *dst, const matrix_t *a, const matrix_t *b) {
+    size_t band = parallel_auto_grain(pool, dst->rows);
+    band = (band + MATRIX_PARALLEL_MIN_ROWS - 1) / MATRIX_PARALLEL_MIN_ROWS * MATRIX_PARALLEL_MIN_ROWS;
+    // Run the CPU checks once, before the tasks start
+    matrix_bands_t bands = {dst, a, b, matrix_multiply_block()};
+    matrix_transpose_block();
+    parallel_for(pool, 0, dst->rows, band, matrix_band, &bands);
+    return 0;
+}
+
+static inline int matrix_transpose_parallel(thread_pool_t *pool, matrix_t *dst, const matrix_t *src) {
+    if (!matrix_transpose_shape_ok(dst, src)) {
+        return -1;
+    }
+    return matrix_run_bands(pool, dst, src, NULL);
+}
+
+static inline int matrix_multiply_parallel(thread_pool_t *pool, matrix_t *c, const matrix_t *a,
+                                           const matrix_t *b) {
+    if (!matrix_multiply_shape_ok(c, a, b)) {
+        return -1;
+    }
+    return matrix_run_bands(pool, c, a, b);
+}
+
+#endif // MATRIX_KERNELS_H
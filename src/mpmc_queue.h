@@ -0,0 +1,328 @@
+/**
+ * mpmc_queue.h - Bounded lock-free queues for handing work between threads
+ *
+ * This header provides:
+ * 1. mpmc_queue_t - multi-producer/multi-consumer ring buffer (Dmitry
+ *                   Vyukov's design with a sequence number per slot)
+ * 2. spsc_queue_t - single-producer/single-consumer ring buffer, for the
+ *                   common case of a fixed pipeline stage
+ *
+ * Both queues move `void*` items, like the void pointer examples, and
+ * both have batch variants so a producer or consumer can move many items
+ * for roughly the cost of one:
+ *
+ *     mpmc_queue_t q;
+ *     mpmc_queue_init(&q, 1024);                 // capacity: power of two
+ *     mpmc_queue_enqueue(&q, item);              // false when full
+ *     mpmc_queue_dequeue(&q, &item);             // false when empty
+ *     mpmc_queue_enqueue_batch(&q, items, n);    // returns how many went in
+ *     mpmc_queue_dequeue_batch(&q, items, n);    // returns how many came out
+ *     mpmc_queue_destroy(&q);
+ *
+ * Nothing here blocks: full and empty are reported to the caller, who
+ * decides whether to spin, yield or do something else.
+ */
+
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+
+// Round a requested capacity up to a power of two (minimum 2)
+static inline size_t queue_round_capacity(size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// mpmc_queue_t: Vyukov bounded MPMC queue
+// ---------------------------------------------------------------------------
+
+// Every slot carries a sequence number that says whose turn it is:
+//   seq == pos      slot is free for the producer that claims position pos
+//   seq == pos + 1  slot holds the item for the consumer at position pos
+// After consuming, the consumer sets seq = pos + capacity, making the slot
+// free for the producer one lap later. Producers and consumers only
+// contend on their own position counter; a slot hand-off is a plain
+// release store answered by an acquire load.
+typedef struct {
+    size_t seq;
+    void *data;
+} mpmc_cell_t;
+
+typedef struct {
+    mpmc_cell_t *cells;
+    size_t mask;                                     // capacity - 1
+    _Alignas(CACHE_LINE_SIZE) size_t enqueue_pos;    // Next position to produce
+    _Alignas(CACHE_LINE_SIZE) size_t dequeue_pos;    // Next position to consume
+} mpmc_queue_t;
+
+// Allocate a queue holding at least `capacity` items. Returns 0 on
+// success, -1 if allocation fails.
+static inline int mpmc_queue_init(mpmc_queue_t *q, size_t capacity) {
+    size_t n = queue_round_capacity(capacity);
+    q->cells = (mpmc_cell_t *)malloc(n * sizeof(mpmc_cell_t));
+    if (q->cells == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        q->cells[i].seq = i;
+        q->cells[i].data = NULL;
+    }
+    q->mask = n - 1;
+    q->enqueue_pos = 0;
+    q->dequeue_pos = 0;
+    return 0;
+}
+
+static inline void mpmc_queue_destroy(mpmc_queue_t *q) {
+    free(q->cells);
+    q->cells = NULL;
+}
+
+static inline size_t mpmc_queue_capacity(const mpmc_queue_t *q) {
+    return q->mask + 1;
+}
+
+// Add one item. Returns false if the queue is full.
+static inline bool mpmc_queue_enqueue(mpmc_queue_t *q, void *item) {
+    size_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+
+    while (true) {
+        mpmc_cell_t *cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            // Slot is free for this position: try to claim it
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->data = item;
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            // CAS failure reloaded pos; try again
+        } else if (diff < 0) {
+            return false; // Consumer a lap behind has not emptied this slot
+        } else {
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Remove one item. Returns false if the queue is empty.
+static inline bool mpmc_queue_dequeue(mpmc_queue_t *q, void **item) {
+    size_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+
+    while (true) {
+        mpmc_cell_t *cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *item = cell->data;
+                __atomic_store_n(&cell->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // Producer has not filled this slot yet
+        } else {
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Add up to n items with a single CAS on enqueue_pos. Returns how many
+// were added (0 when full); items[0..result) went in, in order.
+static inline size_t mpmc_queue_enqueue_batch(mpmc_queue_t *q, void *const *items, size_t n) {
+    size_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+
+    while (true) {
+        // Count how many consecutive slots starting at pos are free
+        size_t k = 0;
+        while (k < n) {
+            size_t seq = __atomic_load_n(&q->cells[(pos + k) & q->mask].seq, __ATOMIC_ACQUIRE);
+            if (seq != pos + k) {
+                break;
+            }
+            k++;
+        }
+
+        if (k == 0) {
+            size_t seq = __atomic_load_n(&q->cells[pos & q->mask].seq, __ATOMIC_ACQUIRE);
+            if ((intptr_t)seq - (intptr_t)pos < 0) {
+                return 0; // Full
+            }
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        // Claim all k positions at once. Only the winner of this CAS may
+        // write them, so the slots we saw as free stay free until we fill them.
+        if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + k, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            for (size_t i = 0; i < k; i++) {
+                mpmc_cell_t *cell = &q->cells[(pos + i) & q->mask];
+                cell->data = items[i];
+                __atomic_store_n(&cell->seq, pos + i + 1, __ATOMIC_RELEASE);
+            }
+            return k;
+        }
+    }
+}
+
+// Remove up to n items with a single CAS on dequeue_pos. Returns how many
+// were removed (0 when empty).
+static inline size_t mpmc_queue_dequeue_batch(mpmc_queue_t *q, void **items, size_t n) {
+    size_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+
+    while (true) {
+        size_t k = 0;
+        while (k < n) {
+            size_t seq = __atomic_load_n(&q->cells[(pos + k) & q->mask].seq, __ATOMIC_ACQUIRE);
+            if (seq != pos + k + 1) {
+                break;
+            }
+            k++;
+        }
+
+        if (k == 0) {
+            size_t seq = __atomic_load_n(&q->cells[pos & q->mask].seq, __ATOMIC_ACQUIRE);
+            if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+                return 0; // Empty
+            }
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + k, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            for (size_t i = 0; i < k; i++) {
+                mpmc_cell_t *cell = &q->cells[(pos + i) & q->mask];
+                items[i] = cell->data;
+                __atomic_store_n(&cell->seq, pos + i + q->mask + 1, __ATOMIC_RELEASE);
+            }
+            return k;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// spsc_queue_t: single-producer/single-consumer ring buffer
+// ---------------------------------------------------------------------------
+
+// With one producer and one consumer no CAS is needed at all: the producer
+// alone writes `tail`, the consumer alone writes `head`. Each side also
+// keeps a private copy of the other side's index and only re-reads the
+// shared one when the copy says full (or empty), so in the steady state
+// neither side touches the other's cache line.
+typedef struct {
+    void **slots;
+    size_t mask;
+    _Alignas(CACHE_LINE_SIZE) size_t tail;        // Written by the producer
+    size_t cached_head;                           // Producer's view of head
+    _Alignas(CACHE_LINE_SIZE) size_t head;        // Written by the consumer
+    size_t cached_tail;                           // Consumer's view of tail
+} spsc_queue_t;
+
+static inline int spsc_queue_init(spsc_queue_t *q, size_t capacity) {
+    size_t n = queue_round_capacity(capacity);
+    q->slots = (void **)calloc(n, sizeof(void *));
+    if (q->slots == NULL) {
+        return -1;
+    }
+    q->mask = n - 1;
+    q->tail = 0;
+    q->cached_head = 0;
+    q->head = 0;
+    q->cached_tail = 0;
+    return 0;
+}
+
+static inline void spsc_queue_destroy(spsc_queue_t *q) {
+    free(q->slots);
+    q->slots = NULL;
+}
+
+// Free slots as seen by the producer, refreshing its view of head only
+// when the cached one is not enough for `want` items
+static inline size_t spsc_queue_free_slots(spsc_queue_t *q, size_t want) {
+    size_t free_slots = q->mask + 1 - (q->tail - q->cached_head);
+    if (free_slots < want) {
+        q->cached_head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+        free_slots = q->mask + 1 - (q->tail - q->cached_head);
+    }
+    return free_slots;
+}
+
+// Items available as seen by the consumer
+static inline size_t spsc_queue_used_slots(spsc_queue_t *q, size_t want) {
+    size_t used = q->cached_tail - q->head;
+    if (used < want) {
+        q->cached_tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+        used = q->cached_tail - q->head;
+    }
+    return used;
+}
+
+// Producer only. Returns false if full.
+static inline bool spsc_queue_enqueue(spsc_queue_t *q, void *item) {
+    if (spsc_queue_free_slots(q, 1) == 0) {
+        return false;
+    }
+    q->slots[q->tail & q->mask] = item;
+    __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Consumer only. Returns false if empty.
+static inline bool spsc_queue_dequeue(spsc_queue_t *q, void **item) {
+    if (spsc_queue_used_slots(q, 1) == 0) {
+        return false;
+    }
+    *item = q->slots[q->head & q->mask];
+    __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Producer only: add up to n items and publish them with one store
+static inline size_t spsc_queue_enqueue_batch(spsc_queue_t *q, void *const *items, size_t n) {
+    size_t k = spsc_queue_free_slots(q, n);
+    if (k > n) {
+        k = n;
+    }
+    for (size_t i = 0; i < k; i++) {
+        q->slots[(q->tail + i) & q->mask] = items[i];
+    }
+    if (k > 0) {
+        __atomic_store_n(&q->tail, q->tail + k, __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+// Consumer only: remove up to n items and free their slots with one store
+static inline size_t spsc_queue_dequeue_batch(spsc_queue_t *q, void **items, size_t n) {
+    size_t k = spsc_queue_used_slots(q, n);
+    if (k > n) {
+        k = n;
+    }
+    for (size_t i = 0; i < k; i++) {
+        items[i] = q->slots[(q->head + i) & q->mask];
+    }
+    if (k > 0) {
+        __atomic_store_n(&q->head, q->head + k, __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+#endif // MPMC_QUEUE_H
@@ -0,0 +1,319 @@
+/**
+ * parallel.h - Data-parallel loops and reductions on a thread_pool_t
+ *
+ * thread_pool_submit runs whole tasks; splitting one big loop into tasks by
+ * hand means picking chunk sizes, counting finished chunks and merging
+ * results under a lock. This header does that once:
+ *
+ *     // fn(begin, end, ctx) is called on disjoint pieces of [0, n)
+ *     parallel_for(&pool, 0, n, 0, scale_range, &args);      // grain 0: automatic
+ *
+ *     // fn(begin, end, partial, ctx) folds a piece into `partial`
+ *     long long total = 0;                                    // identity in, result out
+ *     parallel_reduce(&pool, 0, n, 0, &total, sizeof(total), sum_range, add_sums, a);
+ *
+ *     long long sum = parallel_array_sum(&pool, numbers, count);
+ *
+ * How a call runs:
+ * 1. [begin, end) is cut into chunks of `grain` iterations. Grain 0 picks
+ *    about PARALLEL_CHUNKS_PER_THREAD chunks per thread, so a thread that
+ *    gets descheduled holds up only a small part of the range. A range
+ *    that fits in one chunk runs inline on the calling thread.
+ * 2. Up to one helper task per worker is submitted. The helpers and the
+ *    calling thread claim chunks with one fetch_add each, so faster
+ *    threads simply claim more of them.
+ * 3. For parallel_reduce, every participating thread folds its chunks
+ *    into its own cache-line-aligned partial result, and the caller
+ *    combines the partials at the end: no lock and no shared accumulator.
+ *    The combine function must be associative and commutative, since
+ *    which chunks land in which partial depends on timing.
+ * 4. The caller waits for its own helpers only, running other pool tasks
+ *    meanwhile, so calls may nest inside pool tasks.
+ *
+ * parallel_array_sum, parallel_array_minmax and parallel_array_fill run
+ * the array_kernels.h kernels this way, with chunks of at least
+ * PARALLEL_ARRAY_MIN_GRAIN elements.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see thread_pool.h).
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#include "cpu.h"
+#include "futex.h"
+#include "thread_pool.h"
+#include "array_kernels.h"
+
+// Chunks per participating thread when the grain is picked automatically
+#define PARALLEL_CHUNKS_PER_THREAD 4
+
+// Smallest chunk the array wrappers hand out, in elements (256KB of ints):
+// below this, waking a worker costs more than it saves
+#define PARALLEL_ARRAY_MIN_GRAIN 65536
+
+typedef void (*parallel_for_fn)(size_t begin, size_t end, void *ctx);
+typedef void (*parallel_reduce_fn)(size_t begin, size_t end, void *partial, void *ctx);
+typedef void (*parallel_combine_fn)(void *into, const void *from, void *ctx);
+
+// One parallel_for or parallel_reduce call, shared by the caller and its
+// helpers. It lives on the caller's stack until every helper has finished.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) size_t next_chunk;  // First chunk nobody has claimed
+    _Alignas(CACHE_LINE_SIZE) uint32_t active;    // Helpers submitted but not finished
+    uint32_t joined;                              // Threads that took a partial slot
+    size_t begin;
+    size_t end;
+    size_t grain;
+    size_t chunks;
+    parallel_for_fn for_fn;        // Exactly one of for_fn and reduce_fn is set
+    parallel_reduce_fn reduce_fn;
+    void *ctx;
+    unsigned char *partials;       // One slot of partial_stride bytes per thread
+    size_t partial_stride;
+} parallel_job_t;
+
+// Grain for `n` iterations giving about PARALLEL_CHUNKS_PER_THREAD chunks
+// to each worker and to the calling thread
+static inline size_t parallel_auto_grain(const thread_pool_t *pool, size_t n) {
+    size_t target = ((size_t)pool->num_workers + 1) * PARALLEL_CHUNKS_PER_THREAD;
+    size_t grain = (n + target - 1) / target;
+    return grain > 0 ? grain : 1;
+}
+
+// Claim chunks until none are left
+static inline void parallel_job_run(parallel_job_t *job) {
+    void *partial = NULL;
+    if (job->reduce_fn != NULL) {
+        uint32_t slot = __atomic_fetch_add(&job->joined, 1, __ATOMIC_RELAXED);
+        partial = job->partials + (size_t)slot * job->partial_stride;
+    }
+    while (true) {
+        size_t chunk = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+        if (chunk >= job->chunks) {
+            return;
+        }
+        size_t begin = job->begin + chunk * job->grain;
+        size_t end = job->end - begin > job->grain ? begin + job->grain : job->end;
+        if (job->reduce_fn != NULL) {
+            job->reduce_fn(begin, end, partial, job->ctx);
+        } else {
+            job->for_fn(begin, end, job->ctx);
+        }
+    }
+}
+
+// The last helper to finish wakes the caller. The caller may return as soon
+// as it sees `active` reach zero, so the wake can land on a dead stack
+// frame; futex_wake only uses the address, so that is harmless.
+static inline void *parallel_helper(void *arg) {
+    parallel_job_t *job = (parallel_job_t *)arg;
+    parallel_job_run(job);
+    if (__atomic_sub_fetch(&job->active, 1, __ATOMIC_ACQ_REL) == 0) {
+        futex_wake(&job->active, 1);
+    }
+    return NULL;
+}
+
+// Submit `helpers` helper tasks, work on the job from this thread, then
+// wait for the helpers, running other pool tasks while they finish
+static inline void parallel_job_execute(thread_pool_t *pool, parallel_job_t *job, size_t helpers) {
+    job->active = 0;
+    for (size_t i = 0; i < helpers; i++) {
+        __atomic_fetch_add(&job->active, 1, __ATOMIC_RELAXED);
+        if (thread_pool_submit(pool, parallel_helper, job) != 0) {
+            __atomic_fetch_sub(&job->active, 1, __ATOMIC_RELAXED);
+            break; // Fewer helpers is still correct
+        }
+    }
+
+    parallel_job_run(job);
+
+    thread_pool_worker_t *self = thread_pool_current_worker;
+    if (self != NULL && self->pool != pool) {
+        self = NULL;
+    }
+    unsigned int idle = 0;
+    uint32_t active;
+    while ((active = __atomic_load_n(&job->active, __ATOMIC_ACQUIRE)) != 0) {
+        thread_pool_task_t task;
+        if (thread_pool_find_task(pool, self, &task)) {
+            thread_pool_run_task(pool, task); // Often one of our own helpers
+            idle = 0;
+        } else if (++idle < THREAD_POOL_IDLE_SPINS) {
+            cpu_relax();
+        } else {
+            futex_wait(&job->active, active);
+            idle = 0;
+        }
+    }
+}
+
+static inline void parallel_job_init(parallel_job_t *job, thread_pool_t *pool, size_t begin, size_t end,
+                                     size_t grain) {
+    memset(job, 0, sizeof(*job));
+    job->begin = begin;
+    job->end = end;
+    job->grain = grain > 0 ? grain : parallel_auto_grain(pool, end - begin);
+    job->chunks = (end - begin) / job->grain + ((end - begin) % job->grain != 0);
+}
+
+// Threads that will help: one per worker, but never more than there are
+// chunks for
+static inline size_t parallel_job_helpers(const thread_pool_t *pool, const parallel_job_t *job) {
+    size_t workers = (size_t)pool->num_workers;
+    return job->chunks - 1 < workers ? job->chunks - 1 : workers;
+}
+
+// ---------------------------------------------------------------------------
+// parallel_for / parallel_reduce
+// ---------------------------------------------------------------------------
+
+// Call fn on disjoint pieces of [begin, end) that together cover it, in
+// parallel. Pieces have `grain` iterations (0: automatic) except the last.
+static inline void parallel_for(thread_pool_t *pool, size_t begin, size_t end, size_t grain,
+                                parallel_for_fn fn, void *ctx) {
+    if (end <= begin) {
+        return;
+    }
+    parallel_job_t job;
+    parallel_job_init(&job, pool, begin, end, grain);
+    if (job.chunks == 1) {
+        fn(begin, end, ctx);
+        return;
+    }
+    job.for_fn = fn;
+    job.ctx = ctx;
+    parallel_job_execute(pool, &job, parallel_job_helpers(pool, &job));
+}
+
+// Reduce [begin, end) into `result`, a `size`-byte value that holds the
+// identity on entry (0 for a sum, INT_MAX for a minimum, ...). Every
+// thread starts its partial from that identity and folds pieces into it
+// with fn; combine(result, partial) then merges the partials. If the
+// partials cannot be allocated the whole range is folded on this thread.
+static inline void parallel_reduce(thread_pool_t *pool, size_t begin, size_t end, size_t grain,
+                                   void *result, size_t size, parallel_reduce_fn fn,
+                                   parallel_combine_fn combine, void *ctx) {
+    if (end <= begin) {
+        return;
+    }
+    parallel_job_t job;
+    parallel_job_init(&job, pool, begin, end, grain);
+    size_t helpers = parallel_job_helpers(pool, &job);
+    size_t stride = (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    unsigned char *partials = job.chunks > 1 && stride > 0
+        ? (unsigned char *)aligned_alloc(CACHE_LINE_SIZE, (helpers + 1) * stride)
+        : NULL;
+    if (partials == NULL) {
+        fn(begin, end, result, ctx);
+        return;
+    }
+    for (size_t i = 0; i <= helpers; i++) {
+        memcpy(partials + i * stride, result, size);
+    }
+    job.reduce_fn = fn;
+    job.ctx = ctx;
+    job.partials = partials;
+    job.partial_stride = stride;
+    parallel_job_execute(pool, &job, helpers);
+
+    // Only threads that joined have touched their partial
+    for (uint32_t i = 0; i < job.joined; i++) {
+        combine(result, partials + (size_t)i * stride, ctx);
+    }
+    free(partials);
+}
+
+// ---------------------------------------------------------------------------
+// Array kernels on top of parallel_for / parallel_reduce
+// ---------------------------------------------------------------------------
+
+static inline size_t parallel_array_grain(const thread_pool_t *pool, size_t n) {
+    size_t grain = parallel_auto_grain(pool, n);
+    return grain > PARALLEL_ARRAY_MIN_GRAIN ? grain : PARALLEL_ARRAY_MIN_GRAIN;
+}
+
+typedef struct {
+    const array_kernels_t *kernels;
+    const int *src;
+    int *dst;
+    int value;
+} parallel_array_args_t;
+
+typedef struct {
+    int min;
+    int max;
+} parallel_minmax_t;
+
+static inline void parallel_minmax_merge(parallel_minmax_t *into, int min, int max) {
+    if (min < into->min) {
+        into->min = min;
+    }
+    if (max > into->max) {
+        into->max = max;
+    }
+}
+
+static inline void parallel_array_sum_range(size_t begin, size_t end, void *partial, void *ctx) {
+    parallel_array_args_t *args = (parallel_array_args_t *)ctx;
+    *(long long *)partial += args->kernels->sum(args->src + begin, end - begin);
+}
+
+static inline void parallel_array_sum_combine(void *into, const void *from, void *ctx) {
+    (void)ctx;
+    *(long long *)into += *(const long long *)from;
+}
+
+static inline void parallel_array_minmax_range(size_t begin, size_t end, void *partial, void *ctx) {
+    parallel_array_args_t *args = (parallel_array_args_t *)ctx;
+    int lo, hi;
+    args->kernels->minmax(args->src + begin, end - begin, &lo, &hi);
+    parallel_minmax_merge((parallel_minmax_t *)partial, lo, hi);
+}
+
+static inline void parallel_array_minmax_combine(void *into, const void *from, void *ctx) {
+    (void)ctx;
+    const parallel_minmax_t *p = (const parallel_minmax_t *)from;
+    parallel_minmax_merge((parallel_minmax_t *)into, p->min, p->max);
+}
+
+static inline void parallel_array_fill_range(size_t begin, size_t end, void *ctx) {
+    parallel_array_args_t *args = (parallel_array_args_t *)ctx;
+    args->kernels->fill(args->dst + begin, args->value, end - begin);
+}
+
+// 64-bit sum of a[0..n), like array_sum
+static inline long long parallel_array_sum(thread_pool_t *pool, const int *a, size_t n) {
+    parallel_array_args_t args = {array_kernels(), a, NULL, 0};
+    long long sum = 0;
+    parallel_reduce(pool, 0, n, parallel_array_grain(pool, n), &sum, sizeof(sum),
+                    parallel_array_sum_range, parallel_array_sum_combine, &args);
+    return sum;
+}
+
+// Smallest and largest element, like array_minmax (INT_MAX and INT_MIN
+// for an empty array)
+static inline void parallel_array_minmax(thread_pool_t *pool, const int *a, size_t n, int *min, int *max) {
+    parallel_array_args_t args = {array_kernels(), a, NULL, 0};
+    parallel_minmax_t result = {INT_MAX, INT_MIN};
+    parallel_reduce(pool, 0, n, parallel_array_grain(pool, n), &result, sizeof(result),
+                    parallel_array_minmax_range, parallel_array_minmax_combine, &args);
+    *min = result.min;
+    *max = result.max;
+}
+
+// Set dst[0..n) to value, like array_fill
+static inline void parallel_array_fill(thread_pool_t *pool, int *dst, int value, size_t n) {
+    parallel_array_args_t args = {array_kernels(), NULL, dst, value};
+    parallel_for(pool, 0, n, parallel_array_grain(pool, n), parallel_array_fill_range, &args);
+}
+
+#endif // PARALLEL_H
@@ -9,12 +9,27 @@
  * 5. Array-pointer relationship
  * 6. Const pointers vs pointers to const
  * 7. Void pointers and type casting
+ * 8. Files mapped into memory and used as arrays and matrices
  */
 
+#define _GNU_SOURCE // For mmap flags and mkstemp under -std=c11
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "matrix.h" // Contiguous alternative to the int** matrix
+#include "arena.h"  // Bump-pointer allocation for same-lifetime data
+#include "array_kernels.h" // SIMD versions of the array walks and calculate_batch
+#include "expr_vm.h"        // Bytecode for chains of operations
+#include "calculate.h"      // Inline versions of add, subtract, ...
+#include "vector.h"         // Typed growable arrays
+#include "sso_string.h"     // Length-prefixed strings with inline storage
+#include "mapped_file.h"    // Zero-copy views of files
+
+// A growable int array type: int_vector_t, int_vector_push(), ...
+VECTOR_DECLARE(int_vector, int)
+
 // Function prototypes for function pointer examples
 int add(int a, int b);
 int subtract(int a, int b);
@@ -24,6 +39,9 @@ int divide(int a, int b);
 // Function that takes a function pointer as an argument
 int calculate(int (*operation)(int, int), int a, int b);
 
+// Apply an operation to whole arrays: out[i] = operation(a[i], b[i])
+void calculate_batch(int (*operation)(int, int), const int *a, const int *b, int *out, size_t n);
+
 void basic_pointer_examples() {
     printf("\n=== Basic Pointer Examples ===\n");
     
@@ -79,6 +97,12 @@ void pointer_arithmetic_examples() {
     // DANGER: Going beyond array bounds - undefined behavior!
     printf("Accessing beyond array bounds would be dangerous if uncommented\n");
     // printf("Beyond array bounds: %d\n", *(ptr + 10));  // Undefined behavior!
+
+    // The same walks, several elements per instruction
+    int lo, hi;
+    array_minmax(numbers, 5, &lo, &hi);
+    printf("Bulk kernels (%s): sum = %lld, min = %d, max = %d, index of 40 = %zu\n",
+           array_kernels()->name, array_sum(numbers, 5), lo, hi, array_find(numbers, 5, 40));
 }
 
 void pointer_to_pointer_examples() {
@@ -125,6 +149,42 @@ void pointer_to_pointer_examples() {
         free(matrix[i]);
     }
     free(matrix);
+    
+    // Same matrix in one contiguous block: one allocation, no row pointers
+    matrix_t contiguous;
+    if (matrix_init(&contiguous, rows, cols) != 0) {
+        printf("Failed to allocate contiguous matrix\n");
+        return;
+    }
+    MATRIX_VIEW(grid, &contiguous);  // grid[i][j] works just like matrix[i][j]
+    MATRIX_FOR_EACH_ROW_MAJOR(&contiguous, i, j) {
+        grid[i][j] = (int)(i * cols + j);
+    }
+    
+    printf("Contiguous 2D array (stride %zu ints per row):\n", contiguous.stride);
+    for (int i = 0; i < rows; i++) {
+        const int *row = matrix_row(&contiguous, i);  // Row view
+        for (int j = 0; j < cols; j++) {
+            printf("%2d ", row[j]);
+        }
+        printf("\n");
+    }
+    
+    matrix_free(&contiguous);  // A single free releases everything
+    
+    // The int** layout can also take its rows from an arena: allocation is a
+    // pointer bump and the whole structure is released with one call
+    arena_t arena;
+    arena_init(&arena, 4096);
+    int **arena_matrix = ARENA_NEW_ARRAY(&arena, int *, rows);
+    for (int i = 0; i < rows; i++) {
+        arena_matrix[i] = ARENA_NEW_ARRAY(&arena, int, cols);
+        for (int j = 0; j < cols; j++) {
+            arena_matrix[i][j] = i * cols + j;
+        }
+    }
+    printf("Arena-backed 2D array, last element: %d\n", arena_matrix[rows - 1][cols - 1]);
+    arena_release(&arena);  // No per-row free loop
 }
 
 void const_pointer_examples() {
@@ -190,6 +250,37 @@ void void_pointer_examples() {
     printf("\n");
     
     free(void_ptr);
+    
+    // The same buffer from an arena: arena_alloc also returns void*, but
+    // there is nothing to free individually
+    arena_t arena;
+    arena_init(&arena, 1024);
+    void_ptr = arena_alloc(&arena, sizeof(int) * 5);
+    int_array = (int*)void_ptr;
+    for (int i = 0; i < 5; i++) {
+        int_array[i] = i * 100;
+    }
+    printf("Arena array via void pointer: ");
+    for (int i = 0; i < 5; i++) {
+        printf("%d ", int_array[i]);
+    }
+    printf("\n");
+    arena_release(&arena);
+
+    // A typed vector needs no void* or casts, and it grows on demand
+    int_vector_t vec;
+    int_vector_init(&vec);
+    for (int i = 0; i < 20; i++) {
+        if (int_vector_push(&vec, i * 10) != 0) {
+            perror("int_vector_push");
+            exit(1);
+        }
+    }
+    printf("Typed vector: size %zu, capacity %zu, last element %d\n",
+           vec.size, vec.capacity, vec.data[vec.size - 1]);
+    int_vector_shrink_to_fit(&vec);
+    printf("After shrink_to_fit: capacity %zu\n", vec.capacity);
+    int_vector_free(&vec);
 }
 
 void array_pointer_relationship() {
@@ -225,18 +316,103 @@ void array_pointer_relationship() {
     // But elements of the array can be modified
     str[0] = 'J';
     printf("After modification, str = %s\n", str);
+
+    // A string that knows its own length: wrapping a literal copies nothing
+    sso_string_t greeting;
+    SSO_WRAP_LITERAL(&greeting, "Hello");
+    sso_append(&greeting, ", World", 7);  // Now owned, still stored inline
+    printf("\nsso_string_t: \"%s\", length %zu, %s\n", sso_cstr(&greeting), sso_len(&greeting),
+           sso_is_small(&greeting) ? "inline (no heap)" : "heap");
+
+    sso_append_cstr(&greeting, " - long enough to move to the heap");
+    sso_string_t word = sso_slice(&greeting, 7, 5);
+    printf("After a long append: length %zu, capacity %zu, %s; slice [7, 12) = \"%.*s\"\n",
+           sso_len(&greeting), sso_capacity(&greeting), sso_is_small(&greeting) ? "inline" : "heap",
+           (int)sso_len(&word), sso_data(&word));
+    sso_free(&greeting);
+}
+
+void mapped_file_examples() {
+    printf("\n=== Memory-Mapped File Examples ===\n");
+
+    char path[] = "/tmp/pointer_examples.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    close(fd);
+
+    // A matrix whose storage is the file itself: writing grid[i][j] writes
+    // the page cache, and the kernel writes the pages back to disk
+    int rows = 3, cols = 4;
+    mapped_file_t file;
+    matrix_t m;
+    if (mapped_matrix_create(&file, path, rows, cols, &m, MAPPED_FILE_READ) != 0) {
+        perror("mapped_matrix_create");
+        unlink(path);
+        return;
+    }
+    MATRIX_VIEW(grid, &m);
+    MATRIX_FOR_EACH_ROW_MAJOR(&m, i, j) {
+        grid[i][j] = (int)(i * cols + j);
+    }
+    mapped_file_close(&file);
+
+    // Map it back: no read(), no buffer, the matrix_t points into the mapping
+    if (mapped_file_open(&file, path, MAPPED_FILE_SEQUENTIAL) != 0 || mapped_file_matrix(&file, &m) != 0) {
+        perror("mapped_file_open");
+        mapped_file_close(&file);
+        unlink(path);
+        return;
+    }
+    printf("Mapped %zu-byte file as a %zux%zu matrix, sum = %lld, last element = %d\n",
+           file.size, m.rows, m.cols, matrix_sum_row_major(&m), *matrix_at(&m, m.rows - 1, m.cols - 1));
+
+    // Any file can also be read as a plain int array. Here the header takes
+    // the first 16 ints and the row padding is zero, so the sum is the same.
+    size_t count;
+    const int *ints = mapped_file_ints(&file, &count);
+    size_t skip = sizeof(mapped_matrix_header_t) / sizeof(int);
+    printf("Same file as %zu ints, sum after the header = %lld\n", count, array_sum(ints + skip, count - skip));
+    mapped_file_close(&file);
+    unlink(path);
 }
 
 // Function pointer example implementations
-int add(int a, int b) { return a + b; }
-int subtract(int a, int b) { return a - b; }
-int multiply(int a, int b) { return a * b; }
-int divide(int a, int b) { return b != 0 ? a / b : 0; }
+// Real functions with addresses, for the pointer examples. The arithmetic
+// itself lives in calculate.h.
+int add(int a, int b) { return calculate_add(a, b); }
+int subtract(int a, int b) { return calculate_subtract(a, b); }
+int multiply(int a, int b) { return calculate_multiply(a, b); }
+int divide(int a, int b) { return calculate_divide(a, b); }
 
 int calculate(int (*operation)(int, int), int a, int b) {
     return operation(a, b);
 }
 
+// One pointer comparison per call instead of one indirect call per element.
+// The known operations run as plain loops: add/subtract/multiply use the
+// SIMD kernels, divide keeps its "0 when b is 0" rule for every element.
+// Anything else falls back to calling the pointer for each element.
+void calculate_batch(int (*operation)(int, int), const int *a, const int *b, int *out, size_t n) {
+    if (operation == add) {
+        array_add(out, a, b, n);
+    } else if (operation == subtract) {
+        array_sub(out, a, b, n);
+    } else if (operation == multiply) {
+        array_mul(out, a, b, n);
+    } else if (operation == divide) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = calculate_divide(a[i], b[i]);
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = operation(a[i], b[i]);
+        }
+    }
+}
+
 void function_pointer_examples() {
     printf("\n=== Function Pointer Examples ===\n");
     
@@ -253,6 +429,10 @@ void function_pointer_examples() {
     // Using the calculate function that takes a function pointer
     printf("Add via calculate: %d\n", calculate(add, 10, 5));
     printf("Multiply via calculate: %d\n", calculate(multiply, 10, 5));
+
+    // When the operation is fixed at compile time, skip the pointer entirely
+    printf("Add via CALCULATE (inlined): %d\n", CALCULATE(add, 10, 5));
+    printf("Divide via CALCULATE (inlined): %d\n", CALCULATE(divide, 10, 0));
     
     // Array of function pointers
     int (*operations[4])(int, int) = {add, subtract, multiply, divide};
@@ -262,6 +442,50 @@ void function_pointer_examples() {
     for (int i = 0; i < 4; i++) {
         printf("%s: %d\n", op_names[i], operations[i](10, 5));
     }
+
+    // Batched: one dispatch for every pair of elements
+    int lhs[6] = {10, 20, 30, 40, 50, 60};
+    int rhs[6] = {5, 4, 3, 2, 1, 0};
+    int results[6];
+
+    printf("\nUsing calculate_batch over arrays:\n");
+    for (int i = 0; i < 4; i++) {
+        calculate_batch(operations[i], lhs, rhs, results, 6);
+        printf("%s:", op_names[i]);
+        for (int j = 0; j < 6; j++) {
+            printf(" %d", results[j]);
+        }
+        printf("\n");
+    }
+
+    // A whole formula as bytecode: ((x + y) * (x - y)) / y with x = 10, y = 5.
+    // Opcodes 0-3 are in the same order as operations[].
+    expr_program_t formula, folded;
+    expr_program_init(&formula);
+    expr_program_init(&folded);
+    expr_emit(&formula, EXPR_OP_ADD, 2, 0, 1);
+    expr_emit(&formula, EXPR_OP_SUB, 3, 0, 1);
+    expr_emit(&formula, EXPR_OP_MUL, 2, 2, 3);
+    expr_emit(&formula, EXPR_OP_DIV, 2, 2, 1);
+    expr_emit_halt(&formula, 2);
+
+    int regs[EXPR_VM_REGS] = {10, 5};
+    printf("\nBytecode ((x + y) * (x - y)) / y with x = 10, y = 5: %d\n", expr_vm_run(&formula, regs));
+
+    // With constants instead of inputs the folder computes it up front
+    expr_program_clear(&formula);
+    expr_emit_imm(&formula, 0, 10);
+    expr_emit_imm(&formula, 1, 5);
+    expr_emit(&formula, EXPR_OP_ADD, 2, 0, 1);
+    expr_emit(&formula, EXPR_OP_MUL, 2, 2, 1);
+    expr_emit_halt(&formula, 2);
+    if (expr_program_fold(&folded, &formula) == 0) {
+        int scratch[EXPR_VM_REGS] = {0};
+        printf("Constant formula (10 + 5) * 5: %zu code words, %zu after folding, result %d\n",
+               formula.len, folded.len, expr_vm_run(&folded, scratch));
+    }
+    expr_program_free(&formula);
+    expr_program_free(&folded);
 }
 
 int main() {
@@ -273,6 +497,7 @@ int main() {
     const_pointer_examples();
     void_pointer_examples();
     array_pointer_relationship();
+    mapped_file_examples();
     function_pointer_examples();
     
     return 0;
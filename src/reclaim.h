@@ -0,0 +1,384 @@
+/**
+ * reclaim.h - Safe memory reclamation for lock-free data structures
+ *
+ * A thread that unlinks a node from a lock-free structure cannot free it
+ * right away: another thread may have loaded the pointer just before the
+ * unlink and still be reading the node. Taking a lock around every read
+ * would defeat the point, so this header defers the free() instead:
+ *
+ * 1. ebr_t - epoch-based reclamation. Readers mark the region in which
+ *    they hold pointers with ebr_enter/ebr_exit, which costs one store.
+ *    A retired node is freed once the global epoch has advanced twice,
+ *    which can only happen after every reader that might have seen the
+ *    node has left its region:
+ *
+ *        ebr_t ebr;
+ *        ebr_init(&ebr);
+ *        ebr_thread_t *t = ebr_register(&ebr);   // once per thread
+ *        ebr_enter(t);
+ *        node_t *n = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+ *        ... read n, or unlink it and ebr_retire(t, n, free) ...
+ *        ebr_exit(t);
+ *        ebr_unregister(t);
+ *        ebr_destroy(&ebr);                      // frees what is left
+ *
+ *    A reader that stalls inside its region holds up all reclamation.
+ *
+ * 2. hp_domain_t - hazard pointers. A reader publishes each pointer it is
+ *    about to use in one of its HP_SLOTS slots. A retired node is freed
+ *    as soon as no slot points at it, so a stalled reader only holds up
+ *    the few nodes it protects. Every protected load costs a seq_cst
+ *    store and a re-check, which epochs avoid:
+ *
+ *        hp_thread_t *t = hp_register(&domain);
+ *        node_t *n = hp_protect(t, 0, (void **)&head);
+ *        ... read n ...
+ *        hp_clear(t, 0);
+ *        hp_retire(t, unlinked, free);
+ *
+ * Both schemes keep a retire list per thread and only free in batches
+ * (EBR_RETIRE_BATCH, HP_SCAN_THRESHOLD), so the cost of checking the
+ * other threads is spread over many retires. Thread records are never
+ * freed before *_destroy; an unregistered record (and whatever it still
+ * has to free) is handed to the next thread that registers.
+ *
+ * Functions that allocate return 0 (or a record) on success and -1 (or
+ * NULL) when out of memory. A retire that fails leaves the node with the
+ * caller.
+ */
+
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "vector.h"
+
+// A node waiting to be freed
+typedef struct {
+    void *ptr;
+    void (*free_fn)(void *);
+    uint64_t epoch;   // EBR: global epoch when it was retired
+} reclaim_retired_t;
+
+VECTOR_DECLARE(reclaim_list, reclaim_retired_t)
+VECTOR_DECLARE(reclaim_ptrs, void *)
+
+// ---------------------------------------------------------------------------
+// ebr_t: epoch-based reclamation
+// ---------------------------------------------------------------------------
+
+// Retires between attempts to advance the epoch and free old nodes
+#define EBR_RETIRE_BATCH 64
+
+// Low bit of ebr_thread_t.state: the thread is inside ebr_enter/ebr_exit
+#define EBR_ACTIVE 1
+
+struct ebr;
+
+typedef struct ebr_thread {
+    _Alignas(CACHE_LINE_SIZE) uint64_t state;  // epoch << 1 | EBR_ACTIVE, or 0
+    unsigned int nesting;         // ebr_enter depth, owner only
+    unsigned int since_collect;   // Retires since the last ebr_collect
+    bool in_use;                  // Claimed by a registered thread
+    struct ebr *ebr;
+    struct ebr_thread *next;      // Registry, never unlinked before destroy
+    reclaim_list_t retired;       // Oldest first, so epochs never decrease
+} ebr_thread_t;
+
+typedef struct ebr {
+    _Alignas(CACHE_LINE_SIZE) uint64_t epoch;           // Global epoch
+    _Alignas(CACHE_LINE_SIZE) ebr_thread_t *threads;    // Registry head
+} ebr_t;
+
+static inline void ebr_init(ebr_t *ebr) {
+    ebr->epoch = 0;
+    ebr->threads = NULL;
+}
+
+// Get a thread record: reuse an unregistered one or allocate a new one
+static inline ebr_thread_t *ebr_register(ebr_t *ebr) {
+    for (ebr_thread_t *t = __atomic_load_n(&ebr->threads, __ATOMIC_ACQUIRE); t != NULL; t = t->next) {
+        bool expected = false;
+        if (!__atomic_load_n(&t->in_use, __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(&t->in_use, &expected, true, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return t;
+        }
+    }
+
+    ebr_thread_t *t = (ebr_thread_t *)aligned_alloc(CACHE_LINE_SIZE, sizeof(ebr_thread_t));
+    if (t == NULL) {
+        return NULL;
+    }
+    memset(t, 0, sizeof(*t));
+    t->in_use = true;
+    t->ebr = ebr;
+    reclaim_list_init(&t->retired);
+
+    t->next = __atomic_load_n(&ebr->threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&ebr->threads, &t->next, t, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return t;
+}
+
+// Start a read-side region. Pointers loaded from the structure stay valid
+// until the matching ebr_exit. Regions may nest.
+static inline void ebr_enter(ebr_thread_t *t) {
+    if (t->nesting++ > 0) {
+        return;
+    }
+    // Announce the epoch we read. The seq_cst store orders the announcement
+    // before our loads from the structure, and ebr_try_advance's seq_cst
+    // loads see it before moving the epoch on.
+    uint64_t e = __atomic_load_n(&t->ebr->epoch, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->state, (e << 1) | EBR_ACTIVE, __ATOMIC_SEQ_CST);
+}
+
+static inline void ebr_exit(ebr_thread_t *t) {
+    if (--t->nesting > 0) {
+        return;
+    }
+    __atomic_store_n(&t->state, 0, __ATOMIC_RELEASE);
+}
+
+// Move the global epoch on by one if every active thread has seen it.
+// Returns true when the epoch advanced (by us or by a concurrent caller).
+static inline bool ebr_try_advance(ebr_t *ebr) {
+    uint64_t e = __atomic_load_n(&ebr->epoch, __ATOMIC_SEQ_CST);
+    for (ebr_thread_t *t = __atomic_load_n(&ebr->threads, __ATOMIC_ACQUIRE); t != NULL; t = t->next) {
+        uint64_t s = __atomic_load_n(&t->state, __ATOMIC_SEQ_CST);
+        if ((s & EBR_ACTIVE) && (s >> 1) != e) {
+            return false;   // Still reading in an older epoch
+        }
+    }
+    // Failure means another thread advanced it first, which is as good
+    __atomic_compare_exchange_n(&ebr->epoch, &e, e + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+// Free this thread's nodes that were retired at least two epochs ago.
+// Returns the number of nodes freed.
+static inline size_t ebr_collect(ebr_thread_t *t) {
+    t->since_collect = 0;
+    ebr_try_advance(t->ebr);
+    uint64_t e = __atomic_load_n(&t->ebr->epoch, __ATOMIC_ACQUIRE);
+
+    reclaim_list_t *list = &t->retired;
+    size_t n = 0;
+    while (n < list->size && list->data[n].epoch + 2 <= e) {
+        list->data[n].free_fn(list->data[n].ptr);
+        n++;
+    }
+    if (n > 0) {
+        memmove(list->data, list->data + n, (list->size - n) * sizeof(reclaim_retired_t));
+        list->size -= n;
+    }
+    return n;
+}
+
+// Hand `ptr` over for freeing with `free_fn` once no reader can hold it.
+// It must already be unreachable for new readers. Returns 0, or -1 when
+// the retire list cannot grow (the caller still owns `ptr`).
+static inline int ebr_retire(ebr_thread_t *t, void *ptr, void (*free_fn)(void *)) {
+    reclaim_retired_t r = {ptr, free_fn, __atomic_load_n(&t->ebr->epoch, __ATOMIC_SEQ_CST)};
+    if (reclaim_list_push(&t->retired, r) != 0) {
+        return -1;
+    }
+    if (++t->since_collect >= EBR_RETIRE_BATCH) {
+        ebr_collect(t);
+    }
+    return 0;
+}
+
+// Give the record back. Anything it could not free yet stays on it.
+static inline void ebr_unregister(ebr_thread_t *t) {
+    ebr_collect(t);
+    __atomic_store_n(&t->in_use, false, __ATOMIC_RELEASE);
+}
+
+// Free every retired node and every thread record. No thread may be
+// inside a region or use the domain any more.
+static inline void ebr_destroy(ebr_t *ebr) {
+    ebr_thread_t *t = ebr->threads;
+    while (t != NULL) {
+        ebr_thread_t *next = t->next;
+        for (size_t i = 0; i < t->retired.size; i++) {
+            t->retired.data[i].free_fn(t->retired.data[i].ptr);
+        }
+        reclaim_list_free(&t->retired);
+        free(t);
+        t = next;
+    }
+    ebr->threads = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// hp_domain_t: hazard pointers
+// ---------------------------------------------------------------------------
+
+// Pointers one thread can protect at the same time
+#define HP_SLOTS 4
+
+// Smallest retire list that triggers a scan. The scan also waits until the
+// list is twice the number of hazard slots, so every scan frees at least
+// half of it.
+#define HP_SCAN_THRESHOLD 64
+
+struct hp_domain;
+
+typedef struct hp_thread {
+    _Alignas(CACHE_LINE_SIZE) void *hazards[HP_SLOTS];  // Read by every scanner
+    bool in_use;
+    struct hp_domain *domain;
+    struct hp_thread *next;
+    reclaim_list_t retired;
+    reclaim_ptrs_t snapshot;      // Scratch space for hp_scan
+} hp_thread_t;
+
+typedef struct hp_domain {
+    _Alignas(CACHE_LINE_SIZE) hp_thread_t *threads;
+    unsigned int records;         // Thread records allocated so far
+} hp_domain_t;
+
+static inline void hp_init(hp_domain_t *d) {
+    d->threads = NULL;
+    d->records = 0;
+}
+
+static inline hp_thread_t *hp_register(hp_domain_t *d) {
+    for (hp_thread_t *t = __atomic_load_n(&d->threads, __ATOMIC_ACQUIRE); t != NULL; t = t->next) {
+        bool expected = false;
+        if (!__atomic_load_n(&t->in_use, __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(&t->in_use, &expected, true, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return t;
+        }
+    }
+
+    hp_thread_t *t = (hp_thread_t *)aligned_alloc(CACHE_LINE_SIZE, sizeof(hp_thread_t));
+    if (t == NULL) {
+        return NULL;
+    }
+    memset(t, 0, sizeof(*t));
+    t->in_use = true;
+    t->domain = d;
+    reclaim_list_init(&t->retired);
+    reclaim_ptrs_init(&t->snapshot);
+
+    t->next = __atomic_load_n(&d->threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&d->threads, &t->next, t, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    __atomic_fetch_add(&d->records, 1, __ATOMIC_RELAXED);
+    return t;
+}
+
+// Load *src and protect the result in `slot`. The returned pointer stays
+// valid until the slot is cleared or reused. If *src changes between the
+// load and the publication, the load is simply retried.
+static inline void *hp_protect(hp_thread_t *t, int slot, void *const *src) {
+    void *p = __atomic_load_n(src, __ATOMIC_ACQUIRE);
+    while (true) {
+        __atomic_store_n(&t->hazards[slot], p, __ATOMIC_SEQ_CST);
+        void *again = __atomic_load_n(src, __ATOMIC_SEQ_CST);
+        if (again == p) {
+            return p;
+        }
+        p = again;
+    }
+}
+
+static inline void hp_clear(hp_thread_t *t, int slot) {
+    __atomic_store_n(&t->hazards[slot], NULL, __ATOMIC_RELEASE);
+}
+
+static inline int hp_compare_ptrs(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)*(void *const *)a;
+    uintptr_t y = (uintptr_t)*(void *const *)b;
+    return (x > y) - (x < y);
+}
+
+// Free every node of this thread that no hazard slot points at. Returns the
+// number of nodes freed, or 0 when the snapshot could not be allocated.
+static inline size_t hp_scan(hp_thread_t *t) {
+    reclaim_ptrs_t *snap = &t->snapshot;
+    reclaim_ptrs_clear(snap);
+
+    // Snapshot all hazards, sorted for binary search. Missing one would
+    // free a protected node, so give up if the snapshot cannot grow.
+    for (hp_thread_t *h = __atomic_load_n(&t->domain->threads, __ATOMIC_ACQUIRE); h != NULL; h = h->next) {
+        for (int i = 0; i < HP_SLOTS; i++) {
+            void *p = __atomic_load_n(&h->hazards[i], __ATOMIC_SEQ_CST);
+            if (p != NULL && reclaim_ptrs_push(snap, p) != 0) {
+                return 0;
+            }
+        }
+    }
+    if (snap->size > 1) {
+        qsort(snap->data, snap->size, sizeof(void *), hp_compare_ptrs);
+    }
+
+    reclaim_list_t *list = &t->retired;
+    size_t kept = 0;
+    size_t freed = 0;
+    for (size_t i = 0; i < list->size; i++) {
+        reclaim_retired_t r = list->data[i];
+        if (snap->size > 0 &&
+            bsearch(&r.ptr, snap->data, snap->size, sizeof(void *), hp_compare_ptrs) != NULL) {
+            list->data[kept++] = r;   // Still protected: try again next scan
+        } else {
+            r.free_fn(r.ptr);
+            freed++;
+        }
+    }
+    list->size = kept;
+    return freed;
+}
+
+// Hand `ptr` over for freeing with `free_fn` once no hazard protects it.
+// It must already be unreachable for new readers. Returns 0, or -1 when the
+// retire list cannot grow (the caller still owns `ptr`).
+static inline int hp_retire(hp_thread_t *t, void *ptr, void (*free_fn)(void *)) {
+    reclaim_retired_t r = {ptr, free_fn, 0};
+    if (reclaim_list_push(&t->retired, r) != 0) {
+        return -1;
+    }
+    size_t limit = 2 * (size_t)__atomic_load_n(&t->domain->records, __ATOMIC_RELAXED) * HP_SLOTS;
+    if (t->retired.size >= HP_SCAN_THRESHOLD && t->retired.size >= limit) {
+        hp_scan(t);
+    }
+    return 0;
+}
+
+// Clear this thread's hazards and give the record back
+static inline void hp_unregister(hp_thread_t *t) {
+    for (int i = 0; i < HP_SLOTS; i++) {
+        hp_clear(t, i);
+    }
+    hp_scan(t);
+    __atomic_store_n(&t->in_use, false, __ATOMIC_RELEASE);
+}
+
+static inline void hp_destroy(hp_domain_t *d) {
+    hp_thread_t *t = d->threads;
+    while (t != NULL) {
+        hp_thread_t *next = t->next;
+        for (size_t i = 0; i < t->retired.size; i++) {
+            t->retired.data[i].free_fn(t->retired.data[i].ptr);
+        }
+        reclaim_list_free(&t->retired);
+        reclaim_ptrs_free(&t->snapshot);
+        free(t);
+        t = next;
+    }
+    d->threads = NULL;
+    d->records = 0;
+}
+
+#endif // RECLAIM_H
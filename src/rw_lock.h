@@ -0,0 +1,178 @@
+/**
+ * rw_lock.h - Reader-writer lock built on the simple_lock primitives
+ *
+ * Many threads may hold the lock in shared (read) mode at the same time;
+ * a thread holding it in exclusive (write) mode excludes everybody else:
+ *
+ *     rw_lock_acquire_shared(&lock);      rw_lock_acquire_exclusive(&lock);
+ *     ... read shared data ...            ... modify shared data ...
+ *     rw_lock_release_shared(&lock);      rw_lock_release_exclusive(&lock);
+ *
+ * The lock prefers writers: as soon as a writer announces itself, new
+ * readers wait, so a steady stream of readers cannot starve writers.
+ *
+ * Two reader-counting modes are available:
+ * 1. RW_LOCK_CENTRAL - one reader counter (small, fine for light read loads)
+ * 2. RW_LOCK_PER_CPU - a "big reader" lock with one cache-line-padded
+ *                      counter per CPU, so readers on different cores never
+ *                      write the same line; writers pay by scanning them all
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see simple_lock.h).
+ */
+
+#ifndef RW_LOCK_H
+#define RW_LOCK_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "simple_lock.h"
+
+// How readers are counted
+typedef enum {
+    RW_LOCK_CENTRAL,  // One shared reader counter
+    RW_LOCK_PER_CPU   // One padded reader counter per CPU ("big reader" lock)
+} rw_lock_mode_t;
+
+// A reader counter that owns its whole cache line
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) int count;
+} rw_lock_slot_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) int writers;  // Writers waiting or holding the lock
+    simple_lock_t writer_lock;              // Serializes writers among themselves
+    rw_lock_slot_t readers;                 // Reader counter in central mode
+    rw_lock_slot_t *slots;                  // Per-CPU reader counters (or NULL)
+    size_t slot_mask;                       // Number of slots - 1
+    rw_lock_mode_t mode;
+} rw_lock_t;
+
+// Per-CPU mode assigns every thread one slot on its first read. The slot is
+// fixed for the thread's lifetime, so a reader that migrates to another
+// core between acquire and release still decrements the counter it
+// incremented. Threads are spread round-robin, which gives each core its
+// own counter as long as there are no more threads than CPUs.
+static _Thread_local int rw_lock_thread_slot = -1;
+static unsigned int rw_lock_next_slot = 0;
+
+static inline size_t rw_lock_my_slot(const rw_lock_t *lock) {
+    if (rw_lock_thread_slot < 0) {
+        rw_lock_thread_slot = (int)__atomic_fetch_add(&rw_lock_next_slot, 1, __ATOMIC_RELAXED);
+    }
+    return (size_t)rw_lock_thread_slot & lock->slot_mask;
+}
+
+// The counter this thread uses for its reads
+static inline int *rw_lock_reader_counter(rw_lock_t *lock) {
+    if (lock->mode == RW_LOCK_PER_CPU) {
+        return &lock->slots[rw_lock_my_slot(lock)].count;
+    }
+    return &lock->readers.count;
+}
+
+// Initialize the lock in the given mode. Returns 0 on success, -1 if the
+// per-CPU counters cannot be allocated.
+static inline int rw_lock_init_mode(rw_lock_t *lock, rw_lock_mode_t mode) {
+    lock->writers = 0;
+    simple_lock_init_mode(&lock->writer_lock, SIMPLE_LOCK_ADAPTIVE);
+    lock->readers.count = 0;
+    lock->slots = NULL;
+    lock->slot_mask = 0;
+    lock->mode = mode;
+
+    if (mode == RW_LOCK_PER_CPU) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t n = 1;
+        while ((long)n < cpus) {
+            n <<= 1;
+        }
+        lock->slots = (rw_lock_slot_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                      n * sizeof(rw_lock_slot_t));
+        if (lock->slots == NULL) {
+            return -1;
+        }
+        for (size_t i = 0; i < n; i++) {
+            lock->slots[i].count = 0;
+        }
+        lock->slot_mask = n - 1;
+    }
+    return 0;
+}
+
+// Initialize a central-counter lock
+static inline void rw_lock_init(rw_lock_t *lock) {
+    rw_lock_init_mode(lock, RW_LOCK_CENTRAL);
+}
+
+// Free the per-CPU counters (no-op in central mode)
+static inline void rw_lock_destroy(rw_lock_t *lock) {
+    free(lock->slots);
+    lock->slots = NULL;
+}
+
+// Shared acquisition
+static inline void rw_lock_acquire_shared(rw_lock_t *lock) {
+    int *counter = rw_lock_reader_counter(lock);
+    unsigned int spins = 0;
+
+    while (true) {
+        // Writer preference: stay out while any writer is waiting or active
+        while (__atomic_load_n(&lock->writers, __ATOMIC_SEQ_CST) != 0) {
+            spin_wait(&spins);
+        }
+
+        // Announce ourselves, then re-check. The writer does the mirror image
+        // (announce, then check readers), and because both sides use seq_cst
+        // at least one of us sees the other.
+        __atomic_fetch_add(counter, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&lock->writers, __ATOMIC_SEQ_CST) == 0) {
+            return; // Read lock acquired
+        }
+
+        // A writer slipped in: back out and let it go first
+        __atomic_fetch_sub(counter, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Shared release
+static inline void rw_lock_release_shared(rw_lock_t *lock) {
+    __atomic_fetch_sub(rw_lock_reader_counter(lock), 1, __ATOMIC_RELEASE);
+}
+
+// True while any reader is still inside
+static inline bool rw_lock_has_readers(rw_lock_t *lock) {
+    if (lock->mode == RW_LOCK_PER_CPU) {
+        for (size_t i = 0; i <= lock->slot_mask; i++) {
+            if (__atomic_load_n(&lock->slots[i].count, __ATOMIC_SEQ_CST) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return __atomic_load_n(&lock->readers.count, __ATOMIC_SEQ_CST) != 0;
+}
+
+// Exclusive acquisition
+static inline void rw_lock_acquire_exclusive(rw_lock_t *lock) {
+    // Announce first so that no new readers get in while we queue
+    __atomic_fetch_add(&lock->writers, 1, __ATOMIC_SEQ_CST);
+    simple_lock_acquire(&lock->writer_lock);
+
+    // Wait for the readers that were already inside to drain
+    unsigned int spins = 0;
+    while (rw_lock_has_readers(lock)) {
+        spin_wait(&spins);
+    }
+}
+
+// Exclusive release
+static inline void rw_lock_release_exclusive(rw_lock_t *lock) {
+    simple_lock_release(&lock->writer_lock);
+    __atomic_fetch_sub(&lock->writers, 1, __ATOMIC_RELEASE);
+}
+
+#endif // RW_LOCK_H
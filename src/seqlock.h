@@ -0,0 +1,154 @@
+/**
+ * seqlock.h - Sequence lock for small, read-mostly shared data
+ *
+ * Reading a config struct through simple_lock_acquire serializes every
+ * reader, and even a reader-writer lock makes each reader write to the
+ * lock's cache line. A sequence lock lets readers go without writing
+ * anything shared:
+ *
+ * 1. A writer makes the sequence odd, updates the data, and makes it even
+ *    again.
+ * 2. A reader notes an even sequence, copies the data, and checks that the
+ *    sequence is unchanged. If a writer got in between, it copies again.
+ *
+ *     seqlock_t lock;
+ *     config_t shared, copy;
+ *     seqlock_init(&lock);
+ *
+ *     seqlock_store(&lock, &shared, &next, sizeof(shared));  // writer
+ *     seqlock_load(&lock, &copy, &shared, sizeof(shared));   // reader
+ *
+ * For reads that only need part of the data, use the loop directly:
+ *
+ *     uint32_t seq;
+ *     do {
+ *         seq = seqlock_read_begin(&lock);
+ *         x = __atomic_load_n(&shared.x, __ATOMIC_RELAXED);
+ *     } while (seqlock_read_retry(&lock, seq));
+ *
+ * Data inside the loop must be read with __atomic loads (seqlock_copy
+ * does that for whole structs), because a writer may change it at the
+ * same time. The copy is only used once the sequence check passes.
+ *
+ * Writers exclude each other with seqlock_write_lock, which spins on the
+ * sequence itself. Writers that already hold another lock, like the
+ * stripes of hash_map.h, use seqlock_write_begin/end instead. Readers
+ * never block writers, so a steady stream of writes can starve readers;
+ * the lock suits data that changes rarely.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cpu.h"
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) uint32_t seq;  // Odd while a write is in progress
+} seqlock_t;
+
+static inline void seqlock_init(seqlock_t *lock) {
+    lock->seq = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Reader side
+// ---------------------------------------------------------------------------
+
+// Wait for an even sequence and return it
+static inline uint32_t seqlock_read_begin(const seqlock_t *lock) {
+    unsigned int spins = 0;
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE)) & 1) {
+        spin_wait(&spins);
+    }
+    return seq;
+}
+
+// True when a writer ran since seqlock_read_begin returned `start`, so
+// whatever was read in between must be thrown away. The acquire fence keeps
+// the data loads above from moving below the sequence check.
+static inline bool seqlock_read_retry(const seqlock_t *lock, uint32_t start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&lock->seq, __ATOMIC_RELAXED) != start;
+}
+
+// ---------------------------------------------------------------------------
+// Writer side
+// ---------------------------------------------------------------------------
+
+// Start a write when writers are already serialized by some other lock.
+// The release fence keeps the data stores from becoming visible before
+// the odd sequence.
+static inline void seqlock_write_begin(seqlock_t *lock) {
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(seqlock_t *lock) {
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Start a write, waiting for any other writer: the writer that turns the
+// sequence odd owns the lock
+static inline void seqlock_write_lock(seqlock_t *lock) {
+    unsigned int spins = 0;
+    while (true) {
+        uint32_t seq = __atomic_load_n(&lock->seq, __ATOMIC_RELAXED);
+        if ((seq & 1) == 0 &&
+            __atomic_compare_exchange_n(&lock->seq, &seq, seq + 1, true,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+        spin_wait(&spins);
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_unlock(seqlock_t *lock) {
+    seqlock_write_end(lock);
+}
+
+// ---------------------------------------------------------------------------
+// Whole-struct copies
+// ---------------------------------------------------------------------------
+
+// Copy `size` bytes with relaxed atomic loads and stores, a word at a time
+// where both pointers allow it. A plain memcpy racing with a writer would
+// be a data race even though the result is thrown away.
+static inline void seqlock_copy(void *dst, const void *src, size_t size) {
+    unsigned char *d = (unsigned char *)dst;
+    const unsigned char *s = (const unsigned char *)src;
+    size_t i = 0;
+    if (((uintptr_t)d | (uintptr_t)s) % sizeof(uint64_t) == 0) {
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t w = __atomic_load_n((const uint64_t *)(s + i), __ATOMIC_RELAXED);
+            __atomic_store_n((uint64_t *)(d + i), w, __ATOMIC_RELAXED);
+        }
+    }
+    for (; i < size; i++) {
+        __atomic_store_n(d + i, __atomic_load_n(s + i, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+}
+
+// Copy the shared data at `shared` into `out`, retrying until no writer
+// interfered
+static inline void seqlock_load(const seqlock_t *lock, void *out, const void *shared, size_t size) {
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(lock);
+        seqlock_copy(out, shared, size);
+    } while (seqlock_read_retry(lock, seq));
+}
+
+// Replace the shared data at `shared` with `in`
+static inline void seqlock_store(seqlock_t *lock, void *shared, const void *in, size_t size) {
+    seqlock_write_lock(lock);
+    seqlock_copy(shared, in, size);
+    seqlock_write_unlock(lock);
+}
+
+#endif // SEQLOCK_H
@@ -0,0 +1,147 @@
+/**
+ * sharded_counter.h - Scalable counters split into cache-line-padded shards
+ *
+ * A single counter updated with __atomic_fetch_add from every thread is one
+ * cache line that bounces between all the cores doing the updates; the
+ * seq_cst ordering adds a full barrier on top. A sharded counter gives
+ * each thread (or CPU) its own padded slot and updates it with a relaxed
+ * atomic, so concurrent increments never touch the same line:
+ *
+ *     sharded_counter_t c;
+ *     sharded_counter_init(&c, SHARDED_COUNTER_PER_THREAD, 0);  // 0: a shard per CPU
+ *     sharded_counter_add(&c, 1);                  // relaxed, on our own line
+ *     int64_t n = sharded_counter_read(&c);        // exact: sums every shard
+ *     int64_t m = sharded_counter_read_approx(&c); // O(1), within a bounded error
+ *     sharded_counter_destroy(&c);
+ *
+ * This header provides:
+ * 1. Per-thread sharding - a thread's slot is fixed the first time it
+ *    touches any sharded counter; threads beyond the shard count share
+ * 2. Per-CPU sharding    - the slot of the CPU the thread runs on now
+ * 3. Two read modes, in the style of Linux's percpu_counter:
+ *    - exact:  the central count plus every shard, O(shards). It is exact
+ *              when no update is in flight.
+ *    - approx: the central count only, O(1). A shard folds its running
+ *              delta into the central count once it reaches
+ *              SHARDED_COUNTER_BATCH, so the central count is never off
+ *              by more than shards * SHARDED_COUNTER_BATCH.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (sched_getcpu is a GNU extension).
+ */
+
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "cpu.h"
+
+// Shard delta that gets folded into the central count
+#define SHARDED_COUNTER_BATCH 64
+
+typedef enum {
+    SHARDED_COUNTER_PER_THREAD,   // Slot chosen once per thread
+    SHARDED_COUNTER_PER_CPU       // Slot of the current CPU (sched_getcpu)
+} sharded_counter_mode_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) int64_t delta;  // Not yet folded into `count`
+} sharded_counter_slot_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) int64_t count;  // Central count, updated once per batch
+    _Alignas(CACHE_LINE_SIZE) sharded_counter_slot_t *slots;
+    unsigned int mask;                        // Shards - 1 (a power of two)
+    sharded_counter_mode_t mode;
+} sharded_counter_t;
+
+// Per-thread slot numbers, handed out in order of first use (0: none yet)
+static unsigned int sharded_counter_next_thread = 0;
+static __thread unsigned int sharded_counter_thread_slot = 0;
+
+// Set up `shards` slots (rounded up to a power of two; 0 means one per
+// configured CPU). Returns 0 on success, -1 when out of memory.
+static inline int sharded_counter_init(sharded_counter_t *c, sharded_counter_mode_t mode,
+                                       unsigned int shards) {
+    if (shards == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_CONF);
+        shards = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+    unsigned int n = 1;
+    while (n < shards) {
+        n <<= 1;
+    }
+
+    c->count = 0;
+    c->mode = mode;
+    c->mask = n - 1;
+    c->slots = (sharded_counter_slot_t *)aligned_alloc(CACHE_LINE_SIZE, n * sizeof(sharded_counter_slot_t));
+    if (c->slots == NULL) {
+        return -1;
+    }
+    memset(c->slots, 0, n * sizeof(sharded_counter_slot_t));
+    return 0;
+}
+
+static inline void sharded_counter_destroy(sharded_counter_t *c) {
+    free(c->slots);
+    c->slots = NULL;
+}
+
+static inline sharded_counter_slot_t *sharded_counter_slot(sharded_counter_t *c) {
+    unsigned int i;
+    if (c->mode == SHARDED_COUNTER_PER_CPU) {
+        int cpu = sched_getcpu();
+        i = cpu >= 0 ? (unsigned int)cpu : 0;
+    } else {
+        if (sharded_counter_thread_slot == 0) {
+            sharded_counter_thread_slot = __atomic_add_fetch(&sharded_counter_next_thread, 1, __ATOMIC_RELAXED);
+        }
+        i = sharded_counter_thread_slot - 1;
+    }
+    return &c->slots[i & c->mask];
+}
+
+// Add `delta` (may be negative). The shard update is relaxed: it orders
+// nothing else, and a counter read is not a synchronization point.
+static inline void sharded_counter_add(sharded_counter_t *c, int64_t delta) {
+    sharded_counter_slot_t *slot = sharded_counter_slot(c);
+    int64_t d = __atomic_add_fetch(&slot->delta, delta, __ATOMIC_RELAXED);
+    if (d >= SHARDED_COUNTER_BATCH || d <= -SHARDED_COUNTER_BATCH) {
+        // Move the whole delta over; another thread sharing the shard may
+        // have added to it meanwhile, which the exchange takes along too
+        int64_t moved = __atomic_exchange_n(&slot->delta, 0, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&c->count, moved, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void sharded_counter_inc(sharded_counter_t *c) {
+    sharded_counter_add(c, 1);
+}
+
+static inline void sharded_counter_dec(sharded_counter_t *c) {
+    sharded_counter_add(c, -1);
+}
+
+// Central count only: O(1), off by at most shards * SHARDED_COUNTER_BATCH
+static inline int64_t sharded_counter_read_approx(const sharded_counter_t *c) {
+    return __atomic_load_n(&c->count, __ATOMIC_RELAXED);
+}
+
+// Central count plus every shard's pending delta: O(shards). Exact when
+// no update is in progress; during updates it is some value the counter
+// passed through or is about to reach.
+static inline int64_t sharded_counter_read(const sharded_counter_t *c) {
+    int64_t sum = __atomic_load_n(&c->count, __ATOMIC_RELAXED);
+    for (unsigned int i = 0; i <= c->mask; i++) {
+        sum += __atomic_load_n(&c->slots[i].delta, __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+#endif // SHARDED_COUNTER_H
@@ -0,0 +1,462 @@
+/**
+ * simple_lock.h - Spin lock implementations sharing one init/acquire/release API
+ *
+ * This header provides:
+ * 1. simple_lock_t - the original flag/guard/queue lock (test and test-and-set),
+ *                    with an optional adaptive spin-then-futex mode; the
+ *                    queue of waiters is counted in a shared sharded_counter_t
+ *    padded_simple_lock_t / simple_lock_stripes_t - one lock per cache line
+ * 2. ticket_lock_t - a FIFO ticket lock
+ * 3. mcs_lock_t    - an MCS queue lock where every waiter spins on its own
+ *                    cache line
+ *
+ * Every lock is used the same way:
+ *     xxx_lock_init(&lock);
+ *     xxx_lock_acquire(&lock);
+ *     ... critical section ...
+ *     xxx_lock_release(&lock);
+ *
+ * Files including this header must define _GNU_SOURCE (or _DEFAULT_SOURCE)
+ * before their first #include so that usleep() and syscall() are declared.
+ *
+ * Defining SIMPLE_LOCK_STATS (make LOCK_STATS=1) gives every simple_lock_t
+ * a lock_stats_t with contention counters and wait/hold-time histograms.
+ * Without it the SIMPLE_LOCK_STATS_* hooks expand to nothing.
+ */
+
+#ifndef SIMPLE_LOCK_H
+#define SIMPLE_LOCK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h> // For usleep function
+
+#include "cpu.h"
+#include "futex.h"
+#include "sharded_counter.h"
+
+#ifdef SIMPLE_LOCK_STATS
+#include "lock_stats.h"
+
+#define SIMPLE_LOCK_STATS_BEGIN(probe) lock_stats_probe_t probe; lock_stats_probe_start(&probe)
+#define SIMPLE_LOCK_STATS_SPIN(probe) ((probe).spins++)
+#define SIMPLE_LOCK_STATS_PARK(probe) ((probe).parks++)
+#define SIMPLE_LOCK_STATS_ACQUIRED(lock, probe) lock_stats_acquired(&(lock)->stats, &(probe))
+#define SIMPLE_LOCK_STATS_RELEASING(lock) lock_stats_released(&(lock)->stats)
+
+// Print `lock`'s statistics under `name` to stderr when the program exits,
+// or right now to `out`
+#define SIMPLE_LOCK_STATS_REGISTER(lock, name) lock_stats_register(&(lock)->stats, (name))
+#define SIMPLE_LOCK_STATS_DUMP(lock, out) lock_stats_dump((out), &(lock)->stats, 0, true)
+#else
+#define SIMPLE_LOCK_STATS_BEGIN(probe) ((void)0)
+#define SIMPLE_LOCK_STATS_SPIN(probe) ((void)0)
+#define SIMPLE_LOCK_STATS_PARK(probe) ((void)0)
+#define SIMPLE_LOCK_STATS_ACQUIRED(lock, probe) ((void)0)
+#define SIMPLE_LOCK_STATS_RELEASING(lock) ((void)0)
+#define SIMPLE_LOCK_STATS_REGISTER(lock, name) ((void)0)
+#define SIMPLE_LOCK_STATS_DUMP(lock, out) ((void)0)
+#endif
+
+// ---------------------------------------------------------------------------
+// simple_lock_t: two-level flag/guard lock
+// ---------------------------------------------------------------------------
+
+// How a waiter in simple_lock_acquire passes its time
+typedef enum {
+    SIMPLE_LOCK_SLEEP,     // Retry after fixed usleep() intervals (the original lock)
+    SIMPLE_LOCK_ADAPTIVE   // Spin briefly, then park on a futex until released
+} simple_lock_mode_t;
+
+// Simple lock implementation
+typedef struct {
+    volatile bool flag;       // Main lock flag
+    volatile bool guard;      // Guard to protect the flag
+    simple_lock_mode_t mode;  // Waiting strategy chosen at init time
+    uint32_t wake_seq;        // Futex word bumped on every release that has sleepers
+    uint32_t parked;          // Adaptive waiters about to sleep on wake_seq
+    sharded_counter_t *queue; // Counts threads waiting to acquire (NULL: not counted)
+#ifdef SIMPLE_LOCK_STATS
+    lock_stats_t stats;       // Updated only by the thread holding the lock
+#endif
+} simple_lock_t;
+
+// Spin attempts before an adaptive waiter parks on the futex. Short critical
+// sections finish within this window, so the waiter never pays for a
+// syscall; long ones put the waiter to sleep instead of burning a core.
+#define SIMPLE_LOCK_SPIN_LIMIT 256
+
+// Initialize the lock with a specific waiting strategy
+static inline void simple_lock_init_mode(simple_lock_t *lock, simple_lock_mode_t mode) {
+    lock->flag = false;    // Not locked
+    lock->guard = false;   // Guard not in use
+    lock->mode = mode;
+    lock->wake_seq = 0;
+    lock->parked = 0;
+    lock->queue = NULL;    // Waiters are not counted until a counter is attached
+#ifdef SIMPLE_LOCK_STATS
+    lock_stats_init(&lock->stats);
+#endif
+}
+
+// Initialize the lock
+static inline void simple_lock_init(simple_lock_t *lock) {
+    simple_lock_init_mode(lock, SIMPLE_LOCK_SLEEP);
+}
+
+// Count the threads waiting for `lock` in `queue`. One counter may be
+// shared by many locks (all stripes of a simple_lock_stripes_t, say): each
+// waiter updates its own shard, so the count costs no shared cache line.
+static inline void simple_lock_count_waiters(simple_lock_t *lock, sharded_counter_t *queue) {
+    lock->queue = queue;
+}
+
+// Adaptive acquisition: spin on the guard/flag pair with PAUSE, then sleep
+// in the kernel.
+static inline void simple_lock_acquire_adaptive(simple_lock_t *lock) {
+    unsigned int attempts = 0;
+    SIMPLE_LOCK_STATS_BEGIN(probe);
+
+    while (true) {
+        // Read the wake sequence *before* checking the flag. If the holder
+        // releases after our check, it bumps wake_seq and futex_wait below
+        // returns immediately instead of sleeping through the wakeup.
+        uint32_t seq = __atomic_load_n(&lock->wake_seq, __ATOMIC_ACQUIRE);
+
+        unsigned int spins = 0;
+        while (__atomic_test_and_set(&lock->guard, __ATOMIC_ACQUIRE)) {
+            // The guard is only held for a few instructions
+            SIMPLE_LOCK_STATS_SPIN(probe);
+            spin_wait(&spins);
+        }
+
+        if (!__atomic_load_n(&lock->flag, __ATOMIC_SEQ_CST)) {
+            // Atomic because parking waiters read `flag` without the guard
+            __atomic_store_n(&lock->flag, true, __ATOMIC_RELAXED);
+            __atomic_clear(&lock->guard, __ATOMIC_RELEASE);
+            SIMPLE_LOCK_STATS_ACQUIRED(lock, probe);
+            return; // Lock acquired
+        }
+        __atomic_clear(&lock->guard, __ATOMIC_RELEASE);
+
+        if (attempts < SIMPLE_LOCK_SPIN_LIMIT) {
+            attempts++;
+            SIMPLE_LOCK_STATS_SPIN(probe);
+            cpu_relax();
+        } else {
+            // Park until the holder releases (or wake_seq already moved).
+            // Announce ourselves in `parked` before the last flag check, so
+            // the releaser either sees us or we see the lock free.
+            SIMPLE_LOCK_STATS_PARK(probe);
+            __atomic_fetch_add(&lock->parked, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&lock->flag, __ATOMIC_SEQ_CST)) {
+                futex_wait(&lock->wake_seq, seq);
+            }
+            __atomic_fetch_sub(&lock->parked, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Lock acquisition with queue
+static inline void simple_lock_acquire(simple_lock_t *lock) {
+    // Increment queue to indicate intention to acquire lock
+    if (lock->queue != NULL) {
+        sharded_counter_inc(lock->queue);
+    }
+
+    if (lock->mode == SIMPLE_LOCK_ADAPTIVE) {
+        simple_lock_acquire_adaptive(lock);
+        if (lock->queue != NULL) {
+            sharded_counter_dec(lock->queue);
+        }
+        return;
+    }
+
+    // Try to acquire the lock
+    SIMPLE_LOCK_STATS_BEGIN(probe);
+    while (true) {
+        // First, acquire the guard using atomic test-and-set
+        while (__atomic_test_and_set(&lock->guard, __ATOMIC_ACQUIRE)) {
+            // Spin waiting for the guard
+            SIMPLE_LOCK_STATS_SPIN(probe);
+            usleep(10);
+        }
+
+        // Check if the main lock is available
+        if (!lock->flag) {
+            // Lock is free, take it
+            lock->flag = true;
+            lock->guard = false; // Release the guard
+            break; // Lock acquired
+        }
+
+        // Lock is not available, release the guard and try again
+        lock->guard = false;
+        SIMPLE_LOCK_STATS_SPIN(probe);
+        usleep(100); // Short sleep to reduce CPU usage
+    }
+    SIMPLE_LOCK_STATS_ACQUIRED(lock, probe);
+
+    // Decrement queue as this thread now has the lock
+    if (lock->queue != NULL) {
+        sharded_counter_dec(lock->queue);
+    }
+}
+
+// Release the lock
+static inline void simple_lock_release(simple_lock_t *lock) {
+    SIMPLE_LOCK_STATS_RELEASING(lock);
+
+    if (lock->mode == SIMPLE_LOCK_ADAPTIVE) {
+        // The store and the `parked` load are both seq_cst: a waiter counts
+        // itself in `parked` before its last look at `flag`, so either we
+        // see it here or it sees the lock free and does not sleep.
+        __atomic_store_n(&lock->flag, false, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&lock->parked, __ATOMIC_SEQ_CST) != 0) {
+            __atomic_fetch_add(&lock->wake_seq, 1, __ATOMIC_RELEASE);
+            futex_wake(&lock->wake_seq, 1);
+        }
+        return;
+    }
+
+    // Simply release the lock flag (no need for guard here)
+    __atomic_store_n(&lock->flag, false, __ATOMIC_RELEASE);
+}
+
+// ---------------------------------------------------------------------------
+// padded_simple_lock_t and striped locks: one lock per cache line
+// ---------------------------------------------------------------------------
+
+// simple_lock_t is only a couple dozen bytes, so several locks (or a lock and the
+// data next to it) share one cache line. Every test-and-set on `guard` then
+// steals that line from all other cores, even from threads using a
+// different lock: false sharing. Aligning the lock to a cache line makes
+// sizeof(padded_simple_lock_t) a multiple of CACHE_LINE_SIZE (exactly one
+// line unless SIMPLE_LOCK_STATS adds its histograms), so neighbours in an
+// array or in a struct can never share its lines.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) simple_lock_t lock;
+} padded_simple_lock_t;
+
+#ifndef SIMPLE_LOCK_STATS
+_Static_assert(sizeof(padded_simple_lock_t) == CACHE_LINE_SIZE, "padded_simple_lock_t must be one cache line");
+#endif
+
+static inline void padded_simple_lock_init(padded_simple_lock_t *lock) {
+    simple_lock_init(&lock->lock);
+}
+
+static inline void padded_simple_lock_acquire(padded_simple_lock_t *lock) {
+    simple_lock_acquire(&lock->lock);
+}
+
+static inline void padded_simple_lock_release(padded_simple_lock_t *lock) {
+    simple_lock_release(&lock->lock);
+}
+
+// A fixed array of padded locks that protects a large keyed data set:
+// key k is guarded by stripe hash(k) % count. Unrelated keys rarely share
+// a stripe, so threads working on different keys rarely contend.
+typedef struct {
+    padded_simple_lock_t *stripes;  // Cache-line-aligned array
+    size_t mask;                    // count - 1 (count is a power of two)
+} simple_lock_stripes_t;
+
+// Allocate at least `count` stripes (rounded up to a power of two), all in
+// the given waiting mode. Returns 0 on success, -1 if allocation fails.
+static inline int simple_lock_stripes_init(simple_lock_stripes_t *s, size_t count,
+                                           simple_lock_mode_t mode) {
+    size_t n = 1;
+    while (n < count) {
+        n <<= 1;
+    }
+
+    s->stripes = (padded_simple_lock_t *)aligned_alloc(CACHE_LINE_SIZE,
+                                                       n * sizeof(padded_simple_lock_t));
+    if (s->stripes == NULL) {
+        s->mask = 0;
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        simple_lock_init_mode(&s->stripes[i].lock, mode);
+    }
+    s->mask = n - 1;
+    return 0;
+}
+
+// Stripe number of `key`. Keys are scrambled with a multiplicative hash
+// so that sequential keys spread over all stripes.
+static inline size_t simple_lock_stripe_index(const simple_lock_stripes_t *s, uint64_t key) {
+    uint64_t h = key * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h >> 32) & s->mask;
+}
+
+// The lock guarding `key`
+static inline simple_lock_t *simple_lock_stripe_for(simple_lock_stripes_t *s, uint64_t key) {
+    return &s->stripes[simple_lock_stripe_index(s, key)].lock;
+}
+
+static inline size_t simple_lock_stripes_count(const simple_lock_stripes_t *s) {
+    return s->mask + 1;
+}
+
+static inline void simple_lock_stripes_destroy(simple_lock_stripes_t *s) {
+    free(s->stripes);
+    s->stripes = NULL;
+    s->mask = 0;
+}
+
+// ---------------------------------------------------------------------------
+// ticket_lock_t: FIFO ticket lock
+// ---------------------------------------------------------------------------
+
+// A thread takes a ticket by incrementing next_ticket and waits until
+// now_serving reaches it, exactly like the numbered tickets at a deli
+// counter. Tickets are handed out in arrival order, so the lock is FIFO.
+// The two counters live on separate cache lines: arriving threads write
+// next_ticket while waiters only read now_serving.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) unsigned int next_ticket;  // Next ticket to hand out
+    _Alignas(CACHE_LINE_SIZE) unsigned int now_serving;  // Ticket that owns the lock
+} ticket_lock_t;
+
+// Pause iterations per thread ahead of us in the line. All waiters read the
+// same now_serving line, so backing off in proportion to our distance from
+// the front keeps most of them off the bus until their turn is close.
+#define TICKET_LOCK_BACKOFF 32
+
+// Initialize the lock
+static inline void ticket_lock_init(ticket_lock_t *lock) {
+    lock->next_ticket = 0;
+    lock->now_serving = 0;
+}
+
+// Take a ticket and wait for our number to come up
+static inline void ticket_lock_acquire(ticket_lock_t *lock) {
+    unsigned int my_ticket = __atomic_fetch_add(&lock->next_ticket, 1, __ATOMIC_RELAXED);
+    unsigned int spins = 0;
+
+    while (true) {
+        unsigned int serving = __atomic_load_n(&lock->now_serving, __ATOMIC_ACQUIRE);
+        if (serving == my_ticket) {
+            break; // Our turn
+        }
+
+        // Unsigned subtraction keeps working when the counters wrap around
+        unsigned int ahead = my_ticket - serving;
+        for (unsigned int i = 0; i < ahead * TICKET_LOCK_BACKOFF; i++) {
+            spin_wait(&spins);
+        }
+    }
+}
+
+// Hand the lock to the next ticket holder
+static inline void ticket_lock_release(ticket_lock_t *lock) {
+    // Only the owner writes now_serving, so a plain load is enough here
+    unsigned int next = lock->now_serving + 1;
+    __atomic_store_n(&lock->now_serving, next, __ATOMIC_RELEASE);
+}
+
+// ---------------------------------------------------------------------------
+// mcs_lock_t: MCS queue lock (Mellor-Crummey and Scott)
+// ---------------------------------------------------------------------------
+
+// Every waiter brings its own queue node and spins only on that node's
+// `locked` field. The releasing thread writes exactly one remote cache line
+// (its successor's node), so handoff costs a single cache-coherence round
+// trip no matter how many threads are waiting.
+typedef struct mcs_node {
+    _Alignas(CACHE_LINE_SIZE) struct mcs_node *next;  // Successor in the queue
+    bool locked;                                      // true while we must wait
+    bool in_use;                                      // Node taken from the thread pool
+} mcs_node_t;
+
+typedef struct {
+    mcs_node_t *tail;   // Last thread in the queue, NULL when the lock is free
+    mcs_node_t *owner;  // Node of the current holder (only the holder touches it)
+} mcs_lock_t;
+
+// How many MCS locks a single thread may hold at the same time when it uses
+// the plain acquire/release API
+#define MCS_MAX_HELD_LOCKS 8
+
+// Per-thread queue nodes used by mcs_lock_acquire/mcs_lock_release so that
+// the API matches the other locks. Callers that hold many locks at once can
+// pass their own nodes to mcs_lock_acquire_node instead.
+static _Thread_local mcs_node_t mcs_thread_nodes[MCS_MAX_HELD_LOCKS];
+
+// Initialize the lock
+static inline void mcs_lock_init(mcs_lock_t *lock) {
+    lock->tail = NULL;
+    lock->owner = NULL;
+}
+
+// Join the queue with a caller-provided node and wait for our turn
+static inline void mcs_lock_acquire_node(mcs_lock_t *lock, mcs_node_t *node) {
+    node->next = NULL;
+    node->locked = true;
+
+    // Atomically append ourselves to the queue
+    mcs_node_t *prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (prev != NULL) {
+        // Someone is ahead of us: link in behind them and spin on our own node
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        unsigned int spins = 0;
+        while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+            spin_wait(&spins);
+        }
+    }
+}
+
+// Pass the lock to our successor, or mark it free if nobody is waiting
+static inline void mcs_lock_release_node(mcs_lock_t *lock, mcs_node_t *node) {
+    mcs_node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+    if (next == NULL) {
+        // No visible successor: try to swing the tail back to empty
+        mcs_node_t *expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+
+        // A thread swapped itself into the tail but has not linked in yet
+        unsigned int spins = 0;
+        while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL) {
+            spin_wait(&spins);
+        }
+    }
+
+    __atomic_store_n(&next->locked, false, __ATOMIC_RELEASE);
+}
+
+// Acquire using one of this thread's built-in queue nodes
+static inline void mcs_lock_acquire(mcs_lock_t *lock) {
+    mcs_node_t *node = NULL;
+    for (int i = 0; i < MCS_MAX_HELD_LOCKS; i++) {
+        if (!mcs_thread_nodes[i].in_use) {
+            node = &mcs_thread_nodes[i];
+            break;
+        }
+    }
+    if (node == NULL) {
+        fprintf(stderr, "mcs_lock_acquire: more than %d MCS locks held by one thread\n",
+                MCS_MAX_HELD_LOCKS);
+        abort();
+    }
+
+    node->in_use = true;
+    mcs_lock_acquire_node(lock, node);
+    lock->owner = node; // Safe: we hold the lock now
+}
+
+// Release a lock taken with mcs_lock_acquire
+static inline void mcs_lock_release(mcs_lock_t *lock) {
+    mcs_node_t *node = lock->owner;
+    mcs_lock_release_node(lock, node);
+    node->in_use = false;
+}
+
+#endif // SIMPLE_LOCK_H
@@ -2,70 +2,41 @@
  * simple_threading.c - Demonstration of basic multithreading with a custom lock
  * 
  * This example shows:
- * 1. How to create and manage threads using POSIX threads (pthreads)
+ * 1. How to run tasks on a fixed-size pool of POSIX threads (pthreads)
  * 2. Implementation of a simple lock mechanism with flag, guard, and queue
  * 3. Thread synchronization where 3 threads acquire the lock one after another
+ * 4. Logging from inside the critical section without doing I/O there
+ * 5. Pinning the threads to CPUs: simple_threading [none|compact|scatter|cpu-list]
+ * 6. Splitting one big loop across the same threads with parallel_reduce
+ *
+ * The lock itself lives in simple_lock.h next to the FIFO ticket lock and
+ * the MCS queue lock, which share the same init/acquire/release API.
  */
 
+#define _GNU_SOURCE // For usleep under -std=c11
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <unistd.h> // For sleep function
 #include <stdbool.h> // For boolean type
 
-// Simple lock implementation
-typedef struct {
-    volatile bool flag;    // Main lock flag
-    volatile bool guard;   // Guard to protect the flag
-    int queue;             // Queue counter for waiting threads
-} simple_lock_t;
-
-// Initialize the lock
-void simple_lock_init(simple_lock_t *lock) {
-    lock->flag = false;    // Not locked
-    lock->guard = false;   // Guard not in use
-    lock->queue = 0;       // No waiting threads
-}
-
-// Lock acquisition with queue
-void simple_lock_acquire(simple_lock_t *lock) {
-    // Increment queue to indicate intention to acquire lock
-    __atomic_fetch_add(&lock->queue, 1, __ATOMIC_SEQ_CST);
-    
-    // Try to acquire the lock
-    while (true) {
-        // First, acquire the guard using atomic test-and-set
-        while (__atomic_test_and_set(&lock->guard, __ATOMIC_ACQUIRE)) {
-            // Spin waiting for the guard
-            usleep(10);
-        }
-        
-        // Check if the main lock is available
-        if (!lock->flag) {
-            // Lock is free, take it
-            lock->flag = true;
-            lock->guard = false; // Release the guard
-            break; // Lock acquired
-        }
-        
-        // Lock is not available, release the guard and try again
-        lock->guard = false;
-        usleep(100); // Short sleep to reduce CPU usage
-    }
-    
-    // Decrement queue as this thread now has the lock
-    __atomic_fetch_sub(&lock->queue, 1, __ATOMIC_SEQ_CST);
-}
-
-// Release the lock
-void simple_lock_release(simple_lock_t *lock) {
-    // Simply release the lock flag (no need for guard here)
-    __atomic_store_n(&lock->flag, false, __ATOMIC_RELEASE);
-}
+#include "simple_lock.h" // simple_lock_t, ticket_lock_t, mcs_lock_t
+#include "thread_pool.h" // Work-stealing pool that runs the tasks
+#include "parallel.h"    // parallel_for / parallel_reduce on the pool
+#include "async_log.h"   // Lock-free per-thread log buffers
+#include "affinity.h"    // Thread placement policies
 
 // Global lock
 simple_lock_t lock;
 
+// Threads waiting for `lock` (its queue), counted per thread
+sharded_counter_t lock_queue;
+
+// Output from the tasks. printf would take stdio's lock and may call
+// write(2) while we hold `lock`; async_log only copies into a ring buffer.
+async_log_t task_log;
+
 // Thread function
 void* thread_function(void *arg) {
     int thread_id = *((int*)arg);
@@ -74,12 +45,13 @@ void* thread_function(void *arg) {
     simple_lock_acquire(&lock);
     
     // Critical section
-    printf("Hello from thread #%d\n", thread_id);
+    async_log_printf(&task_log, "Hello from thread #%d (%lld waiting)\n", thread_id,
+                     (long long)sharded_counter_read(&lock_queue));
     
     // Sleep to simulate some work
     sleep(1);
     
-    printf("Thread #%d releasing the lock\n", thread_id);
+    async_log_printf(&task_log, "Thread #%d releasing the lock\n", thread_id);
     
     // Release the lock
     simple_lock_release(&lock);
@@ -87,32 +59,75 @@ void* thread_function(void *arg) {
     return NULL;
 }
 
-int main() {
-    pthread_t threads[3];
+int main(int argc, char **argv) {
+    thread_pool_t pool;
+    affinity_plan_t placement;
     int thread_ids[3] = {1, 2, 3};
+
+    // Optional placement policy, e.g. "compact" or "0,2,4"; default: none
+    if (affinity_plan_init(&placement, argc > 1 ? argv[1] : NULL) != 0) {
+        fprintf(stderr, "Usage: %s [none|compact|scatter|cpu-list]\n", argv[0]);
+        return 1;
+    }
     
-    // Initialize the lock
+    // Initialize the lock and attach its queue counter
     simple_lock_init(&lock);
+    if (sharded_counter_init(&lock_queue, SHARDED_COUNTER_PER_THREAD, 0) != 0) {
+        perror("Failed to create the queue counter");
+        return 1;
+    }
+    simple_lock_count_waiters(&lock, &lock_queue);
+    SIMPLE_LOCK_STATS_REGISTER(&lock, "lock"); // Dumps to stderr at exit with LOCK_STATS=1
+    
+    printf("Starting threads (placement: %s)...\n", affinity_policy_name(placement.policy));
+    fflush(stdout); // The log writes to the same fd, bypassing stdio
+
+    if (async_log_init(&task_log, STDOUT_FILENO, 0) != 0) {
+        perror("Failed to start the logger");
+        return 1;
+    }
     
-    printf("Starting threads...\n");
+    // Start a fixed set of worker threads once, instead of one pthread per task
+    if (thread_pool_init_affinity(&pool, 3, &placement) != 0) {
+        perror("Failed to create thread pool");
+        return 1;
+    }
     
-    // Create threads
+    // Hand each task to the pool
     for (int i = 0; i < 3; i++) {
-        if (pthread_create(&threads[i], NULL, thread_function, &thread_ids[i]) != 0) {
-            perror("Failed to create thread");
+        if (thread_pool_submit(&pool, thread_function, &thread_ids[i]) != 0) {
+            perror("Failed to submit task");
             return 1;
         }
-        
-        // Small delay between thread creations
-        usleep(10000);
     }
     
-    // Wait for all threads to complete
-    for (int i = 0; i < 3; i++) {
-        pthread_join(threads[i], NULL);
-    }
+    // Wait for all tasks to complete
+    thread_pool_wait(&pool);
+    async_log_destroy(&task_log); // Writes whatever is still buffered
     
     printf("All threads have completed\n");
     
+    // Data-parallel work on the same workers: the array is summed in chunks,
+    // each thread into its own partial sum, so no lock is needed
+    size_t count = 1u << 20;
+    int *numbers = (int *)malloc(count * sizeof(int));
+    if (numbers == NULL) {
+        perror("Failed to allocate the array");
+        return 1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        numbers[i] = (int)(i % 100);
+    }
+    int lo, hi;
+    parallel_array_minmax(&pool, numbers, count, &lo, &hi);
+    printf("Parallel sum of %zu numbers: %lld (min %d, max %d)\n",
+           count, parallel_array_sum(&pool, numbers, count), lo, hi);
+    free(numbers);
+    
+    // Stop the workers
+    thread_pool_destroy(&pool);
+    affinity_plan_destroy(&placement);
+    sharded_counter_destroy(&lock_queue);
+    
     return 0;
 }
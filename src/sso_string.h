@@ -0,0 +1,278 @@
+/**
+ * sso_string.h - Length-prefixed strings with small-string optimization
+ *
+ * array_pointer_relationship contrasts `char str[]` with `char *str_ptr`.
+ * Both leave the length implicit, so every use pays for strlen().
+ * sso_string_t carries its length and comes in three storage modes,
+ * all in the same 24 bytes (on 64-bit targets):
+ *
+ * 1. small    - up to SSO_SMALL_CAPACITY (23) characters stored inside the
+ *               struct itself: no heap allocation at all
+ * 2. heap     - an owned, NUL-terminated malloc buffer with explicit
+ *               capacity that grows by doubling
+ * 3. borrowed - a read-only view of characters owned by someone else: a
+ *               wrapped string literal or a slice of a longer string
+ *
+ *     sso_string_t s;
+ *     SSO_WRAP_LITERAL(&s, "Hello");          // no copy, no strlen
+ *     sso_append(&s, ", World", 7);           // copies into inline storage
+ *     printf("%.*s (%zu)\n", (int)sso_len(&s), sso_data(&s), sso_len(&s));
+ *     sso_free(&s);
+ *
+ * Length is always O(1). Appends never rescan what is already there. The
+ * first append to a borrowed string copies it into owned storage.
+ * Borrowed slices are not NUL-terminated, so print with "%.*s". Owned strings
+ * (small or heap) always are; sso_cstr() returns NULL for borrowed ones.
+ *
+ * The storage mode lives in the struct's last byte. For small strings that
+ * byte holds the number of free inline bytes, which becomes the NUL
+ * terminator when the string is exactly 23 characters long. For heap and
+ * borrowed strings it is a flag byte that sits in the highest byte of the
+ * capacity word.
+ */
+
+#ifndef SSO_STRING_H
+#define SSO_STRING_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    union {
+        struct {
+            const char *ptr;   // Heap buffer or borrowed characters
+            size_t len;
+            size_t cap_tag;    // Capacity, with the mode byte in its last byte
+        } large;
+        char small[3 * sizeof(size_t)];
+    } u;
+} sso_string_t;
+
+// Characters that fit inline (23 on 64-bit targets); the last byte is the tag
+#define SSO_SMALL_CAPACITY (sizeof(sso_string_t) - 1)
+
+// Tag values. Small strings store SSO_SMALL_CAPACITY - len (always < 0x40).
+#define SSO_TAG_HEAP 0x80
+#define SSO_TAG_BORROWED 0x40
+
+// The tag is the struct's last byte. That is the top byte of cap_tag on a
+// little-endian machine and its bottom byte on a big-endian one.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SSO_CAP_ENCODE(cap, tag) (((size_t)(cap) << 8) | (tag))
+#define SSO_CAP_DECODE(word) ((word) >> 8)
+#else
+#define SSO_CAP_SHIFT ((sizeof(size_t) - 1) * 8)
+#define SSO_CAP_ENCODE(cap, tag) ((size_t)(cap) | ((size_t)(tag) << SSO_CAP_SHIFT))
+#define SSO_CAP_DECODE(word) ((word) & (((size_t)1 << SSO_CAP_SHIFT) - 1))
+#endif
+
+// Largest heap capacity the encoding can hold (the mode byte takes 8 bits)
+#define SSO_MAX_CAPACITY (SIZE_MAX >> 9)
+
+static inline unsigned char sso_tag(const sso_string_t *s) {
+    return (unsigned char)s->u.small[SSO_SMALL_CAPACITY];
+}
+
+static inline bool sso_is_small(const sso_string_t *s) {
+    return sso_tag(s) < SSO_TAG_BORROWED;
+}
+
+static inline bool sso_is_borrowed(const sso_string_t *s) {
+    return sso_tag(s) == SSO_TAG_BORROWED;
+}
+
+// ---------------------------------------------------------------------------
+// Queries
+// ---------------------------------------------------------------------------
+
+static inline size_t sso_len(const sso_string_t *s) {
+    return sso_is_small(s) ? SSO_SMALL_CAPACITY - sso_tag(s) : s->u.large.len;
+}
+
+static inline const char *sso_data(const sso_string_t *s) {
+    return sso_is_small(s) ? s->u.small : s->u.large.ptr;
+}
+
+// NUL-terminated characters of an owned string; NULL for borrowed ones
+// (a slice ends wherever its length says, not at a NUL)
+static inline const char *sso_cstr(const sso_string_t *s) {
+    return sso_is_borrowed(s) ? NULL : sso_data(s);
+}
+
+// Characters the string can hold without reallocating (0 when borrowed)
+static inline size_t sso_capacity(const sso_string_t *s) {
+    if (sso_is_small(s)) {
+        return SSO_SMALL_CAPACITY;
+    }
+    return sso_is_borrowed(s) ? 0 : SSO_CAP_DECODE(s->u.large.cap_tag);
+}
+
+static inline bool sso_equals(const sso_string_t *a, const sso_string_t *b) {
+    size_t len = sso_len(a);
+    return len == sso_len(b) && memcmp(sso_data(a), sso_data(b), len) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Construction
+// ---------------------------------------------------------------------------
+
+static inline void sso_set_small_len(sso_string_t *s, size_t len) {
+    s->u.small[len] = '\0';
+    s->u.small[SSO_SMALL_CAPACITY] = (char)(SSO_SMALL_CAPACITY - len);
+}
+
+// Empty small string
+static inline void sso_init(sso_string_t *s) {
+    sso_set_small_len(s, 0);
+}
+
+static inline void sso_free(sso_string_t *s) {
+    if (sso_tag(s) == SSO_TAG_HEAP) {
+        free((char *)s->u.large.ptr);
+    }
+    sso_init(s);
+}
+
+// Borrow `len` characters without copying. They must outlive the string
+// and must not change while it borrows them.
+static inline void sso_wrap(sso_string_t *s, const char *chars, size_t len) {
+    s->u.large.ptr = chars;
+    s->u.large.len = len;
+    s->u.large.cap_tag = SSO_CAP_ENCODE(0, SSO_TAG_BORROWED);
+}
+
+// Wrap a string literal; its length is a compile-time constant. The ""
+// around `lit` makes passing anything but a literal a compile error.
+#define SSO_WRAP_LITERAL(s, lit) sso_wrap((s), "" lit "", sizeof(lit) - 1)
+
+// Make s an owned string with room for at least `capacity` characters,
+// keeping its contents. Returns -1 (leaving s alone) when out of memory.
+static inline int sso_reserve(sso_string_t *s, size_t capacity) {
+    size_t len = sso_len(s);
+    if (capacity < len) {
+        capacity = len;
+    }
+    if (!sso_is_borrowed(s) && capacity <= sso_capacity(s)) {
+        return 0;
+    }
+    if (capacity <= SSO_SMALL_CAPACITY) {
+        // Only a borrowed string gets here: pull it inline
+        const char *chars = s->u.large.ptr;
+        memmove(s->u.small, chars, len);
+        sso_set_small_len(s, len);
+        return 0;
+    }
+    if (capacity > SSO_MAX_CAPACITY) {
+        return -1;
+    }
+
+    char *buf = (char *)malloc(capacity + 1);
+    if (buf == NULL) {
+        return -1;
+    }
+    memcpy(buf, sso_data(s), len);
+    buf[len] = '\0';
+    if (sso_tag(s) == SSO_TAG_HEAP) {
+        free((char *)s->u.large.ptr);
+    }
+    s->u.large.ptr = buf;
+    s->u.large.len = len;
+    s->u.large.cap_tag = SSO_CAP_ENCODE(capacity, SSO_TAG_HEAP);
+    return 0;
+}
+
+// Owned copy of `len` characters: inline when they fit, else one malloc
+static inline int sso_from_buf(sso_string_t *s, const char *chars, size_t len) {
+    sso_wrap(s, chars, len);
+    if (sso_reserve(s, len) != 0) {
+        sso_init(s);
+        return -1;
+    }
+    return 0;
+}
+
+static inline int sso_from_cstr(sso_string_t *s, const char *cstr) {
+    return sso_from_buf(s, cstr, strlen(cstr));
+}
+
+// ---------------------------------------------------------------------------
+// Modification
+// ---------------------------------------------------------------------------
+
+// Append `n` characters. Only the new ones are copied; when the capacity
+// runs out it at least doubles, so repeated appends are amortized O(n).
+// `chars` may point into s itself.
+static inline int sso_append(sso_string_t *s, const char *chars, size_t n) {
+    size_t len = sso_len(s);
+    if (n > SSO_MAX_CAPACITY - len) {
+        return -1;
+    }
+    if (sso_is_borrowed(s) || len + n > sso_capacity(s)) {
+        size_t capacity = sso_capacity(s) * 2;
+        if (capacity < len + n) {
+            capacity = len + n;
+        }
+        if (capacity > SSO_MAX_CAPACITY) {
+            capacity = SSO_MAX_CAPACITY;
+        }
+
+        // Remember `chars` as an offset if it points into our old buffer
+        const char *old = sso_data(s);
+        bool inside = chars >= old && chars < old + len;
+        size_t offset = inside ? (size_t)(chars - old) : 0;
+        if (sso_reserve(s, capacity) != 0) {
+            return -1;
+        }
+        if (inside) {
+            chars = sso_data(s) + offset;
+        }
+    }
+
+    // A string still small here always has room inline; the redundant
+    // length test lets -O3's bounds checking see that too
+    if (sso_is_small(s) && n <= SSO_SMALL_CAPACITY && len <= SSO_SMALL_CAPACITY - n) {
+        memmove(s->u.small + len, chars, n);
+        sso_set_small_len(s, len + n);
+    } else {
+        char *buf = (char *)s->u.large.ptr;
+        memmove(buf + len, chars, n);
+        buf[len + n] = '\0';
+        s->u.large.len = len + n;
+    }
+    return 0;
+}
+
+static inline int sso_append_cstr(sso_string_t *s, const char *cstr) {
+    return sso_append(s, cstr, strlen(cstr));
+}
+
+static inline int sso_append_sso(sso_string_t *s, const sso_string_t *other) {
+    return sso_append(s, sso_data(other), sso_len(other));
+}
+
+// Characters [pos, pos + n) of s, clamped to its length, without
+// rescanning. Short slices are copied inline. Longer ones borrow from s,
+// so they are only valid while s is alive and unmodified.
+static inline sso_string_t sso_slice(const sso_string_t *s, size_t pos, size_t n) {
+    size_t len = sso_len(s);
+    if (pos > len) {
+        pos = len;
+    }
+    if (n > len - pos) {
+        n = len - pos;
+    }
+
+    sso_string_t slice;
+    if (n <= SSO_SMALL_CAPACITY) {
+        memcpy(slice.u.small, sso_data(s) + pos, n);
+        sso_set_small_len(&slice, n);
+    } else {
+        sso_wrap(&slice, sso_data(s) + pos, n);
+    }
+    return slice;
+}
+
+#endif // SSO_STRING_H
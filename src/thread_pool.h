@@ -0,0 +1,535 @@
+/**
+ * thread_pool.h - Fixed-size work-stealing thread pool
+ *
+ * Creating a pthread costs tens of microseconds, which dwarfs short tasks.
+ * A pool starts its worker threads once and then hands them tasks:
+ *
+ *     thread_pool_t pool;
+ *     thread_pool_init(&pool, 4);
+ *     thread_pool_submit(&pool, thread_function, &arg);  // any void*(*)(void*)
+ *     thread_pool_wait(&pool);                           // all tasks finished
+ *     thread_pool_destroy(&pool);
+ *
+ * Every worker owns a Chase-Lev deque. Tasks submitted from inside a task
+ * are pushed onto the submitting worker's own deque without any locking;
+ * the owner pops from the bottom (newest first, cache-warm), and idle
+ * workers steal from the top of other deques (oldest first). Tasks
+ * submitted from outside the pool go through a small locked injection
+ * queue. Idle workers spin briefly and then park on a futex, so an idle
+ * pool uses no CPU.
+ *
+ * thread_pool_wait may also be called from inside a task. The waiting task
+ * (and any task it is nested in) cannot finish while it waits, so it does
+ * not wait for itself, nor for other tasks that are blocked in
+ * thread_pool_wait the same way; it returns once every other task is done.
+ * To wait for just the tasks you submitted, count them yourself, the way
+ * parallel.h does.
+ *
+ * thread_pool_init_affinity pins the workers with an affinity_plan_t
+ * (see affinity.h) and puts each worker's deque on its CPU's NUMA node.
+ *
+ * Files including this header must define _GNU_SOURCE before their first
+ * #include (see simple_lock.h).
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "cpu.h"
+#include "futex.h"
+#include "simple_lock.h"
+#include "affinity.h"
+
+// Tasks per worker deque (a power of two). When a worker's deque is full,
+// thread_pool_submit runs the new task inline instead.
+#define THREAD_POOL_DEQUE_SIZE 4096
+
+// Failed find-work rounds before an idle worker parks on the futex
+#define THREAD_POOL_IDLE_SPINS 2048
+
+// A unit of work, in the same shape as a pthread start routine
+typedef struct {
+    void *(*fn)(void *);
+    void *arg;
+} thread_pool_task_t;
+
+// ---------------------------------------------------------------------------
+// Chase-Lev work-stealing deque
+// ---------------------------------------------------------------------------
+
+// Only the owning worker touches `bottom` (push and pop); thieves race for
+// `top` with a compare-and-swap. The two ends live on different cache lines
+// so the owner's pushes do not disturb thieves and vice versa.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) int64_t top;      // Next task to steal
+    _Alignas(CACHE_LINE_SIZE) int64_t bottom;   // Next free slot for the owner
+    thread_pool_task_t *slots;                  // THREAD_POOL_DEQUE_SIZE tasks
+} ws_deque_t;
+
+#define WS_DEQUE_BYTES (THREAD_POOL_DEQUE_SIZE * sizeof(thread_pool_task_t))
+
+// Allocate the slots on NUMA node `node` (-1: wherever they are first touched)
+static inline int ws_deque_init(ws_deque_t *dq, int node) {
+    dq->top = 0;
+    dq->bottom = 0;
+    dq->slots = (thread_pool_task_t *)affinity_alloc_on_node(WS_DEQUE_BYTES, node);
+    return dq->slots != NULL ? 0 : -1;
+}
+
+static inline void ws_deque_destroy(ws_deque_t *dq) {
+    affinity_free(dq->slots, WS_DEQUE_BYTES);
+    dq->slots = NULL;
+}
+
+// Slot fields are accessed atomically because a thief may read a slot the
+// owner is about to reuse; the thief's CAS on `top` then fails and the
+// value it read is thrown away.
+static inline void ws_slot_store(thread_pool_task_t *slot, thread_pool_task_t task) {
+    __atomic_store_n(&slot->fn, task.fn, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->arg, task.arg, __ATOMIC_RELAXED);
+}
+
+static inline thread_pool_task_t ws_slot_load(thread_pool_task_t *slot) {
+    thread_pool_task_t task;
+    task.fn = __atomic_load_n(&slot->fn, __ATOMIC_RELAXED);
+    task.arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+    return task;
+}
+
+// Owner only: push a task on the bottom. Returns false when full.
+static inline bool ws_deque_push(ws_deque_t *dq, thread_pool_task_t task) {
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    if (b - t >= THREAD_POOL_DEQUE_SIZE) {
+        return false;
+    }
+    ws_slot_store(&dq->slots[b & (THREAD_POOL_DEQUE_SIZE - 1)], task);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+// Owner only: pop the newest task. Returns false when empty.
+static inline bool ws_deque_pop(ws_deque_t *dq, thread_pool_task_t *out) {
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        // Empty: undo the reservation
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    *out = ws_slot_load(&dq->slots[b & (THREAD_POOL_DEQUE_SIZE - 1)]);
+    if (t == b) {
+        // Last task: race the thieves for it
+        bool won = __atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+                                               __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+// Any thread: steal the oldest task. Returns false when empty or when
+// another thread won the race (callers simply try elsewhere).
+static inline bool ws_deque_steal(ws_deque_t *dq, thread_pool_task_t *out) {
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return false;
+    }
+
+    *out = ws_slot_load(&dq->slots[t & (THREAD_POOL_DEQUE_SIZE - 1)]);
+    return __atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+// ---------------------------------------------------------------------------
+// Thread pool
+// ---------------------------------------------------------------------------
+
+struct thread_pool;
+
+// Tasks of one pool that are running on one thread, nested inside each
+// other through thread_pool_wait
+typedef struct {
+    struct thread_pool *pool;
+    int running;        // Tasks on this thread's stack
+    int blocked;        // How many of those are counted in pool->blocked
+} thread_pool_nesting_t;
+
+typedef struct {
+    ws_deque_t deque;
+    struct thread_pool *pool;
+    pthread_t thread;
+    unsigned int seed;  // For picking steal victims
+    int index;
+    thread_pool_nesting_t nesting;
+} thread_pool_worker_t;
+
+typedef struct thread_pool {
+    thread_pool_worker_t *workers;
+    int num_workers;
+
+    // Injection queue for tasks submitted from outside the pool: a growable
+    // ring buffer guarded by an adaptive simple_lock_t
+    simple_lock_t inject_lock;
+    thread_pool_task_t *inject;
+    size_t inject_head;
+    size_t inject_count;
+    size_t inject_cap;
+
+    _Alignas(CACHE_LINE_SIZE) uint32_t pending;  // Submitted but not finished
+    uint32_t blocked;                            // Pending tasks stuck in thread_pool_wait
+    uint32_t wait_seq;                           // Futex word for thread_pool_wait
+    _Alignas(CACHE_LINE_SIZE) uint32_t work_seq; // Futex word for idle workers
+    int sleepers;                                // Workers parked on work_seq
+    int waiters;                                 // Threads parked in thread_pool_wait
+    volatile bool stop;
+} thread_pool_t;
+
+// The worker running on this thread, or NULL outside the pool
+static _Thread_local thread_pool_worker_t *thread_pool_current_worker = NULL;
+
+// The worker's nesting record, or that of a thread helping in
+// thread_pool_wait; NULL otherwise
+static _Thread_local thread_pool_nesting_t *thread_pool_current_nesting = NULL;
+
+// Lock-protected push onto the injection queue. Returns -1 on OOM.
+static inline int thread_pool_inject(thread_pool_t *pool, thread_pool_task_t task) {
+    simple_lock_acquire(&pool->inject_lock);
+    if (pool->inject_count == pool->inject_cap) {
+        size_t cap = pool->inject_cap * 2;
+        thread_pool_task_t *ring = (thread_pool_task_t *)malloc(cap * sizeof(thread_pool_task_t));
+        if (ring == NULL) {
+            simple_lock_release(&pool->inject_lock);
+            return -1;
+        }
+        // Unwrap the old ring into the start of the new one
+        for (size_t i = 0; i < pool->inject_count; i++) {
+            ring[i] = pool->inject[(pool->inject_head + i) % pool->inject_cap];
+        }
+        free(pool->inject);
+        pool->inject = ring;
+        pool->inject_head = 0;
+        pool->inject_cap = cap;
+    }
+    pool->inject[(pool->inject_head + pool->inject_count) % pool->inject_cap] = task;
+    __atomic_store_n(&pool->inject_count, pool->inject_count + 1, __ATOMIC_RELAXED);
+    simple_lock_release(&pool->inject_lock);
+    return 0;
+}
+
+static inline bool thread_pool_take_injected(thread_pool_t *pool, thread_pool_task_t *out) {
+    // Cheap unlocked peek so idle workers don't hammer the lock
+    if (__atomic_load_n(&pool->inject_count, __ATOMIC_RELAXED) == 0) {
+        return false;
+    }
+
+    bool found = false;
+    simple_lock_acquire(&pool->inject_lock);
+    if (pool->inject_count > 0) {
+        *out = pool->inject[pool->inject_head];
+        pool->inject_head = (pool->inject_head + 1) % pool->inject_cap;
+        __atomic_store_n(&pool->inject_count, pool->inject_count - 1, __ATOMIC_RELAXED);
+        found = true;
+    }
+    simple_lock_release(&pool->inject_lock);
+    return found;
+}
+
+// Look for work anywhere: our own deque, the injection queue, then the
+// other workers' deques starting at a random victim. `self` may be NULL
+// for a thread helping from thread_pool_wait.
+static inline bool thread_pool_find_task(thread_pool_t *pool, thread_pool_worker_t *self,
+                                         thread_pool_task_t *out) {
+    if (self != NULL && ws_deque_pop(&self->deque, out)) {
+        return true;
+    }
+    if (thread_pool_take_injected(pool, out)) {
+        return true;
+    }
+
+    int n = pool->num_workers;
+    int start = 0;
+    if (self != NULL) {
+        self->seed = self->seed * 1103515245u + 12345u;
+        start = (int)((self->seed >> 16) % (unsigned int)n);
+    }
+    for (int i = 0; i < n; i++) {
+        thread_pool_worker_t *victim = &pool->workers[(start + i) % n];
+        if (victim != self && ws_deque_steal(&victim->deque, out)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Wake the threads parked in thread_pool_wait if one of them may be done:
+// only blocked tasks are left. Called after `pending` drops or `blocked`
+// grows; with seq_cst on both sides either we see the waiter or it sees
+// the change when it re-checks.
+static inline void thread_pool_wake_waiters(thread_pool_t *pool) {
+    if (__atomic_load_n(&pool->waiters, __ATOMIC_SEQ_CST) != 0 &&
+        __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) <=
+            __atomic_load_n(&pool->blocked, __ATOMIC_SEQ_CST)) {
+        __atomic_fetch_add(&pool->wait_seq, 1, __ATOMIC_RELEASE);
+        futex_wake(&pool->wait_seq, INT_MAX);
+    }
+}
+
+// Run one task and account for its completion
+static inline void thread_pool_run_task(thread_pool_t *pool, thread_pool_task_t task) {
+    thread_pool_nesting_t *nesting = thread_pool_current_nesting;
+    if (nesting != NULL && nesting->pool != pool) {
+        nesting = NULL;
+    }
+    if (nesting != NULL) {
+        nesting->running++;
+    }
+    task.fn(task.arg);
+    if (nesting != NULL) {
+        nesting->running--;
+    }
+    __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    thread_pool_wake_waiters(pool);
+}
+
+// Wake one parked worker if there are any. Called after publishing a task.
+static inline void thread_pool_notify(thread_pool_t *pool) {
+    // Pairs with the seq_cst increment of `sleepers` in thread_pool_worker_main:
+    // either we see the sleeper or it sees our task when it re-checks.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_RELAXED) != 0) {
+        __atomic_fetch_add(&pool->work_seq, 1, __ATOMIC_RELEASE);
+        futex_wake(&pool->work_seq, 1);
+    }
+}
+
+static inline void *thread_pool_worker_main(void *arg) {
+    thread_pool_worker_t *self = (thread_pool_worker_t *)arg;
+    thread_pool_t *pool = self->pool;
+    thread_pool_current_worker = self;
+    thread_pool_current_nesting = &self->nesting;
+
+    unsigned int idle = 0;
+    while (!__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE)) {
+        thread_pool_task_t task;
+        if (thread_pool_find_task(pool, self, &task)) {
+            thread_pool_run_task(pool, task);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < THREAD_POOL_IDLE_SPINS) {
+            cpu_relax();
+            continue;
+        }
+
+        // Park: announce ourselves, re-check for work, then sleep until a
+        // submitter bumps work_seq
+        uint32_t seq = __atomic_load_n(&pool->work_seq, __ATOMIC_ACQUIRE);
+        __atomic_fetch_add(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        if (thread_pool_find_task(pool, self, &task)) {
+            __atomic_fetch_sub(&pool->sleepers, 1, __ATOMIC_RELAXED);
+            thread_pool_run_task(pool, task);
+        } else if (!__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE)) {
+            futex_wait(&pool->work_seq, seq);
+            __atomic_fetch_sub(&pool->sleepers, 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_fetch_sub(&pool->sleepers, 1, __ATOMIC_RELAXED);
+        }
+        idle = 0;
+    }
+    return NULL;
+}
+
+// Stop the workers, join the first `started` of them and free everything
+static inline void thread_pool_shutdown(thread_pool_t *pool, int started) {
+    __atomic_store_n(&pool->stop, true, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&pool->work_seq, 1, __ATOMIC_RELEASE);
+    futex_wake(&pool->work_seq, INT_MAX);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    if (pool->workers != NULL) {
+        for (int i = 0; i < pool->num_workers; i++) {
+            ws_deque_destroy(&pool->workers[i].deque);
+        }
+    }
+    free(pool->workers);
+    free(pool->inject);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Start `num_workers` worker threads, worker i pinned to the plan's i-th
+// CPU (plan NULL or "none": not pinned). Returns 0 on success, -1 on
+// failure (in which case nothing needs to be destroyed).
+static inline int thread_pool_init_affinity(thread_pool_t *pool, int num_workers,
+                                            const affinity_plan_t *plan) {
+    memset(pool, 0, sizeof(*pool));
+    if (num_workers <= 0) {
+        return -1;
+    }
+
+    simple_lock_init_mode(&pool->inject_lock, SIMPLE_LOCK_ADAPTIVE);
+    pool->inject_cap = 64;
+    pool->inject = (thread_pool_task_t *)malloc(pool->inject_cap * sizeof(thread_pool_task_t));
+    pool->workers = (thread_pool_worker_t *)aligned_alloc(
+        CACHE_LINE_SIZE, num_workers * sizeof(thread_pool_worker_t));
+    if (pool->inject == NULL || pool->workers == NULL) {
+        thread_pool_shutdown(pool, 0);
+        return -1;
+    }
+
+    memset(pool->workers, 0, num_workers * sizeof(thread_pool_worker_t));
+    pool->num_workers = num_workers;
+    for (int i = 0; i < num_workers; i++) {
+        thread_pool_worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->nesting.pool = pool;
+        w->index = i;
+        w->seed = 0x9e3779b9u * (unsigned int)(i + 1);
+        int cpu = affinity_plan_cpu(plan, i);
+        if (ws_deque_init(&w->deque, cpu >= 0 ? affinity_cpu_node(cpu) : -1) != 0) {
+            thread_pool_shutdown(pool, 0);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_attr_t attr;
+        if (affinity_attr_init(&attr, plan, i) != 0) {
+            thread_pool_shutdown(pool, i);
+            return -1;
+        }
+        int rc = pthread_create(&pool->workers[i].thread, &attr, thread_pool_worker_main,
+                                &pool->workers[i]);
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            thread_pool_shutdown(pool, i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Start `num_workers` unpinned worker threads
+static inline int thread_pool_init(thread_pool_t *pool, int num_workers) {
+    return thread_pool_init_affinity(pool, num_workers, NULL);
+}
+
+// Queue fn(arg) for execution. Called from a task, it goes onto the
+// current worker's deque; from any other thread, onto the injection queue.
+// Returns 0 on success, -1 if the task could not be queued.
+static inline int thread_pool_submit(thread_pool_t *pool, void *(*fn)(void *), void *arg) {
+    thread_pool_task_t task = {fn, arg};
+    __atomic_fetch_add(&pool->pending, 1, __ATOMIC_RELAXED);
+
+    thread_pool_worker_t *self = thread_pool_current_worker;
+    if (self != NULL && self->pool == pool) {
+        if (!ws_deque_push(&self->deque, task)) {
+            // Deque full: running the task now is always correct
+            thread_pool_run_task(pool, task);
+            return 0;
+        }
+    } else if (thread_pool_inject(pool, task) != 0) {
+        __atomic_fetch_sub(&pool->pending, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    thread_pool_notify(pool);
+    return 0;
+}
+
+// Block until every submitted task (including tasks submitted by tasks)
+// has finished. The calling thread helps run tasks while it waits.
+//
+// From inside a task, `pending` still counts the calling task, so the wait
+// ends instead when only blocked tasks are left: this thread's own, and
+// those of other tasks waiting here at the same time.
+static inline void thread_pool_wait(thread_pool_t *pool) {
+    thread_pool_worker_t *self = thread_pool_current_worker;
+    if (self != NULL && self->pool != pool) {
+        self = NULL;
+    }
+
+    // Tasks we run while helping are nested on our stack too, so a thread
+    // from outside the pool needs a nesting record while it waits
+    thread_pool_nesting_t *saved = thread_pool_current_nesting;
+    thread_pool_nesting_t local = {pool, 0, 0};
+    thread_pool_nesting_t *nesting = saved;
+    if (nesting == NULL || nesting->pool != pool) {
+        nesting = &local;
+        thread_pool_current_nesting = &local;
+    }
+
+    // Count the tasks on our stack that are not counted yet (an outer
+    // thread_pool_wait may have counted some)
+    bool nested = nesting->running > 0;
+    int counted = 0;
+    if (nesting->running > nesting->blocked) {
+        counted = nesting->running - nesting->blocked;
+        nesting->blocked = nesting->running;
+        __atomic_fetch_add(&pool->blocked, (uint32_t)counted, __ATOMIC_SEQ_CST);
+        thread_pool_wake_waiters(pool);
+    }
+
+    unsigned int idle = 0;
+    while (true) {
+        uint32_t seq = __atomic_load_n(&pool->wait_seq, __ATOMIC_ACQUIRE);
+        uint32_t pending = __atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE);
+        if (pending <= (nested ? __atomic_load_n(&pool->blocked, __ATOMIC_ACQUIRE) : 0)) {
+            break;
+        }
+
+        thread_pool_task_t task;
+        if (thread_pool_find_task(pool, self, &task)) {
+            thread_pool_run_task(pool, task);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < THREAD_POOL_IDLE_SPINS) {
+            cpu_relax();
+            continue;
+        }
+
+        // Sleep until thread_pool_wake_waiters bumps wait_seq; re-check
+        // after announcing ourselves in case the last change just missed us
+        __atomic_fetch_add(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+        pending = __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST);
+        if (pending > (nested ? __atomic_load_n(&pool->blocked, __ATOMIC_SEQ_CST) : 0)) {
+            futex_wait(&pool->wait_seq, seq);
+        }
+        __atomic_fetch_sub(&pool->waiters, 1, __ATOMIC_RELAXED);
+        idle = 0;
+    }
+
+    if (counted > 0) {
+        nesting->blocked -= counted;
+        __atomic_fetch_sub(&pool->blocked, (uint32_t)counted, __ATOMIC_SEQ_CST);
+    }
+    thread_pool_current_nesting = saved;
+}
+
+// Stop the workers and free the pool. Tasks still queued are not run;
+// call thread_pool_wait first to drain them.
+static inline void thread_pool_destroy(thread_pool_t *pool) {
+    thread_pool_shutdown(pool, pool->num_workers);
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,149 @@
+/**
+ * vector.h - Typed growable arrays generated by a macro
+ *
+ * void_pointer_examples allocates a fixed block through a void pointer and
+ * casts it back to int*. VECTOR_DECLARE generates a real element type
+ * instead, with push and indexing that need no casts:
+ *
+ *     VECTOR_DECLARE(int_vector, int)        // once, at file scope
+ *
+ *     int_vector_t v;
+ *     int_vector_init(&v);
+ *     int_vector_reserve(&v, 100);           // optional: one allocation up front
+ *     int_vector_push(&v, 42);               // amortized O(1)
+ *     int x = v.data[0];                     // plain typed array access
+ *     int_vector_shrink_to_fit(&v);          // give back unused capacity
+ *     int_vector_free(&v);
+ *
+ * This header provides, for every declared `name`:
+ * 1. name_t with data, size and capacity fields
+ * 2. name_init / name_free / name_clear
+ * 3. name_reserve / name_shrink_to_fit - explicit capacity control
+ * 4. name_push / name_pop / name_at
+ *
+ * Capacity doubles whenever the vector is full, so n pushes copy fewer
+ * than 2n elements in total and reallocate only about log2(n) times.
+ * Storage is VECTOR_ALIGNMENT-aligned, so data is always ready for the
+ * SIMD kernels in array_kernels.h. Functions that allocate return 0 on
+ * success and -1 when out of memory; the vector is unchanged on failure.
+ */
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Alignment of every vector's storage: one cache line
+#define VECTOR_ALIGNMENT 64
+
+// Smallest capacity a vector grows to: at least one cache line of elements
+#define VECTOR_MIN_BYTES VECTOR_ALIGNMENT
+
+// Allocate `count` elements of `elem_size` bytes, aligned, and move the
+// first `used` elements of `old` over. NULL means out of memory (and `old`
+// is left alone). aligned_alloc has no realloc counterpart, so growing is
+// always a copy; doubling keeps the total copying linear.
+static inline void *vector_reallocate(void *old, size_t used, size_t count, size_t elem_size) {
+    if (count > (SIZE_MAX - VECTOR_ALIGNMENT) / elem_size) {
+        return NULL;
+    }
+    // aligned_alloc wants the size to be a multiple of the alignment
+    size_t bytes = (count * elem_size + VECTOR_ALIGNMENT - 1) & ~(size_t)(VECTOR_ALIGNMENT - 1);
+    void *data = aligned_alloc(VECTOR_ALIGNMENT, bytes);
+    if (data == NULL) {
+        return NULL;
+    }
+    if (used > 0) {
+        memcpy(data, old, used * elem_size);
+    }
+    free(old);
+    return data;
+}
+
+#define VECTOR_DECLARE(name, type) \
+    typedef struct { \
+        type *data; \
+        size_t size;      /* Elements in use */ \
+        size_t capacity;  /* Elements allocated */ \
+    } name##_t; \
+    \
+    static inline void name##_init(name##_t *v) { \
+        v->data = NULL; \
+        v->size = 0; \
+        v->capacity = 0; \
+    } \
+    \
+    static inline void name##_free(name##_t *v) { \
+        free(v->data); \
+        name##_init(v); \
+    } \
+    \
+    /* Drop every element but keep the capacity for reuse */ \
+    static inline void name##_clear(name##_t *v) { \
+        v->size = 0; \
+    } \
+    \
+    /* Make room for at least `capacity` elements without further growth */ \
+    static inline int name##_reserve(name##_t *v, size_t capacity) { \
+        if (capacity <= v->capacity) { \
+            return 0; \
+        } \
+        type *data = (type *)vector_reallocate(v->data, v->size, capacity, sizeof(type)); \
+        if (data == NULL) { \
+            return -1; \
+        } \
+        v->data = data; \
+        v->capacity = capacity; \
+        return 0; \
+    } \
+    \
+    /* Reduce the capacity to the size (frees everything when empty) */ \
+    static inline int name##_shrink_to_fit(name##_t *v) { \
+        if (v->size == v->capacity) { \
+            return 0; \
+        } \
+        if (v->size == 0) { \
+            name##_free(v); \
+            return 0; \
+        } \
+        type *data = (type *)vector_reallocate(v->data, v->size, v->size, sizeof(type)); \
+        if (data == NULL) { \
+            return -1; \
+        } \
+        v->data = data; \
+        v->capacity = v->size; \
+        return 0; \
+    } \
+    \
+    /* Slow path of push: double the capacity */ \
+    static inline int name##_grow(name##_t *v) { \
+        size_t min = VECTOR_MIN_BYTES / sizeof(type) > 0 ? VECTOR_MIN_BYTES / sizeof(type) : 1; \
+        size_t capacity = v->capacity > 0 ? v->capacity * 2 : min; \
+        if (capacity < v->capacity) { \
+            return -1; \
+        } \
+        return name##_reserve(v, capacity); \
+    } \
+    \
+    static inline int name##_push(name##_t *v, type value) { \
+        if (v->size == v->capacity && name##_grow(v) != 0) { \
+            return -1; \
+        } \
+        v->data[v->size++] = value; \
+        return 0; \
+    } \
+    \
+    /* Remove and return the last element; the vector must not be empty */ \
+    static inline type name##_pop(name##_t *v) { \
+        return v->data[--v->size]; \
+    } \
+    \
+    /* Pointer to element i, or NULL when i is out of range */ \
+    static inline type *name##_at(const name##_t *v, size_t i) { \
+        return i < v->size ? &v->data[i] : NULL; \
+    }
+
+#endif // VECTOR_H